@@ -0,0 +1,372 @@
+#ifndef BLOCKED_CONV
+#define BLOCKED_CONV
+
+#include <vector>
+#include <algorithm>
+
+#include "CpuFeatures.cpp"
+#include "ThreadPool.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Прямая свёртка в блочной раскладке NCHWc
+
+    Каналы группируются в блоки по C = 64 байта (16 float или 8 double):
+    - вход      Xb [D/C][Hp][Wp][C]   - уже с паддингом, без проверок границ
+    - фильтры   Wb [F/C][D/C][K][K][C][C], последний индекс - канал выхода
+    - выход     NCHW, как у остальных слоёв
+
+    Микроядро держит в регистрах плитку из RW соседних позиций выхода
+    на C каналов: на каждый элемент входа одна загрузка-размножение и
+    C/вектор умножений-сложений. В отличие от im2col вход не раздувается
+    в K*K раз, поэтому путь подходит для инференса по одному примеру
+
+    Ширина блока не зависит от набора инструкций: AVX-512 обрабатывает
+    блок одним регистром, AVX2 - двумя, без SIMD работает обычный цикл.
+    Вариант микроядра и число позиций RW в плитке выбираются во время
+    выполнения, буферы рассчитываются на наибольшее MaxRW
+*/
+template <typename T>
+struct BlockedConvTile
+{
+    static constexpr unsigned int C = 64 / sizeof(T);
+    static constexpr unsigned int MaxRW = 12;
+};
+
+
+/*
+    Размеры входа с паддингом. Ширина дополняется нулями так, чтобы
+    последняя плитка из RW позиций не выходила за буфер (для RW = MaxRW
+    это верно и для любого делителя MaxRW)
+*/
+inline void BlockedConvPaddedSize
+(
+    unsigned int height, unsigned int width, unsigned int filter_size,
+    unsigned int padding, unsigned int stride, unsigned int dilation,
+    unsigned int output_width, unsigned int RW,
+    unsigned int& padded_height, unsigned int& padded_width
+)
+{
+    const unsigned int tiles = (output_width + RW - 1) / RW;
+
+    padded_height = height + 2 * padding;
+    padded_width = std::max(width + 2 * padding, (tiles * RW - 1) * stride + (filter_size - 1) * dilation + 1);
+}
+
+
+/*
+    Перепаковка одного примера NCHW в Xb с нулевым паддингом.
+    Буфер Xb должен быть заранее обнулён: паддинг и хвосты блоков
+    каналов не перезаписываются
+*/
+template <typename T>
+void BlockedConvPackInput
+(
+    const T* X,
+    unsigned int depth, unsigned int height, unsigned int width, unsigned int padding,
+    unsigned int padded_height, unsigned int padded_width,
+    T* Xb
+)
+{
+    constexpr unsigned int C = BlockedConvTile<T>::C;
+
+    for(unsigned int d = 0; d < depth; ++d)
+    {
+        const T* x = X + (std::size_t)d * height * width;
+        T* xb = Xb + (std::size_t)(d / C) * padded_height * padded_width * C + d % C;
+
+        for(unsigned int h = 0; h < height; ++h)
+        {
+            T* dst = xb + ((std::size_t)(h + padding) * padded_width + padding) * C;
+
+            for(unsigned int w = 0; w < width; ++w)
+                dst[(std::size_t)w * C] = x[(std::size_t)h * width + w];
+        }
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Микроядро: плитка RW x C для одной строки выхода oh и позиций
+    ow0 .. ow0 + RW - 1, результат пишется в acc[RW][C]
+
+    x - начало строки oh * stride первого блока входа со сдвигом ow0 * stride,
+    w - начало блока фильтров выхода, элементы фильтра берутся из входа
+    через dilation позиций
+*/
+template <typename T>
+void BlockedConvMicroKernel
+(
+    const T* x, const T* w,
+    unsigned int depth, unsigned int plane, unsigned int row,
+    unsigned int filter_size, unsigned int stride, unsigned int dilation,
+    T* acc
+)
+{
+    constexpr unsigned int C = BlockedConvTile<T>::C;
+    constexpr unsigned int RW = 6;
+
+    T sum[RW][C] = {};
+
+    for(unsigned int d0 = 0; d0 < depth; d0 += C)
+    {
+        const unsigned int channels = std::min(C, depth - d0);
+
+        for(unsigned int fh = 0; fh < filter_size; ++fh)
+        {
+            for(unsigned int fw = 0; fw < filter_size; ++fw)
+            {
+                const T* x_k = x + (std::size_t)fh * dilation * row + (std::size_t)fw * dilation * C;
+                const T* w_k = w + (std::size_t)(fh * filter_size + fw) * C * C;
+
+                for(unsigned int c = 0; c < channels; ++c)
+                {
+                    const T* w_c = w_k + c * C;
+
+                    for(unsigned int r = 0; r < RW; ++r)
+                    {
+                        const T x_rc = x_k[(std::size_t)r * stride * C + c];
+
+                        for(unsigned int j = 0; j < C; ++j)
+                            sum[r][j] += x_rc * w_c[j];
+                    }
+                }
+            }
+        }
+
+        x += plane;
+        w += (std::size_t)filter_size * filter_size * C * C;
+    }
+
+    for(unsigned int r = 0; r < RW; ++r)
+        for(unsigned int j = 0; j < C; ++j)
+            acc[r * C + j] = sum[r][j];
+}
+
+
+#if defined(CPU_X86)
+
+/*
+    AVX2: блок каналов - VN = C / 8 регистров, плитка из 6 позиций
+*/
+template <typename T>
+CPU_TARGET_AVX2 void BlockedConvMicroKernelAvx2
+(
+    const T* x, const T* w,
+    unsigned int depth, unsigned int plane, unsigned int row,
+    unsigned int filter_size, unsigned int stride, unsigned int dilation,
+    T* acc
+)
+{
+    typedef Avx2Vector<T> V;
+
+    constexpr unsigned int C = BlockedConvTile<T>::C;
+    constexpr unsigned int VN = C / V::W;
+    constexpr unsigned int RW = 6;
+
+    typename V::Vec sum[RW][VN];
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < RW; ++r)
+        CPU_UNROLL
+        for(unsigned int v = 0; v < VN; ++v)
+            sum[r][v] = V::Zero();
+
+    const std::size_t step = (std::size_t)stride * C;
+
+    for(unsigned int d0 = 0; d0 < depth; d0 += C)
+    {
+        const unsigned int channels = std::min(C, depth - d0);
+
+        for(unsigned int fh = 0; fh < filter_size; ++fh)
+        {
+            for(unsigned int fw = 0; fw < filter_size; ++fw)
+            {
+                const T* x_k = x + (std::size_t)fh * dilation * row + (std::size_t)fw * dilation * C;
+                const T* w_k = w + (std::size_t)(fh * filter_size + fw) * C * C;
+
+                for(unsigned int c = 0; c < channels; ++c)
+                {
+                    typename V::Vec w_c[VN];
+
+                    CPU_UNROLL
+                    for(unsigned int v = 0; v < VN; ++v)
+                        w_c[v] = V::Load(w_k + c * C + v * V::W);
+
+                    CPU_UNROLL
+                    for(unsigned int r = 0; r < RW; ++r)
+                    {
+                        const typename V::Vec x_rc = V::Set(x_k[r * step + c]);
+
+                        CPU_UNROLL
+                        for(unsigned int v = 0; v < VN; ++v)
+                            sum[r][v] = V::Fmadd(x_rc, w_c[v], sum[r][v]);
+                    }
+                }
+            }
+        }
+
+        x += plane;
+        w += (std::size_t)filter_size * filter_size * C * C;
+    }
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < RW; ++r)
+        CPU_UNROLL
+        for(unsigned int v = 0; v < VN; ++v)
+            V::Store(acc + r * C + v * V::W, sum[r][v]);
+}
+
+/*
+    AVX-512: блок каналов - один регистр, плитка из 12 позиций
+*/
+template <typename T>
+CPU_TARGET_AVX512 void BlockedConvMicroKernelAvx512
+(
+    const T* x, const T* w,
+    unsigned int depth, unsigned int plane, unsigned int row,
+    unsigned int filter_size, unsigned int stride, unsigned int dilation,
+    T* acc
+)
+{
+    typedef Avx512Vector<T> V;
+
+    constexpr unsigned int C = BlockedConvTile<T>::C;
+    constexpr unsigned int RW = 12;
+
+    static_assert(C == V::W, "channel block must fill one register");
+
+    typename V::Vec sum[RW];
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < RW; ++r)
+        sum[r] = V::Zero();
+
+    const std::size_t step = (std::size_t)stride * C;
+
+    for(unsigned int d0 = 0; d0 < depth; d0 += C)
+    {
+        const unsigned int channels = std::min(C, depth - d0);
+
+        for(unsigned int fh = 0; fh < filter_size; ++fh)
+        {
+            for(unsigned int fw = 0; fw < filter_size; ++fw)
+            {
+                const T* x_k = x + (std::size_t)fh * dilation * row + (std::size_t)fw * dilation * C;
+                const T* w_k = w + (std::size_t)(fh * filter_size + fw) * C * C;
+
+                for(unsigned int c = 0; c < channels; ++c)
+                {
+                    const typename V::Vec w_c = V::Load(w_k + c * C);
+
+                    CPU_UNROLL
+                    for(unsigned int r = 0; r < RW; ++r)
+                        sum[r] = V::Fmadd(V::Set(x_k[r * step + c]), w_c, sum[r]);
+                }
+            }
+        }
+
+        x += plane;
+        w += (std::size_t)filter_size * filter_size * C * C;
+    }
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < RW; ++r)
+        V::Store(acc + r * C, sum[r]);
+}
+
+#endif
+
+
+/*
+    Микроядро под активный набор инструкций и его ширина плитки
+*/
+template <typename T>
+struct BlockedConvKernel
+{
+    typedef void (*Function)(const T*, const T*, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, unsigned int, T*);
+
+    Function function;
+    unsigned int RW;
+
+    static const BlockedConvKernel& Active()
+    {
+        static const BlockedConvKernel kernel = []
+        {
+            BlockedConvKernel scalar = { &BlockedConvMicroKernel<T>, 6 };
+#if defined(CPU_X86)
+            BlockedConvKernel avx2 = { &BlockedConvMicroKernelAvx2<T>, 6 };
+            BlockedConvKernel avx512 = { &BlockedConvMicroKernelAvx512<T>, 12 };
+#endif
+            return CPU_DISPATCH(scalar, avx2, avx512);
+        }();
+
+        return kernel;
+    }
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Свёртка одного примера: Xb и Wb в блочной раскладке, Y - NCHW.
+    Части работы для пула потоков - блок фильтров и строка выхода
+*/
+template <typename T>
+void BlockedConvForward
+(
+    const T* Xb, const T* Wb, const T* bias,
+    unsigned int depth, unsigned int filter_count,
+    unsigned int padded_height, unsigned int padded_width,
+    unsigned int filter_size, unsigned int stride, unsigned int dilation,
+    unsigned int output_height, unsigned int output_width,
+    T* Y
+)
+{
+    constexpr unsigned int C = BlockedConvTile<T>::C;
+
+    const BlockedConvKernel<T>& kernel = BlockedConvKernel<T>::Active();
+    const unsigned int RW = kernel.RW;
+
+    const unsigned int depth_blocks = (depth + C - 1) / C;
+
+    const unsigned int row = padded_width * C;
+    const unsigned int plane = padded_height * row;
+
+    const std::size_t filter_block = (std::size_t)depth_blocks * filter_size * filter_size * C * C;
+
+    const unsigned int filter_blocks = (filter_count + C - 1) / C;
+
+    ThreadPool::Shared().ParallelFor((std::size_t)filter_blocks * output_height, [&](std::size_t item)
+    {
+        const unsigned int oh = item % output_height;
+        const unsigned int f0 = item / output_height * C;
+
+        const unsigned int filters = std::min(C, filter_count - f0);
+        const T* w = Wb + (std::size_t)(f0 / C) * filter_block;
+
+        T acc[BlockedConvTile<T>::MaxRW * C];
+
+        for(unsigned int ow0 = 0; ow0 < output_width; ow0 += RW)
+        {
+            const T* x = Xb + (std::size_t)oh * stride * row + (std::size_t)ow0 * stride * C;
+
+            kernel.function(x, w, depth, plane, row, filter_size, stride, dilation, acc);
+
+            const unsigned int columns = std::min(RW, output_width - ow0);
+
+            for(unsigned int j = 0; j < filters; ++j)
+            {
+                T* y = Y + ((std::size_t)(f0 + j) * output_height + oh) * output_width + ow0;
+
+                for(unsigned int r = 0; r < columns; ++r)
+                    y[r] = acc[r * C + j] + bias[f0 + j];
+            }
+        }
+    });
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
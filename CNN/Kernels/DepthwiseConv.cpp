@@ -0,0 +1,159 @@
+#ifndef DEPTHWISE_CONV
+#define DEPTHWISE_CONV
+
+#include <cstddef>
+#include <algorithm>
+
+#include "Vector.cpp"
+#include "FixedConv.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Поканальная (depthwise) свёртка: у каждого канала входа свой фильтр
+    K x K, каналы между собой не смешиваются, глубина выхода равна
+    глубине входа. Вход заранее дополнен нулями (D x Hp x Wp), поэтому
+    проверок границ во внутренних циклах нет
+
+    Прямой проход для частых форм фильтра считает ядро одного канала из
+    FixedConv.cpp, для остальных - общий цикл. В обратном проходе при
+    шаге 1 строки градиента обрабатываются векторными VectorDot и VectorAxpy
+*/
+
+
+/*
+    Общий вариант одного канала: y[oh][ow] += sum w[fh][fw] * x[oh * S + fh][ow * S + fw]
+*/
+template <typename T>
+void DepthwiseConvPlane
+(
+    const T* x, unsigned int row, const T* w,
+    unsigned int filter_size, unsigned int stride,
+    unsigned int output_height, unsigned int output_width,
+    T* y
+)
+{
+    for(unsigned int oh = 0; oh < output_height; ++oh)
+    {
+        const T* x_row = x + (std::size_t)oh * stride * row;
+        T* y_row = y + (std::size_t)oh * output_width;
+
+        for(unsigned int ow = 0; ow < output_width; ++ow)
+        {
+            const T* x0 = x_row + ow * stride;
+
+            T sum = 0;
+
+            for(unsigned int fh = 0; fh < filter_size; ++fh)
+                for(unsigned int fw = 0; fw < filter_size; ++fw)
+                    sum += w[fh * filter_size + fw] * x0[(std::size_t)fh * row + fw];
+
+            y_row[ow] += sum;
+        }
+    }
+}
+
+
+/*
+    Прямой проход одного примера: Xp - D x Hp x Wp, W - D x K x K, Y - D x OH x OW
+*/
+template <typename T>
+void DepthwiseConvForward
+(
+    const T* Xp, const T* W, const T* bias,
+    unsigned int depth, unsigned int padded_height, unsigned int padded_width,
+    unsigned int filter_size, unsigned int stride,
+    unsigned int output_height, unsigned int output_width,
+    T* Y
+)
+{
+    const FixedConvPlaneFunction<T> plane = FixedConvPlaneSelect<T>(filter_size, stride);
+
+    const std::size_t outputs = (std::size_t)output_height * output_width;
+    const std::size_t channel = (std::size_t)padded_height * padded_width;
+
+    for(unsigned int d = 0; d < depth; ++d)
+    {
+        const T* x = Xp + d * channel;
+        const T* w = W + (std::size_t)d * filter_size * filter_size;
+        T* y = Y + d * outputs;
+
+        std::fill(y, y + outputs, bias[d]);
+
+        if (plane != nullptr)
+            plane(x, padded_width, w, output_height, output_width, y);
+        else
+            DepthwiseConvPlane(x, padded_width, w, filter_size, stride, output_height, output_width, y);
+    }
+}
+
+
+/*
+    Обратный проход одного примера, оба градиента накапливаются:
+    dW [D x K x K]   += G [d][oh][ow] * Xp[d][oh * S + fh][ow * S + fw]
+    dXp[D x Hp x Wp] += G [d][oh][ow] * W [d][fh][fw]
+*/
+template <typename T>
+void DepthwiseConvBackward
+(
+    const T* Xp, const T* W, const T* G,
+    unsigned int depth, unsigned int padded_height, unsigned int padded_width,
+    unsigned int filter_size, unsigned int stride,
+    unsigned int output_height, unsigned int output_width,
+    T* dW, T* dXp
+)
+{
+    const std::size_t outputs = (std::size_t)output_height * output_width;
+    const std::size_t channel = (std::size_t)padded_height * padded_width;
+    const unsigned int window = filter_size * filter_size;
+
+    for(unsigned int d = 0; d < depth; ++d)
+    {
+        const T* x = Xp + d * channel;
+        const T* w = W + (std::size_t)d * window;
+        const T* g = G + d * outputs;
+
+        T* dw = dW + (std::size_t)d * window;
+        T* dx = dXp + d * channel;
+
+        for(unsigned int oh = 0; oh < output_height; ++oh)
+        {
+            const T* g_row = g + (std::size_t)oh * output_width;
+
+            for(unsigned int fh = 0; fh < filter_size; ++fh)
+            {
+                const std::size_t offset = (std::size_t)(oh * stride + fh) * padded_width;
+
+                const T* x_row = x + offset;
+                T* dx_row = dx + offset;
+
+                for(unsigned int fw = 0; fw < filter_size; ++fw)
+                {
+                    const T w_k = w[fh * filter_size + fw];
+
+                    if (stride == 1)
+                    {
+                        dw[fh * filter_size + fw] += VectorDot(g_row, x_row + fw, output_width);
+                        VectorAxpy(w_k, g_row, dx_row + fw, output_width);
+                    }
+                    else
+                    {
+                        T sum = 0;
+
+                        for(unsigned int ow = 0; ow < output_width; ++ow)
+                        {
+                            sum += g_row[ow] * x_row[ow * stride + fw];
+                            dx_row[ow * stride + fw] += g_row[ow] * w_k;
+                        }
+
+                        dw[fh * filter_size + fw] += sum;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef FFT_KERNEL
+#define FFT_KERNEL
+
+#include <cmath>
+#include <vector>
+#include <complex>
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+template <typename T>
+inline std::complex<T> ComplexMultiply(const std::complex<T>& a, const std::complex<T>& b)
+{
+    return std::complex<T>(
+        a.real() * b.real() - a.imag() * b.imag(),
+        a.real() * b.imag() + a.imag() * b.real()
+    );
+}
+
+/*
+    Быстрое преобразование Фурье по основанию 2
+
+    План хранит таблицу поворотных множителей и перестановку индексов
+    для размера n (степень двойки), поэтому одно и то же преобразование
+    можно многократно применять к строкам и столбцам без пересчёта синусов
+*/
+template <typename T>
+struct FFTPlan
+{
+    unsigned int n = 0;
+
+    std::vector<std::complex<T>> twiddles;
+    std::vector<unsigned int> reverse;
+
+    void Initialize(unsigned int n)
+    {
+        this->n = n;
+
+        twiddles.resize(n / 2);
+        reverse.resize(n);
+
+        const double pi = std::acos(-1.0);
+
+        for(unsigned int k = 0; k < n / 2; ++k)
+            twiddles[k] = std::complex<T>((T)std::cos(2 * pi * k / n), (T)-std::sin(2 * pi * k / n));
+
+        unsigned int bits = 0;
+
+        while ((1u << bits) < n)
+            ++bits;
+
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            unsigned int r = 0;
+
+            for(unsigned int b = 0; b < bits; ++b)
+                if (i & (1u << b))
+                    r |= 1u << (bits - 1 - b);
+
+            reverse[i] = r;
+        }
+    }
+
+    /*
+        Преобразование на месте n элементов, лежащих с шагом stride.
+        Обратное преобразование не делится на n
+    */
+    void Transform(std::complex<T>* a, std::size_t stride, bool inverse) const
+    {
+        for(unsigned int i = 0; i < n; ++i)
+            if (i < reverse[i])
+                std::swap(a[i * stride], a[reverse[i] * stride]);
+
+        for(unsigned int length = 2; length <= n; length <<= 1)
+        {
+            const unsigned int half = length / 2;
+            const unsigned int step = n / length;
+
+            for(unsigned int start = 0; start < n; start += length)
+            {
+                for(unsigned int k = 0; k < half; ++k)
+                {
+                    std::complex<T> w = inverse ? std::conj(twiddles[k * step]) : twiddles[k * step];
+
+                    std::complex<T>& u = a[(start + k) * stride];
+                    std::complex<T>& v = a[(start + k + half) * stride];
+
+                    // Умножение без проверок на NaN/Inf из стандартного operator*
+                    std::complex<T> t = ComplexMultiply(v, w);
+
+                    v = u - t;
+                    u = u + t;
+                }
+            }
+        }
+    }
+};
+
+
+/*
+    Наименьшая степень двойки, не меньшая n
+*/
+inline unsigned int FFTSize(unsigned int n)
+{
+    unsigned int size = 1;
+
+    while (size < n)
+        size <<= 1;
+
+    return size;
+}
+
+
+/*
+    Двумерное преобразование матрицы rows x cols (построчно):
+    сначала все строки, затем все столбцы.
+    Обратное преобразование нормируется на rows * cols
+*/
+template <typename T>
+void FFT2D(const FFTPlan<T>& plan_rows, const FFTPlan<T>& plan_cols, std::complex<T>* a, bool inverse)
+{
+    const unsigned int rows = plan_rows.n;
+    const unsigned int cols = plan_cols.n;
+
+    for(unsigned int i = 0; i < rows; ++i)
+        plan_cols.Transform(a + (std::size_t)i * cols, 1, inverse);
+
+    for(unsigned int j = 0; j < cols; ++j)
+        plan_rows.Transform(a + j, cols, inverse);
+
+    if (inverse)
+    {
+        const T scale = (T)1 / ((T)rows * cols);
+
+        for(std::size_t i = 0; i < (std::size_t)rows * cols; ++i)
+            a[i] *= scale;
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
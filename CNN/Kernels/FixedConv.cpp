@@ -0,0 +1,345 @@
+#ifndef FIXED_CONV
+#define FIXED_CONV
+
+#include <cstddef>
+#include <algorithm>
+
+#include "CpuFeatures.cpp"
+#include "Im2Col.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Прямая свёртка с размером фильтра K и шагом S, известными при
+    компиляции
+
+    Циклы по fh и fw разворачиваются полностью, а K * K весов одного
+    канала фильтра лежат в регистрах. Вход заранее дополняется нулями,
+    поэтому проверок границ во внутреннем цикле нет. При S = 1 и S = 2
+    SIMD-варианты считают сразу вектор соседних позиций строки выхода:
+    для шага 2 нужные элементы строки входа - через один, их собирает
+    LoadEven (две загрузки и перестановка). При большем шаге работает
+    развёрнутый скалярный цикл
+
+    Шаблоны создаются только для частых форм (см. FixedConvSelect),
+    для остальных остаётся обычная прямая свёртка
+*/
+
+
+/*
+    Вклад одного канала: y[oh][ow] += sum w[fh][fw] * x[oh * S + fh][ow * S + fw],
+    x - канал входа с паддингом и длиной строки row
+*/
+template <unsigned int K, unsigned int S, typename T>
+void FixedConvPlane
+(
+    const T* x, unsigned int row, const T* w,
+    unsigned int output_height, unsigned int output_width,
+    T* y
+)
+{
+    T wk[K * K];
+
+    CPU_UNROLL
+    for(unsigned int i = 0; i < K * K; ++i)
+        wk[i] = w[i];
+
+    for(unsigned int oh = 0; oh < output_height; ++oh)
+    {
+        const T* x_row = x + (std::size_t)oh * S * row;
+        T* y_row = y + (std::size_t)oh * output_width;
+
+        for(unsigned int ow = 0; ow < output_width; ++ow)
+        {
+            T sum = 0;
+
+            CPU_UNROLL
+            for(unsigned int fh = 0; fh < K; ++fh)
+                CPU_UNROLL
+                for(unsigned int fw = 0; fw < K; ++fw)
+                    sum += wk[fh * K + fw] * x_row[(std::size_t)fh * row + ow * S + fw];
+
+            y_row[ow] += sum;
+        }
+    }
+}
+
+
+#if defined(CPU_X86)
+
+/*
+    SIMD-варианты для S = 1 и S = 2: вектор соседних позиций выхода, веса
+    размножены по регистрам. Хвост строки - неполный вектор с маской
+*/
+template <unsigned int K, unsigned int S, typename T>
+CPU_TARGET_AVX2 void FixedConvPlaneAvx2
+(
+    const T* x, unsigned int row, const T* w,
+    unsigned int output_height, unsigned int output_width,
+    T* y
+)
+{
+    if (S > 2)
+    {
+        FixedConvPlane<K, S>(x, row, w, output_height, output_width, y);
+        return;
+    }
+
+    typedef Avx2Vector<T> V;
+
+    typename V::Vec wk[K * K];
+
+    CPU_UNROLL
+    for(unsigned int i = 0; i < K * K; ++i)
+        wk[i] = V::Set(w[i]);
+
+    for(unsigned int oh = 0; oh < output_height; ++oh)
+    {
+        const T* x_row = x + (std::size_t)oh * S * row;
+        T* y_row = y + (std::size_t)oh * output_width;
+
+        unsigned int ow = 0;
+
+        for(; ow + V::W <= output_width; ow += V::W)
+        {
+            // Отдельный аккумулятор на строку фильтра: K независимых
+            // цепочек умножений-сложений вместо одной длиной K * K
+            typename V::Vec acc[K];
+
+            CPU_UNROLL
+            for(unsigned int fh = 0; fh < K; ++fh)
+            {
+                acc[fh] = fh == 0 ? V::Load(y_row + ow) : V::Zero();
+
+                CPU_UNROLL
+                for(unsigned int fw = 0; fw < K; ++fw)
+                {
+                    const T* x_k = x_row + (std::size_t)fh * row + ow * S + fw;
+                    acc[fh] = V::Fmadd(wk[fh * K + fw], S == 1 ? V::Load(x_k) : V::LoadEven(x_k), acc[fh]);
+                }
+            }
+
+            CPU_UNROLL
+            for(unsigned int fh = 1; fh < K; ++fh)
+                acc[0] = V::Add(acc[0], acc[fh]);
+
+            V::Store(y_row + ow, acc[0]);
+        }
+
+        if (ow < output_width)
+        {
+            const unsigned int n = output_width - ow;
+
+            typename V::Vec acc[K];
+
+            CPU_UNROLL
+            for(unsigned int fh = 0; fh < K; ++fh)
+            {
+                acc[fh] = fh == 0 ? V::LoadN(y_row + ow, n) : V::Zero();
+
+                CPU_UNROLL
+                for(unsigned int fw = 0; fw < K; ++fw)
+                {
+                    const T* x_k = x_row + (std::size_t)fh * row + ow * S + fw;
+                    acc[fh] = V::Fmadd(wk[fh * K + fw], S == 1 ? V::LoadN(x_k, n) : V::LoadEvenN(x_k, n), acc[fh]);
+                }
+            }
+
+            CPU_UNROLL
+            for(unsigned int fh = 1; fh < K; ++fh)
+                acc[0] = V::Add(acc[0], acc[fh]);
+
+            V::StoreN(y_row + ow, acc[0], n);
+        }
+    }
+}
+
+template <unsigned int K, unsigned int S, typename T>
+CPU_TARGET_AVX512 void FixedConvPlaneAvx512
+(
+    const T* x, unsigned int row, const T* w,
+    unsigned int output_height, unsigned int output_width,
+    T* y
+)
+{
+    if (S > 2)
+    {
+        FixedConvPlane<K, S>(x, row, w, output_height, output_width, y);
+        return;
+    }
+
+    typedef Avx512Vector<T> V;
+
+    typename V::Vec wk[K * K];
+
+    CPU_UNROLL
+    for(unsigned int i = 0; i < K * K; ++i)
+        wk[i] = V::Set(w[i]);
+
+    for(unsigned int oh = 0; oh < output_height; ++oh)
+    {
+        const T* x_row = x + (std::size_t)oh * S * row;
+        T* y_row = y + (std::size_t)oh * output_width;
+
+        unsigned int ow = 0;
+
+        for(; ow + V::W <= output_width; ow += V::W)
+        {
+            // Отдельный аккумулятор на строку фильтра: K независимых
+            // цепочек умножений-сложений вместо одной длиной K * K
+            typename V::Vec acc[K];
+
+            CPU_UNROLL
+            for(unsigned int fh = 0; fh < K; ++fh)
+            {
+                acc[fh] = fh == 0 ? V::Load(y_row + ow) : V::Zero();
+
+                CPU_UNROLL
+                for(unsigned int fw = 0; fw < K; ++fw)
+                {
+                    const T* x_k = x_row + (std::size_t)fh * row + ow * S + fw;
+                    acc[fh] = V::Fmadd(wk[fh * K + fw], S == 1 ? V::Load(x_k) : V::LoadEven(x_k), acc[fh]);
+                }
+            }
+
+            CPU_UNROLL
+            for(unsigned int fh = 1; fh < K; ++fh)
+                acc[0] = V::Add(acc[0], acc[fh]);
+
+            V::Store(y_row + ow, acc[0]);
+        }
+
+        if (ow < output_width)
+        {
+            const unsigned int n = output_width - ow;
+
+            typename V::Vec acc[K];
+
+            CPU_UNROLL
+            for(unsigned int fh = 0; fh < K; ++fh)
+            {
+                acc[fh] = fh == 0 ? V::LoadN(y_row + ow, n) : V::Zero();
+
+                CPU_UNROLL
+                for(unsigned int fw = 0; fw < K; ++fw)
+                {
+                    const T* x_k = x_row + (std::size_t)fh * row + ow * S + fw;
+                    acc[fh] = V::Fmadd(wk[fh * K + fw], S == 1 ? V::LoadN(x_k, n) : V::LoadEvenN(x_k, n), acc[fh]);
+                }
+            }
+
+            CPU_UNROLL
+            for(unsigned int fh = 1; fh < K; ++fh)
+                acc[0] = V::Add(acc[0], acc[fh]);
+
+            V::StoreN(y_row + ow, acc[0], n);
+        }
+    }
+}
+
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+template <typename T>
+using FixedConvPlaneFunction = void (*)(
+    const T*, unsigned int, const T*,
+    unsigned int, unsigned int,
+    T*
+);
+
+/*
+    Вариант ядра одного канала под активный набор инструкций
+*/
+template <unsigned int K, unsigned int S, typename T>
+FixedConvPlaneFunction<T> FixedConvPlaneActive()
+{
+    static const FixedConvPlaneFunction<T> plane = CPU_DISPATCH((&FixedConvPlane<K, S, T>), (&FixedConvPlaneAvx2<K, S, T>), (&FixedConvPlaneAvx512<K, S, T>));
+    return plane;
+}
+
+
+/*
+    Свёртка одного примера: Xp - вход с паддингом D x Hp x Wp,
+    W - фильтры F x D x K x K подряд, Y - F x OH x OW
+*/
+template <unsigned int K, unsigned int S, typename T>
+void FixedConvForward
+(
+    const T* Xp, const T* W, const T* bias,
+    unsigned int depth, unsigned int padded_height, unsigned int padded_width,
+    unsigned int filter_count, unsigned int output_height, unsigned int output_width,
+    T* Y
+)
+{
+    const FixedConvPlaneFunction<T> plane = FixedConvPlaneActive<K, S, T>();
+
+    const std::size_t outputs = (std::size_t)output_height * output_width;
+    const std::size_t channel = (std::size_t)padded_height * padded_width;
+
+    for(unsigned int f = 0; f < filter_count; ++f)
+    {
+        T* y = Y + f * outputs;
+
+        std::fill(y, y + outputs, bias[f]);
+
+        for(unsigned int d = 0; d < depth; ++d)
+            plane(Xp + d * channel, padded_width, W + ((std::size_t)f * depth + d) * K * K, output_height, output_width, y);
+    }
+}
+
+
+template <typename T>
+using FixedConvFunction = void (*)(
+    const T*, const T*, const T*,
+    unsigned int, unsigned int, unsigned int,
+    unsigned int, unsigned int, unsigned int,
+    T*
+);
+
+/*
+    Готовый шаблон под размер фильтра и шаг или nullptr, если такой
+    формы среди собранных нет
+*/
+template <typename T>
+FixedConvFunction<T> FixedConvSelect(unsigned int filter_size, unsigned int stride)
+{
+    if (filter_size == 3 && stride == 1)
+        return &FixedConvForward<3, 1, T>;
+
+    if (filter_size == 5 && stride == 1)
+        return &FixedConvForward<5, 1, T>;
+
+    if (filter_size == 3 && stride == 2)
+        return &FixedConvForward<3, 2, T>;
+
+    if (filter_size == 2 && stride == 2)
+        return &FixedConvForward<2, 2, T>;
+
+    return nullptr;
+}
+
+/*
+    То же для ядра одного канала (поканальная свёртка)
+*/
+template <typename T>
+FixedConvPlaneFunction<T> FixedConvPlaneSelect(unsigned int filter_size, unsigned int stride)
+{
+    if (filter_size == 3 && stride == 1)
+        return FixedConvPlaneActive<3, 1, T>();
+
+    if (filter_size == 5 && stride == 1)
+        return FixedConvPlaneActive<5, 1, T>();
+
+    if (filter_size == 3 && stride == 2)
+        return FixedConvPlaneActive<3, 2, T>();
+
+    if (filter_size == 2 && stride == 2)
+        return FixedConvPlaneActive<2, 2, T>();
+
+    return nullptr;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
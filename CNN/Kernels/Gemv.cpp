@@ -0,0 +1,348 @@
+#ifndef GEMV
+#define GEMV
+
+#include <cstddef>
+
+#include "CpuFeatures.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Умножение матрицы на вектор: y[M] += A[M x N] * x[N], строки A лежат
+    подряд с шагом lda (веса полносвязного слоя при одном примере)
+
+    Строки считаются блоками по GemvRows: каждый загруженный вектор x
+    сразу используется для всех строк блока, поэтому на одно
+    умножение-сложение приходится одна загрузка - только веса. У каждой
+    строки два независимых аккумулятора, хвост строки - неполный вектор
+    с маской. Оставшиеся M % GemvRows строк считаются по одной
+*/
+constexpr unsigned int GemvRows = 4;
+
+
+template <typename T>
+void GemvScalar(unsigned int M, unsigned int N, const T* A, unsigned int lda, const T* x, T* y)
+{
+    for(unsigned int i = 0; i < M; ++i)
+    {
+        const T* a = A + (std::size_t)i * lda;
+
+        T S = 0;
+
+        for(unsigned int j = 0; j < N; ++j)
+            S += a[j] * x[j];
+
+        y[i] += S;
+    }
+}
+
+
+/*
+    Обратный проход полносвязного слоя за одно чтение матрицы:
+
+        y[N] += A^T * x[M]       (по A до изменения)
+        A    += alpha * x * z^T  (изменение ранга 1)
+
+    Матрица читается по строкам, без транспонирования в памяти: блок из
+    GemvRows строк идёт по столбцам вектором, кусок y загружается один
+    раз на блок. Загруженный кусок строки A сразу идёт и в y, и в
+    изменение, после чего записывается обратно
+*/
+template <typename T>
+void GemvTransposedUpdateScalar(unsigned int M, unsigned int N, T* A, unsigned int lda, const T* x, T alpha, const T* z, T* y)
+{
+    for(unsigned int i = 0; i < M; ++i)
+    {
+        T* a = A + (std::size_t)i * lda;
+        const T x_i = x[i];
+        const T u_i = alpha * x[i];
+
+        for(unsigned int j = 0; j < N; ++j)
+        {
+            y[j] += x_i * a[j];
+            a[j] += u_i * z[j];
+        }
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#if defined(CPU_X86)
+
+/*
+    Блок из R строк: y[0 .. R - 1] += A[0 .. R - 1] * x
+*/
+template <unsigned int R, typename T>
+CPU_TARGET_AVX2 void GemvBlockAvx2(unsigned int N, const T* A, unsigned int lda, const T* x, T* y)
+{
+    typedef Avx2Vector<T> V;
+
+    typename V::Vec s0[R];
+    typename V::Vec s1[R];
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+        s0[r] = s1[r] = V::Zero();
+
+    unsigned int j = 0;
+
+    for(; j + 2 * V::W <= N; j += 2 * V::W)
+    {
+        const typename V::Vec x0 = V::Load(x + j);
+        const typename V::Vec x1 = V::Load(x + j + V::W);
+
+        CPU_UNROLL
+        for(unsigned int r = 0; r < R; ++r)
+        {
+            s0[r] = V::Fmadd(V::Load(A + (std::size_t)r * lda + j), x0, s0[r]);
+            s1[r] = V::Fmadd(V::Load(A + (std::size_t)r * lda + j + V::W), x1, s1[r]);
+        }
+    }
+
+    for(; j < N; j += V::W)
+    {
+        const unsigned int n = N - j < V::W ? N - j : V::W;
+
+        const typename V::Vec x0 = V::LoadN(x + j, n);
+
+        CPU_UNROLL
+        for(unsigned int r = 0; r < R; ++r)
+            s0[r] = V::Fmadd(V::LoadN(A + (std::size_t)r * lda + j, n), x0, s0[r]);
+    }
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+        y[r] += V::Sum(V::Add(s0[r], s1[r]));
+}
+
+template <typename T>
+CPU_TARGET_AVX2 void GemvAvx2(unsigned int M, unsigned int N, const T* A, unsigned int lda, const T* x, T* y)
+{
+    unsigned int i = 0;
+
+    for(; i + GemvRows <= M; i += GemvRows)
+        GemvBlockAvx2<GemvRows>(N, A + (std::size_t)i * lda, lda, x, y + i);
+
+    for(; i < M; ++i)
+        GemvBlockAvx2<1>(N, A + (std::size_t)i * lda, lda, x, y + i);
+}
+
+
+/*
+    Блок из R строк: y += A[0 .. R - 1]^T * x[0 .. R - 1],
+    A[r] += alpha * x[r] * z
+*/
+template <unsigned int R, typename T>
+CPU_TARGET_AVX2 void GemvTransposedUpdateBlockAvx2(unsigned int N, T* A, unsigned int lda, const T* x, T alpha, const T* z, T* y)
+{
+    typedef Avx2Vector<T> V;
+
+    typename V::Vec xr[R];
+    typename V::Vec ur[R];
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+    {
+        xr[r] = V::Set(x[r]);
+        ur[r] = V::Set(alpha * x[r]);
+    }
+
+    unsigned int j = 0;
+
+    for(; j + V::W <= N; j += V::W)
+    {
+        typename V::Vec acc = V::Load(y + j);
+        const typename V::Vec zj = V::Load(z + j);
+
+        CPU_UNROLL
+        for(unsigned int r = 0; r < R; ++r)
+        {
+            T* a = A + (std::size_t)r * lda + j;
+            const typename V::Vec w = V::Load(a);
+
+            acc = V::Fmadd(xr[r], w, acc);
+            V::Store(a, V::Fmadd(ur[r], zj, w));
+        }
+
+        V::Store(y + j, acc);
+    }
+
+    if (j < N)
+    {
+        const unsigned int n = N - j;
+
+        typename V::Vec acc = V::LoadN(y + j, n);
+        const typename V::Vec zj = V::LoadN(z + j, n);
+
+        CPU_UNROLL
+        for(unsigned int r = 0; r < R; ++r)
+        {
+            T* a = A + (std::size_t)r * lda + j;
+            const typename V::Vec w = V::LoadN(a, n);
+
+            acc = V::Fmadd(xr[r], w, acc);
+            V::StoreN(a, V::Fmadd(ur[r], zj, w), n);
+        }
+
+        V::StoreN(y + j, acc, n);
+    }
+}
+
+template <typename T>
+CPU_TARGET_AVX2 void GemvTransposedUpdateAvx2(unsigned int M, unsigned int N, T* A, unsigned int lda, const T* x, T alpha, const T* z, T* y)
+{
+    unsigned int i = 0;
+
+    for(; i + GemvRows <= M; i += GemvRows)
+        GemvTransposedUpdateBlockAvx2<GemvRows>(N, A + (std::size_t)i * lda, lda, x + i, alpha, z, y);
+
+    for(; i < M; ++i)
+        GemvTransposedUpdateBlockAvx2<1>(N, A + (std::size_t)i * lda, lda, x + i, alpha, z, y);
+}
+
+
+template <unsigned int R, typename T>
+CPU_TARGET_AVX512 void GemvBlockAvx512(unsigned int N, const T* A, unsigned int lda, const T* x, T* y)
+{
+    typedef Avx512Vector<T> V;
+
+    typename V::Vec s0[R];
+    typename V::Vec s1[R];
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+        s0[r] = s1[r] = V::Zero();
+
+    unsigned int j = 0;
+
+    for(; j + 2 * V::W <= N; j += 2 * V::W)
+    {
+        const typename V::Vec x0 = V::Load(x + j);
+        const typename V::Vec x1 = V::Load(x + j + V::W);
+
+        CPU_UNROLL
+        for(unsigned int r = 0; r < R; ++r)
+        {
+            s0[r] = V::Fmadd(V::Load(A + (std::size_t)r * lda + j), x0, s0[r]);
+            s1[r] = V::Fmadd(V::Load(A + (std::size_t)r * lda + j + V::W), x1, s1[r]);
+        }
+    }
+
+    for(; j < N; j += V::W)
+    {
+        const unsigned int n = N - j < V::W ? N - j : V::W;
+
+        const typename V::Vec x0 = V::LoadN(x + j, n);
+
+        CPU_UNROLL
+        for(unsigned int r = 0; r < R; ++r)
+            s0[r] = V::Fmadd(V::LoadN(A + (std::size_t)r * lda + j, n), x0, s0[r]);
+    }
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+        y[r] += V::Sum(V::Add(s0[r], s1[r]));
+}
+
+template <typename T>
+CPU_TARGET_AVX512 void GemvAvx512(unsigned int M, unsigned int N, const T* A, unsigned int lda, const T* x, T* y)
+{
+    unsigned int i = 0;
+
+    for(; i + GemvRows <= M; i += GemvRows)
+        GemvBlockAvx512<GemvRows>(N, A + (std::size_t)i * lda, lda, x, y + i);
+
+    for(; i < M; ++i)
+        GemvBlockAvx512<1>(N, A + (std::size_t)i * lda, lda, x, y + i);
+}
+
+
+template <unsigned int R, typename T>
+CPU_TARGET_AVX512 void GemvTransposedUpdateBlockAvx512(unsigned int N, T* A, unsigned int lda, const T* x, T alpha, const T* z, T* y)
+{
+    typedef Avx512Vector<T> V;
+
+    typename V::Vec xr[R];
+    typename V::Vec ur[R];
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+    {
+        xr[r] = V::Set(x[r]);
+        ur[r] = V::Set(alpha * x[r]);
+    }
+
+    unsigned int j = 0;
+
+    for(; j + V::W <= N; j += V::W)
+    {
+        typename V::Vec acc = V::Load(y + j);
+        const typename V::Vec zj = V::Load(z + j);
+
+        CPU_UNROLL
+        for(unsigned int r = 0; r < R; ++r)
+        {
+            T* a = A + (std::size_t)r * lda + j;
+            const typename V::Vec w = V::Load(a);
+
+            acc = V::Fmadd(xr[r], w, acc);
+            V::Store(a, V::Fmadd(ur[r], zj, w));
+        }
+
+        V::Store(y + j, acc);
+    }
+
+    if (j < N)
+    {
+        const unsigned int n = N - j;
+
+        typename V::Vec acc = V::LoadN(y + j, n);
+        const typename V::Vec zj = V::LoadN(z + j, n);
+
+        CPU_UNROLL
+        for(unsigned int r = 0; r < R; ++r)
+        {
+            T* a = A + (std::size_t)r * lda + j;
+            const typename V::Vec w = V::LoadN(a, n);
+
+            acc = V::Fmadd(xr[r], w, acc);
+            V::StoreN(a, V::Fmadd(ur[r], zj, w), n);
+        }
+
+        V::StoreN(y + j, acc, n);
+    }
+}
+
+template <typename T>
+CPU_TARGET_AVX512 void GemvTransposedUpdateAvx512(unsigned int M, unsigned int N, T* A, unsigned int lda, const T* x, T alpha, const T* z, T* y)
+{
+    unsigned int i = 0;
+
+    for(; i + GemvRows <= M; i += GemvRows)
+        GemvTransposedUpdateBlockAvx512<GemvRows>(N, A + (std::size_t)i * lda, lda, x + i, alpha, z, y);
+
+    for(; i < M; ++i)
+        GemvTransposedUpdateBlockAvx512<1>(N, A + (std::size_t)i * lda, lda, x + i, alpha, z, y);
+}
+
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+template <typename T>
+void Gemv(unsigned int M, unsigned int N, const T* A, unsigned int lda, const T* x, T* y)
+{
+    static const auto kernel = CPU_DISPATCH(&GemvScalar<T>, &GemvAvx2<T>, &GemvAvx512<T>);
+    kernel(M, N, A, lda, x, y);
+}
+
+template <typename T>
+void GemvTransposedUpdate(unsigned int M, unsigned int N, T* A, unsigned int lda, const T* x, T alpha, const T* z, T* y)
+{
+    static const auto kernel = CPU_DISPATCH(&GemvTransposedUpdateScalar<T>, &GemvTransposedUpdateAvx2<T>, &GemvTransposedUpdateAvx512<T>);
+    kernel(M, N, A, lda, x, alpha, z, y);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
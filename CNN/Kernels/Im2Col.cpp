@@ -0,0 +1,187 @@
+#ifndef IM2COL
+#define IM2COL
+
+#include <cstddef>
+#include <algorithm>
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Копия одного примера с нулевым паддингом: D x (H + 2P) x (W + 2P).
+    Рамка из нулей пишется каждый раз, буфер можно не обнулять
+*/
+template <typename T>
+void PadInput
+(
+    const T* X,
+    unsigned int depth, unsigned int height, unsigned int width, unsigned int padding,
+    T* Xp
+)
+{
+    const unsigned int padded_height = height + 2 * padding;
+    const unsigned int padded_width = width + 2 * padding;
+
+    for(unsigned int d = 0; d < depth; ++d)
+    {
+        const T* x = X + (std::size_t)d * height * width;
+        T* xp = Xp + (std::size_t)d * padded_height * padded_width;
+
+        std::fill(xp, xp + (std::size_t)padding * padded_width, (T)0);
+
+        for(unsigned int h = 0; h < height; ++h)
+        {
+            T* dst = xp + (std::size_t)(h + padding) * padded_width;
+
+            std::fill(dst, dst + padding, (T)0);
+            std::copy(x + (std::size_t)h * width, x + (std::size_t)(h + 1) * width, dst + padding);
+            std::fill(dst + padding + width, dst + padded_width, (T)0);
+        }
+
+        std::fill(xp + (std::size_t)(padding + height) * padded_width, xp + (std::size_t)padded_height * padded_width, (T)0);
+    }
+}
+
+
+/*
+    Позиции строки выхода ow, для которых столбец входа
+    j = ow * stride + offset лежит внутри строки ширины width: [begin, end)
+*/
+inline void Im2ColRange
+(
+    int offset, unsigned int width, unsigned int stride, unsigned int output_width,
+    unsigned int& begin, unsigned int& end
+)
+{
+    const int last = (int)width - 1 - offset;
+
+    end = last < 0 ? 0 : std::min(output_width, (unsigned int)last / stride + 1);
+    begin = std::min(end, offset >= 0 ? 0u : (unsigned int)(-offset + stride - 1) / stride);
+}
+
+
+/*
+    Развёртка входа свёртки в матрицу (im2col)
+
+    Строка матрицы - это один элемент фильтра (d, fh, fw), столбец - одна
+    позиция выхода (oh, ow). После развёртки свёртка всех фильтров сразу
+    превращается в одно перемножение матриц:
+
+        Y [F x OH*OW] = W [F x D*K*K] * col [D*K*K x OH*OW]
+
+    Элементы, попадающие в паддинг, заполняются нулями. Соседние
+    элементы фильтра берутся из входа через dilation позиций
+    (расширенная свёртка, при dilation = 1 - обычная)
+
+    Границы паддинга по ширине считаются один раз на элемент фильтра,
+    внутри них строка копируется без проверок (при шаге 1 - подряд)
+*/
+template <typename T>
+void Im2Col
+(
+    const T* X,
+    unsigned int depth, unsigned int height, unsigned int width,
+    unsigned int filter_size, unsigned int padding, unsigned int stride, unsigned int dilation,
+    unsigned int output_height, unsigned int output_width,
+    T* col
+)
+{
+    const unsigned int columns = output_height * output_width;
+
+    for(unsigned int d = 0; d < depth; ++d)
+    {
+        const T* x = X + (std::size_t)d * height * width;
+
+        for(unsigned int fh = 0; fh < filter_size; ++fh)
+        {
+            for(unsigned int fw = 0; fw < filter_size; ++fw)
+            {
+                T* row = col + ((std::size_t)(d * filter_size + fh) * filter_size + fw) * columns;
+
+                const int offset = (int)(fw * dilation) - (int)padding;
+
+                unsigned int begin, end;
+                Im2ColRange(offset, width, stride, output_width, begin, end);
+
+                for(unsigned int oh = 0; oh < output_height; ++oh)
+                {
+                    int i = (int)(oh * stride + fh * dilation) - (int)padding;
+
+                    T* dst = row + oh * output_width;
+
+                    if (i < 0 || i >= (int)height)
+                    {
+                        std::fill(dst, dst + output_width, (T)0);
+                        continue;
+                    }
+
+                    const T* src = x + (std::size_t)i * width;
+
+                    std::fill(dst, dst + begin, (T)0);
+
+                    if (stride == 1)
+                        std::copy(src + (int)begin + offset, src + (int)end + offset, dst + begin);
+                    else
+                        for(unsigned int ow = begin; ow < end; ++ow)
+                            dst[ow] = src[(int)(ow * stride) + offset];
+
+                    std::fill(dst + end, dst + output_width, (T)0);
+                }
+            }
+        }
+    }
+}
+
+
+/*
+    Обратная операция к Im2Col: каждый элемент матрицы прибавляется
+    к тому элементу входа, из которого он был взят. Нужна для
+    градиента по входу свёртки. Элементы паддинга отбрасываются
+*/
+template <typename T>
+void Col2Im
+(
+    const T* col,
+    unsigned int depth, unsigned int height, unsigned int width,
+    unsigned int filter_size, unsigned int padding, unsigned int stride, unsigned int dilation,
+    unsigned int output_height, unsigned int output_width,
+    T* X
+)
+{
+    const unsigned int columns = output_height * output_width;
+
+    for(unsigned int d = 0; d < depth; ++d)
+    {
+        T* x = X + (std::size_t)d * height * width;
+
+        for(unsigned int fh = 0; fh < filter_size; ++fh)
+        {
+            for(unsigned int fw = 0; fw < filter_size; ++fw)
+            {
+                const T* row = col + ((std::size_t)(d * filter_size + fh) * filter_size + fw) * columns;
+
+                const int offset = (int)(fw * dilation) - (int)padding;
+
+                unsigned int begin, end;
+                Im2ColRange(offset, width, stride, output_width, begin, end);
+
+                for(unsigned int oh = 0; oh < output_height; ++oh)
+                {
+                    int i = (int)(oh * stride + fh * dilation) - (int)padding;
+
+                    if (i < 0 || i >= (int)height)
+                        continue;
+
+                    const T* src = row + oh * output_width;
+                    T* dst = x + (std::size_t)i * width;
+
+                    for(unsigned int ow = begin; ow < end; ++ow)
+                        dst[(int)(ow * stride) + offset] += src[ow];
+                }
+            }
+        }
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
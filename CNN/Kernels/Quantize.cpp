@@ -0,0 +1,757 @@
+#ifndef QUANTIZE
+#define QUANTIZE
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "CpuFeatures.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Квантование в int8 для вывода (после обучения)
+
+    Веса: у каждой строки матрицы (нейрона, фильтра) свой масштаб
+    s_w = max |w| / 127, w ≈ s_w * q_w, q_w - int8 в [-127, 127]
+
+    Вход слоя: один масштаб и нулевая точка на весь слой, подобранные
+    по диапазону значений на калибровочных примерах:
+    x ≈ s_x * (q_x - z), q_x - uint8 в [0, 255]. Ноль представлен точно
+    (q_x = z), поэтому паддинг свёртки не вносит ошибки
+
+    Тогда выход нейрона
+
+        y_i = alpha_i * sum_j q_x[j] * q_w[i][j] + beta_i,
+
+        alpha_i = s_x * s_w[i],   beta_i = b_i - alpha_i * z * sum_j q_w[i][j]
+
+    Сумма произведений считается в int32 (uint8 * int8, как у vpdpbusd),
+    alpha и beta - один раз при квантовании. Выход сразу переводится
+    обратно в T: следующие слои (активации, пулинг, softmax) работают с
+    вещественными числами
+
+    Строки весов дополняются нулями до кратного Int8Columns байт,
+    поэтому ядра идут только целыми векторами
+*/
+constexpr unsigned int Int8Columns = 64;
+
+
+inline unsigned int Int8Stride(unsigned int n)
+{
+    return (n + Int8Columns - 1) / Int8Columns * Int8Columns;
+}
+
+
+template <typename T>
+void QuantizeUint8(const T* x, std::size_t n, T inverse, int zero, std::uint8_t* q);
+
+
+/*
+    Параметры квантования входа слоя. Observe расширяет диапазон по
+    калибровочным данным (он всегда содержит ноль), Calibrate считает по
+    нему масштаб и нулевую точку и начинает следующую калибровку заново
+*/
+template <typename T>
+struct Int8Activation
+{
+    T low = 0;
+    T high = 0;
+
+    T scale = 1;
+    int zero = 0;
+
+    void Observe(const T* x, std::size_t n)
+    {
+        for(std::size_t i = 0; i < n; ++i)
+        {
+            low = std::min(low, x[i]);
+            high = std::max(high, x[i]);
+        }
+    }
+
+    // Масштаб и нулевая точка по собранному диапазону
+    void Update()
+    {
+        scale = high > low ? (high - low) / 255 : 1;
+        zero = std::min(255, std::max(0, (int)std::lrint(-low / scale)));
+    }
+
+    void Calibrate()
+    {
+        Update();
+
+        low = high = 0;
+    }
+
+    void Quantize(const T* x, std::size_t n, std::uint8_t* q) const
+    {
+        QuantizeUint8(x, n, 1 / scale, zero, q);
+    }
+
+    /*
+        Обучение с учётом квантования: y = s_x * (q_x - z), то есть x,
+        каким его увидит слой в int8. Параметры - по собранному диапазону,
+        расширенному значениями x, сам диапазон не меняется. Округление то
+        же, что у Quantize (до ближайшего чётного)
+    */
+    void Simulate(const T* x, std::size_t n, T* y) const
+    {
+        Int8Activation<T> range = *this;
+
+        range.Observe(x, n);
+        range.Update();
+
+        const T inverse = 1 / range.scale;
+        const T lowest = (T)-range.zero;
+        const T highest = (T)(255 - range.zero);
+
+        for(std::size_t i = 0; i < n; ++i)
+            y[i] = range.scale * std::nearbyint(std::min(highest, std::max(lowest, x[i] * inverse)));
+    }
+};
+
+
+// Масштаб строки весов: max |a| / 127 (1 для нулевой строки)
+template <typename T>
+T Int8RowScale(const T* a, unsigned int N)
+{
+    T maximum = 0;
+
+    for(unsigned int j = 0; j < N; ++j)
+        maximum = std::max(maximum, std::abs(a[j]));
+
+    return maximum > 0 ? maximum / 127 : 1;
+}
+
+
+/*
+    Матрица весов в int8: строки по stride байт и alpha, beta каждой
+    строки для перевода сумм обратно в T
+*/
+template <typename T>
+struct Int8Matrix
+{
+    unsigned int rows = 0;
+    unsigned int columns = 0;
+    unsigned int stride = 0;
+
+    std::vector<std::int8_t> value;
+    std::vector<T> alpha;
+    std::vector<T> beta;
+
+    /*
+        A[M x N] (строки с шагом lda) со смещениями bias для входа,
+        квантованного как input
+    */
+    void Quantize(unsigned int M, unsigned int N, const T* A, unsigned int lda, const T* bias, const Int8Activation<T>& input)
+    {
+        rows = M;
+        columns = N;
+        stride = Int8Stride(N);
+
+        value.assign((std::size_t)M * stride, 0);
+        alpha.resize(M);
+        beta.resize(M);
+
+        for(unsigned int i = 0; i < M; ++i)
+        {
+            const T* a = A + (std::size_t)i * lda;
+            std::int8_t* q = value.data() + (std::size_t)i * stride;
+
+            const T scale = Int8RowScale(a, N);
+            const T inverse = 1 / scale;
+
+            std::int32_t sum = 0;
+
+            for(unsigned int j = 0; j < N; ++j)
+            {
+                q[j] = (std::int8_t)std::min(127L, std::max(-127L, std::lrint(a[j] * inverse)));
+                sum += q[j];
+            }
+
+            alpha[i] = input.scale * scale;
+            beta[i] = bias[i] - alpha[i] * input.zero * sum;
+        }
+    }
+
+    // Размер в памяти: веса и alpha, beta строк
+    std::size_t Bytes() const
+    {
+        return value.size() + (alpha.size() + beta.size()) * sizeof(T);
+    }
+};
+
+
+/*
+    Веса при обучении с учётом квантования. A[M x N] (строки с шагом lda)
+    держит веса такими, какими их увидит int8: s_w * q_w, и все проходы
+    слоя идут по ним. Настоящие веса - A + residual: обучение меняет A,
+    после чего настоящие веса снова раскладываются на сетку строки и
+    остаток. Градиент проходит через округление без изменений
+    (straight-through), а мелкие шаги копятся в остатке, пока не
+    перейдут на соседнюю точку сетки
+*/
+template <typename T>
+void SimulateInt8Rows(unsigned int M, unsigned int N, T* A, unsigned int lda, T* residual)
+{
+    for(unsigned int i = 0; i < M; ++i)
+    {
+        T* a = A + (std::size_t)i * lda;
+        T* r = residual + (std::size_t)i * N;
+
+        for(unsigned int j = 0; j < N; ++j)
+            a[j] += r[j];
+
+        const T scale = Int8RowScale(a, N);
+        const T inverse = 1 / scale;
+
+        for(unsigned int j = 0; j < N; ++j)
+        {
+            const T w = scale * std::nearbyint(a[j] * inverse);
+
+            r[j] = a[j] - w;
+            a[j] = w;
+        }
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    q[i] = round(x[i] * inverse) + zero в пределах [0, 255]
+
+    Округление до ближайшего чётного (lrint и vcvtps2dq в режиме по
+    умолчанию), поэтому все варианты дают одни и те же байты
+*/
+template <typename T>
+void QuantizeUint8Scalar(const T* x, std::size_t n, T inverse, int zero, std::uint8_t* q)
+{
+    const T low = (T)-zero;
+    const T high = (T)(255 - zero);
+
+    for(std::size_t i = 0; i < n; ++i)
+        q[i] = (std::uint8_t)(std::lrint(std::min(high, std::max(low, x[i] * inverse))) + zero);
+}
+
+
+/*
+    y[i] = sum_j x[j] * A[i][j] для uint8 x и int8 A в int32, N кратно
+    Int8Columns (полносвязный слой). Произведение не больше 255 * 127,
+    и сумма не переполняется при N до 66000
+
+    Строки, как в Gemv, идут блоками по Int8Rows, загруженный кусок x
+    используется для всех строк блока
+*/
+constexpr unsigned int Int8Rows = 4;
+
+
+inline void Int8GemvScalar(unsigned int M, unsigned int N, const std::int8_t* A, unsigned int lda, const std::uint8_t* x, std::int32_t* y)
+{
+    for(unsigned int i = 0; i < M; ++i)
+    {
+        const std::int8_t* a = A + (std::size_t)i * lda;
+
+        std::int32_t S = 0;
+
+        for(unsigned int j = 0; j < N; ++j)
+            S += (std::int32_t)x[j] * a[j];
+
+        y[i] = S;
+    }
+}
+
+
+/*
+    Развёртка im2col для свёртки в int8. Вход уже квантован и с
+    паддингом (depth x height x width). Элементы окна идут четвёрками -
+    так их перемножает vpdpbusd: для четвёрки g и позиции выхода p
+    четыре байта лежат подряд в col[(g * columns + p) * 4 ...]. Если
+    размер окна не кратен 4, недостающие элементы - нули
+*/
+inline void Im2ColInt8Scalar
+(
+    const std::uint8_t* X,
+    unsigned int depth, unsigned int height, unsigned int width,
+    unsigned int filter_size, unsigned int stride, unsigned int dilation,
+    unsigned int output_height, unsigned int output_width,
+    std::uint8_t* col
+)
+{
+    const unsigned int window = depth * filter_size * filter_size;
+    const unsigned int groups = (window + 3) / 4;
+    const unsigned int columns = output_height * output_width;
+
+    for(unsigned int g = 0; g < groups; ++g)
+    {
+        std::uint8_t* dst = col + (std::size_t)g * columns * 4;
+
+        for(unsigned int t = 0; t < 4; ++t)
+        {
+            const unsigned int k = 4 * g + t;
+
+            if (k >= window)
+            {
+                for(unsigned int p = 0; p < columns; ++p)
+                    dst[4 * p + t] = 0;
+
+                continue;
+            }
+
+            const unsigned int d = k / (filter_size * filter_size);
+            const unsigned int fh = k / filter_size % filter_size;
+            const unsigned int fw = k % filter_size;
+
+            const std::uint8_t* src = X + ((std::size_t)d * height + fh * dilation) * width + fw * dilation;
+
+            for(unsigned int oh = 0; oh < output_height; ++oh)
+                for(unsigned int ow = 0; ow < output_width; ++ow)
+                    dst[4 * (oh * output_width + ow) + t] = src[(std::size_t)oh * stride * width + ow * stride];
+        }
+    }
+}
+
+
+/*
+    Свёртка в int8 после Im2ColInt8:
+
+        Y[i][p] = alpha[i] * sum_k A[i][k] * col[k][p] + beta[i],
+
+    i - фильтр (строки A по lda байт), p - одна из N позиций выхода,
+    четвёрки col идут с шагом ldcol позиций
+
+    Позиции выхода - элементы вектора: четвёрка байтов фильтра
+    размножается по вектору, и суммы всех позиций блока копятся без
+    сложения внутри вектора. Блок фильтров использует загруженный кусок
+    col для всех своих строк. Суммы сразу переводятся в T и пишутся в Y
+*/
+template <typename T>
+void Int8GemmColumns(unsigned int M, unsigned int p0, unsigned int p1, unsigned int groups, const std::int8_t* A, unsigned int lda, const std::uint8_t* col, unsigned int ldcol, const T* alpha, const T* beta, T* Y, unsigned int ldy)
+{
+    for(unsigned int i = 0; i < M; ++i)
+    {
+        const std::int8_t* a = A + (std::size_t)i * lda;
+
+        for(unsigned int p = p0; p < p1; ++p)
+        {
+            std::int32_t S = 0;
+
+            for(unsigned int g = 0; g < groups; ++g)
+            {
+                const std::uint8_t* c = col + ((std::size_t)g * ldcol + p) * 4;
+
+                for(unsigned int t = 0; t < 4; ++t)
+                    S += (std::int32_t)c[t] * a[4 * g + t];
+            }
+
+            Y[(std::size_t)i * ldy + p] = alpha[i] * S + beta[i];
+        }
+    }
+}
+
+template <typename T>
+void Int8GemmScalar(unsigned int M, unsigned int N, unsigned int groups, const std::int8_t* A, unsigned int lda, const std::uint8_t* col, unsigned int ldcol, const T* alpha, const T* beta, T* Y, unsigned int ldy)
+{
+    Int8GemmColumns(M, 0, N, groups, A, lda, col, ldcol, alpha, beta, Y, ldy);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#if defined(CPU_X86)
+
+// 8 значений x * inverse в пределах [low, high], округлённых до int32
+CPU_TARGET_AVX2 inline __m256i QuantizeRound8(const float* x, float inverse, float low, float high)
+{
+    const __m256 v = _mm256_mul_ps(_mm256_loadu_ps(x), _mm256_set1_ps(inverse));
+    return _mm256_cvtps_epi32(_mm256_min_ps(_mm256_set1_ps(high), _mm256_max_ps(_mm256_set1_ps(low), v)));
+}
+
+CPU_TARGET_AVX2 inline __m256i QuantizeRound8(const double* x, double inverse, double low, double high)
+{
+    const __m256d v0 = _mm256_mul_pd(_mm256_loadu_pd(x), _mm256_set1_pd(inverse));
+    const __m256d v1 = _mm256_mul_pd(_mm256_loadu_pd(x + 4), _mm256_set1_pd(inverse));
+
+    const __m128i q0 = _mm256_cvtpd_epi32(_mm256_min_pd(_mm256_set1_pd(high), _mm256_max_pd(_mm256_set1_pd(low), v0)));
+    const __m128i q1 = _mm256_cvtpd_epi32(_mm256_min_pd(_mm256_set1_pd(high), _mm256_max_pd(_mm256_set1_pd(low), v1)));
+
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(q0), q1, 1);
+}
+
+/*
+    32 значения за шаг: четыре вектора int32 сжимаются до байтов (packs
+    и packus работают внутри половин регистра, порядок восстанавливает
+    перестановка)
+*/
+template <typename T>
+CPU_TARGET_AVX2 void QuantizeUint8Avx2(const T* x, std::size_t n, T inverse, int zero, std::uint8_t* q)
+{
+    const T low = (T)-zero;
+    const T high = (T)(255 - zero);
+
+    const __m256i z = _mm256_set1_epi32(zero);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    std::size_t i = 0;
+
+    for(; i + 32 <= n; i += 32)
+    {
+        const __m256i a = _mm256_add_epi32(QuantizeRound8(x + i, inverse, low, high), z);
+        const __m256i b = _mm256_add_epi32(QuantizeRound8(x + i + 8, inverse, low, high), z);
+        const __m256i c = _mm256_add_epi32(QuantizeRound8(x + i + 16, inverse, low, high), z);
+        const __m256i d = _mm256_add_epi32(QuantizeRound8(x + i + 24, inverse, low, high), z);
+
+        const __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+
+        _mm256_storeu_si256((__m256i*)(q + i), _mm256_permutevar8x32_epi32(bytes, order));
+    }
+
+    QuantizeUint8Scalar(x + i, n - i, inverse, zero, q + i);
+}
+
+
+/*
+    Без VNNI байты расширяются до int16, и пары произведений складываются
+    vpmaddwd - без насыщения, в отличие от vpmaddubsw
+*/
+template <unsigned int R>
+CPU_TARGET_AVX2 void Int8GemvBlockAvx2(unsigned int N, const std::int8_t* A, unsigned int lda, const std::uint8_t* x, std::int32_t* y)
+{
+    __m256i s[R];
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+        s[r] = _mm256_setzero_si256();
+
+    for(unsigned int j = 0; j < N; j += 16)
+    {
+        const __m256i xj = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(x + j)));
+
+        CPU_UNROLL
+        for(unsigned int r = 0; r < R; ++r)
+        {
+            const __m256i w = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(A + (std::size_t)r * lda + j)));
+            s[r] = _mm256_add_epi32(s[r], _mm256_madd_epi16(xj, w));
+        }
+    }
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+    {
+        __m128i v = _mm_add_epi32(_mm256_castsi256_si128(s[r]), _mm256_extracti128_si256(s[r], 1));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4E));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xB1));
+
+        y[r] = _mm_cvtsi128_si32(v);
+    }
+}
+
+CPU_TARGET_AVX2 inline void Int8GemvAvx2(unsigned int M, unsigned int N, const std::int8_t* A, unsigned int lda, const std::uint8_t* x, std::int32_t* y)
+{
+    unsigned int i = 0;
+
+    for(; i + Int8Rows <= M; i += Int8Rows)
+        Int8GemvBlockAvx2<Int8Rows>(N, A + (std::size_t)i * lda, lda, x, y + i);
+
+    for(; i < M; ++i)
+        Int8GemvBlockAvx2<1>(N, A + (std::size_t)i * lda, lda, x, y + i);
+}
+
+
+/*
+    При шаге 1 соседние позиции строки выхода берут соседние байты
+    входа: по 8 позиций четыре строки входа загружаются целиком и
+    переплетаются в четвёрки распаковками байтов
+*/
+CPU_TARGET_AVX2 inline void Im2ColInt8Avx2
+(
+    const std::uint8_t* X,
+    unsigned int depth, unsigned int height, unsigned int width,
+    unsigned int filter_size, unsigned int stride, unsigned int dilation,
+    unsigned int output_height, unsigned int output_width,
+    std::uint8_t* col
+)
+{
+    if (stride != 1)
+    {
+        Im2ColInt8Scalar(X, depth, height, width, filter_size, stride, dilation, output_height, output_width, col);
+        return;
+    }
+
+    const unsigned int window = depth * filter_size * filter_size;
+    const unsigned int groups = (window + 3) / 4;
+    const unsigned int columns = output_height * output_width;
+
+    const std::uint8_t* src[4];
+
+    for(unsigned int g = 0; g < groups; ++g)
+    {
+        for(unsigned int t = 0; t < 4; ++t)
+        {
+            const unsigned int k = 4 * g + t;
+
+            const unsigned int d = k / (filter_size * filter_size);
+            const unsigned int fh = k / filter_size % filter_size;
+            const unsigned int fw = k % filter_size;
+
+            src[t] = k < window ? X + ((std::size_t)d * height + fh * dilation) * width + fw * dilation : nullptr;
+        }
+
+        for(unsigned int oh = 0; oh < output_height; ++oh)
+        {
+            const std::size_t row = (std::size_t)oh * width;
+
+            std::uint8_t* dst = col + ((std::size_t)g * columns + oh * output_width) * 4;
+
+            unsigned int ow = 0;
+
+            for(; ow + 8 <= output_width; ow += 8)
+            {
+                __m128i s[4];
+
+                for(unsigned int t = 0; t < 4; ++t)
+                    s[t] = src[t] != nullptr ? _mm_loadl_epi64((const __m128i*)(src[t] + row + ow)) : _mm_setzero_si128();
+
+                const __m128i s01 = _mm_unpacklo_epi8(s[0], s[1]);
+                const __m128i s23 = _mm_unpacklo_epi8(s[2], s[3]);
+
+                _mm_storeu_si128((__m128i*)(dst + 4 * ow), _mm_unpacklo_epi16(s01, s23));
+                _mm_storeu_si128((__m128i*)(dst + 4 * ow + 16), _mm_unpackhi_epi16(s01, s23));
+            }
+
+            for(; ow < output_width; ++ow)
+                for(unsigned int t = 0; t < 4; ++t)
+                    dst[4 * ow + t] = src[t] != nullptr ? src[t][row + ow] : 0;
+        }
+    }
+}
+
+
+// Четвёрка байтов фильтра одним int32
+inline std::int32_t Int8Quad(const std::int8_t* a)
+{
+    std::int32_t quad;
+    std::memcpy(&quad, a, 4);
+    return quad;
+}
+
+// y[0 .. 7] = alpha * s + beta
+CPU_TARGET_AVX2 inline void Int8StoreAvx2(float* y, __m256i s, float alpha, float beta)
+{
+    _mm256_storeu_ps(y, _mm256_fmadd_ps(_mm256_cvtepi32_ps(s), _mm256_set1_ps(alpha), _mm256_set1_ps(beta)));
+}
+
+CPU_TARGET_AVX2 inline void Int8StoreAvx2(double* y, __m256i s, double alpha, double beta)
+{
+    _mm256_storeu_pd(y, _mm256_fmadd_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(s)), _mm256_set1_pd(alpha), _mm256_set1_pd(beta)));
+    _mm256_storeu_pd(y + 4, _mm256_fmadd_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(s, 1)), _mm256_set1_pd(alpha), _mm256_set1_pd(beta)));
+}
+
+/*
+    Блок R фильтров x 8 позиций. Четвёрки расширяются до int16, vpmaddwd
+    складывает пары, и у каждой позиции в аккумуляторе две половины
+    суммы - они складываются один раз в конце (hadd и перестановка)
+*/
+template <unsigned int R, typename T>
+CPU_TARGET_AVX2 void Int8GemmBlockAvx2(unsigned int groups, const std::int8_t* A, unsigned int lda, const std::uint8_t* col, unsigned int ldcol, const T* alpha, const T* beta, T* Y, unsigned int ldy)
+{
+    __m256i lo[R];
+    __m256i hi[R];
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+        lo[r] = hi[r] = _mm256_setzero_si256();
+
+    for(unsigned int g = 0; g < groups; ++g)
+    {
+        const std::uint8_t* c = col + (std::size_t)g * ldcol * 4;
+
+        const __m256i c0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)c));
+        const __m256i c1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(c + 16)));
+
+        CPU_UNROLL
+        for(unsigned int r = 0; r < R; ++r)
+        {
+            const __m256i w = _mm256_cvtepi8_epi16(_mm_set1_epi32(Int8Quad(A + (std::size_t)r * lda + 4 * g)));
+
+            lo[r] = _mm256_add_epi32(lo[r], _mm256_madd_epi16(c0, w));
+            hi[r] = _mm256_add_epi32(hi[r], _mm256_madd_epi16(c1, w));
+        }
+    }
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+        Int8StoreAvx2(Y + (std::size_t)r * ldy, _mm256_permute4x64_epi64(_mm256_hadd_epi32(lo[r], hi[r]), 0xD8), alpha[r], beta[r]);
+}
+
+template <typename T>
+CPU_TARGET_AVX2 void Int8GemmAvx2(unsigned int M, unsigned int N, unsigned int groups, const std::int8_t* A, unsigned int lda, const std::uint8_t* col, unsigned int ldcol, const T* alpha, const T* beta, T* Y, unsigned int ldy)
+{
+    unsigned int p = 0;
+
+    for(; p + 8 <= N; p += 8)
+    {
+        unsigned int i = 0;
+
+        for(; i + Int8Rows <= M; i += Int8Rows)
+            Int8GemmBlockAvx2<Int8Rows>(groups, A + (std::size_t)i * lda, lda, col + 4 * p, ldcol, alpha + i, beta + i, Y + (std::size_t)i * ldy + p, ldy);
+
+        for(; i < M; ++i)
+            Int8GemmBlockAvx2<1>(groups, A + (std::size_t)i * lda, lda, col + 4 * p, ldcol, alpha + i, beta + i, Y + (std::size_t)i * ldy + p, ldy);
+    }
+
+    Int8GemmColumns(M, p, N, groups, A, lda, col, ldcol, alpha, beta, Y, ldy);
+}
+
+
+/*
+    AVX-512 VNNI: vpdpbusd перемножает 64 пары байтов (uint8 * int8) и
+    добавляет суммы четвёрок в 16 int32
+*/
+template <unsigned int R>
+CPU_TARGET_AVX512_VNNI void Int8GemvBlockVnni(unsigned int N, const std::int8_t* A, unsigned int lda, const std::uint8_t* x, std::int32_t* y)
+{
+    __m512i s[R];
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+        s[r] = _mm512_setzero_si512();
+
+    for(unsigned int j = 0; j < N; j += 64)
+    {
+        const __m512i xj = _mm512_loadu_si512(x + j);
+
+        CPU_UNROLL
+        for(unsigned int r = 0; r < R; ++r)
+            s[r] = _mm512_dpbusd_epi32(s[r], xj, _mm512_loadu_si512(A + (std::size_t)r * lda + j));
+    }
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+    {
+        const __m256i v8 = _mm256_add_epi32(_mm512_maskz_extracti64x4_epi64(0xF, s[r], 0), _mm512_maskz_extracti64x4_epi64(0xF, s[r], 1));
+
+        __m128i v = _mm_add_epi32(_mm256_castsi256_si128(v8), _mm256_extracti128_si256(v8, 1));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4E));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xB1));
+
+        y[r] = _mm_cvtsi128_si32(v);
+    }
+}
+
+CPU_TARGET_AVX512_VNNI inline void Int8GemvVnni(unsigned int M, unsigned int N, const std::int8_t* A, unsigned int lda, const std::uint8_t* x, std::int32_t* y)
+{
+    unsigned int i = 0;
+
+    for(; i + Int8Rows <= M; i += Int8Rows)
+        Int8GemvBlockVnni<Int8Rows>(N, A + (std::size_t)i * lda, lda, x, y + i);
+
+    for(; i < M; ++i)
+        Int8GemvBlockVnni<1>(N, A + (std::size_t)i * lda, lda, x, y + i);
+}
+
+
+// y[0 .. 15] = alpha * s + beta, только позиции из mask
+CPU_TARGET_AVX512_VNNI inline void Int8StoreVnni(float* y, __m512i s, float alpha, float beta, __mmask16 mask)
+{
+    _mm512_mask_storeu_ps(y, mask, _mm512_fmadd_ps(_mm512_maskz_cvtepi32_ps(mask, s), _mm512_set1_ps(alpha), _mm512_set1_ps(beta)));
+}
+
+CPU_TARGET_AVX512_VNNI inline void Int8StoreVnni(double* y, __m512i s, double alpha, double beta, __mmask16 mask)
+{
+    const __m512d s0 = _mm512_maskz_cvtepi32_pd(0xFF, _mm512_maskz_extracti64x4_epi64(0xF, s, 0));
+    const __m512d s1 = _mm512_maskz_cvtepi32_pd(0xFF, _mm512_maskz_extracti64x4_epi64(0xF, s, 1));
+
+    _mm512_mask_storeu_pd(y, (__mmask8)mask, _mm512_fmadd_pd(s0, _mm512_set1_pd(alpha), _mm512_set1_pd(beta)));
+    _mm512_mask_storeu_pd(y + 8, (__mmask8)(mask >> 8), _mm512_fmadd_pd(s1, _mm512_set1_pd(alpha), _mm512_set1_pd(beta)));
+}
+
+/*
+    Блок R фильтров x 16 позиций, неполный последний блок позиций - по маске
+*/
+template <unsigned int R, typename T>
+CPU_TARGET_AVX512_VNNI void Int8GemmBlockVnni(unsigned int groups, const std::int8_t* A, unsigned int lda, const std::uint8_t* col, unsigned int ldcol, const T* alpha, const T* beta, T* Y, unsigned int ldy, __mmask16 mask)
+{
+    __m512i s[R];
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+        s[r] = _mm512_setzero_si512();
+
+    for(unsigned int g = 0; g < groups; ++g)
+    {
+        const __m512i c = _mm512_maskz_loadu_epi32(mask, col + (std::size_t)g * ldcol * 4);
+
+        CPU_UNROLL
+        for(unsigned int r = 0; r < R; ++r)
+            s[r] = _mm512_dpbusd_epi32(s[r], c, _mm512_set1_epi32(Int8Quad(A + (std::size_t)r * lda + 4 * g)));
+    }
+
+    CPU_UNROLL
+    for(unsigned int r = 0; r < R; ++r)
+        Int8StoreVnni(Y + (std::size_t)r * ldy, s[r], alpha[r], beta[r], mask);
+}
+
+template <typename T>
+CPU_TARGET_AVX512_VNNI void Int8GemmVnni(unsigned int M, unsigned int N, unsigned int groups, const std::int8_t* A, unsigned int lda, const std::uint8_t* col, unsigned int ldcol, const T* alpha, const T* beta, T* Y, unsigned int ldy)
+{
+    for(unsigned int p = 0; p < N; p += 16)
+    {
+        const __mmask16 mask = N - p >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (N - p)) - 1);
+
+        unsigned int i = 0;
+
+        for(; i + Int8Rows <= M; i += Int8Rows)
+            Int8GemmBlockVnni<Int8Rows>(groups, A + (std::size_t)i * lda, lda, col + 4 * p, ldcol, alpha + i, beta + i, Y + (std::size_t)i * ldy + p, ldy, mask);
+
+        for(; i < M; ++i)
+            Int8GemmBlockVnni<1>(groups, A + (std::size_t)i * lda, lda, col + 4 * p, ldcol, alpha + i, beta + i, Y + (std::size_t)i * ldy + p, ldy, mask);
+    }
+}
+
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Без VNNI на AVX-512 работают варианты AVX2. Квантованию входа и
+    развёртке ширина вектора почти не важна - у них вариант AVX2 на обоих
+*/
+template <typename T>
+void QuantizeUint8(const T* x, std::size_t n, T inverse, int zero, std::uint8_t* q)
+{
+    static const auto kernel = CPU_DISPATCH(&QuantizeUint8Scalar<T>, &QuantizeUint8Avx2<T>, &QuantizeUint8Avx2<T>);
+    kernel(x, n, inverse, zero, q);
+}
+
+inline void Int8Gemv(unsigned int M, unsigned int N, const std::int8_t* A, unsigned int lda, const std::uint8_t* x, std::int32_t* y)
+{
+    static const auto kernel = CPU_DISPATCH(&Int8GemvScalar, &Int8GemvAvx2, CpuHasAvx512Vnni() ? &Int8GemvVnni : &Int8GemvAvx2);
+    kernel(M, N, A, lda, x, y);
+}
+
+inline void Im2ColInt8
+(
+    const std::uint8_t* X,
+    unsigned int depth, unsigned int height, unsigned int width,
+    unsigned int filter_size, unsigned int stride, unsigned int dilation,
+    unsigned int output_height, unsigned int output_width,
+    std::uint8_t* col
+)
+{
+    static const auto kernel = CPU_DISPATCH(&Im2ColInt8Scalar, &Im2ColInt8Avx2, &Im2ColInt8Avx2);
+    kernel(X, depth, height, width, filter_size, stride, dilation, output_height, output_width, col);
+}
+
+template <typename T>
+void Int8Gemm(unsigned int M, unsigned int N, unsigned int groups, const std::int8_t* A, unsigned int lda, const std::uint8_t* col, unsigned int ldcol, const T* alpha, const T* beta, T* Y, unsigned int ldy)
+{
+    static const auto kernel = CPU_DISPATCH(&Int8GemmScalar<T>, &Int8GemmAvx2<T>, CpuHasAvx512Vnni() ? &Int8GemmVnni<T> : &Int8GemmAvx2<T>);
+    kernel(M, N, groups, A, lda, col, ldcol, alpha, beta, Y, ldy);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Общий пул потоков для ядер слоёв
+
+    ParallelFor(count, body) вызывает body(i) для i = 0 .. count - 1:
+    потоки пула и вызывающий поток разбирают номера по одному через
+    общий счётчик. Каждый номер - независимая часть работы (каналы
+    выхода, полосы строк, блоки примеров), поэтому результат не зависит
+    ни от числа потоков, ни от того, какой поток взял какой номер.
+    Если частям нужно что-то суммировать (градиент весов), каждая копит
+    в свой буфер, а буферы складываются после ParallelFor в порядке номеров
+
+    Вызов ParallelFor изнутри другого ParallelFor выполняется в том же
+    потоке последовательно
+
+    Число потоков по умолчанию - число ядер, его можно задать переменной
+    окружения ML_CPP_THREADS (1 - всё в вызывающем потоке) или Resize
+*/
+class ThreadPool
+{
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable done;
+
+    // Одновременно выполняется только одно задание
+    std::mutex call;
+
+    // Текущее задание
+    const std::function<void(std::size_t)>* body = nullptr;
+    std::size_t count = 0;
+    std::atomic<std::size_t> next{0};
+
+    unsigned int running = 0;
+    unsigned long generation = 0;
+    bool stopping = false;
+
+    static bool& Inside()
+    {
+        thread_local bool inside = false;
+        return inside;
+    }
+
+    void Drain()
+    {
+        Inside() = true;
+
+        for(std::size_t i = next++; i < count; i = next++)
+            (*body)(i);
+
+        Inside() = false;
+    }
+
+    // seen - номер последнего задания на момент создания потока
+    void Work(unsigned long seen)
+    {
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                start.wait(lock, [&]{ return stopping || generation != seen; });
+
+                if (stopping)
+                    return;
+
+                seen = generation;
+            }
+
+            Drain();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if (--running == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+    void Start(unsigned int threads)
+    {
+        stopping = false;
+
+        for(unsigned int t = 1; t < threads; ++t)
+            workers.emplace_back(&ThreadPool::Work, this, generation);
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        start.notify_all();
+
+        for(std::thread& worker : workers)
+            worker.join();
+
+        workers.clear();
+    }
+
+public:
+
+    explicit ThreadPool(unsigned int threads)
+    {
+        Start(threads);
+    }
+
+    ~ThreadPool()
+    {
+        Stop();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static unsigned int DefaultThreads()
+    {
+        const char* value = std::getenv("ML_CPP_THREADS");
+
+        if (value != nullptr && std::atoi(value) > 0)
+            return std::atoi(value);
+
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    static ThreadPool& Shared()
+    {
+        static ThreadPool pool(DefaultThreads());
+        return pool;
+    }
+
+    /*
+        Число потоков вместе с вызывающим
+    */
+    unsigned int size() const
+    {
+        return workers.size() + 1;
+    }
+
+    void Resize(unsigned int threads)
+    {
+        std::lock_guard<std::mutex> lock(call);
+
+        Stop();
+        Start(std::max(1u, threads));
+    }
+
+    void ParallelFor(std::size_t count, const std::function<void(std::size_t)>& body)
+    {
+        if (count <= 1 || workers.empty() || Inside())
+        {
+            for(std::size_t i = 0; i < count; ++i)
+                body(i);
+
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(call);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            this->body = &body;
+            this->count = count;
+            next = 0;
+
+            running = workers.size();
+            ++generation;
+        }
+
+        start.notify_all();
+
+        Drain();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]{ return running == 0; });
+    }
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
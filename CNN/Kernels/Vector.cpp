@@ -0,0 +1,303 @@
+#ifndef VECTOR_KERNELS
+#define VECTOR_KERNELS
+
+#include <cstddef>
+
+#include "CpuFeatures.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Поэлементные операции над непрерывными массивами с выбором
+    варианта под процессор во время выполнения:
+
+    VectorDot               - скалярное произведение
+    VectorAxpy              - y += alpha * x
+    VectorScale             - x *= alpha
+    VectorLeakyRelu         - y = x >= 0 ? x : slope * x  (ReLU при slope = 0)
+    VectorLeakyReluBackward - out = x >= 0 ? g : slope * g
+*/
+
+template <typename T>
+T VectorDotScalar(const T* a, const T* b, std::size_t n)
+{
+    T S = 0;
+
+    for(std::size_t i = 0; i < n; ++i)
+        S += a[i] * b[i];
+
+    return S;
+}
+
+template <typename T>
+void VectorAxpyScalar(T alpha, const T* x, T* y, std::size_t n)
+{
+    for(std::size_t i = 0; i < n; ++i)
+        y[i] += alpha * x[i];
+}
+
+template <typename T>
+void VectorScaleScalar(T* x, T alpha, std::size_t n)
+{
+    for(std::size_t i = 0; i < n; ++i)
+        x[i] *= alpha;
+}
+
+template <typename T>
+void VectorLeakyReluScalar(const T* x, T* y, std::size_t n, T slope)
+{
+    for(std::size_t i = 0; i < n; ++i)
+        y[i] = x[i] >= 0 ? x[i] : slope * x[i];
+}
+
+template <typename T>
+void VectorLeakyReluBackwardScalar(const T* x, const T* g, T* out, std::size_t n, T slope)
+{
+    for(std::size_t i = 0; i < n; ++i)
+        out[i] = x[i] >= 0 ? g[i] : slope * g[i];
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#if defined(CPU_X86)
+
+template <typename T>
+CPU_TARGET_AVX2 T VectorDotAvx2(const T* a, const T* b, std::size_t n)
+{
+    typedef Avx2Vector<T> V;
+
+    typename V::Vec s0 = V::Zero();
+    typename V::Vec s1 = V::Zero();
+
+    std::size_t i = 0;
+
+    for(; i + 2 * V::W <= n; i += 2 * V::W)
+    {
+        s0 = V::Fmadd(V::Load(a + i), V::Load(b + i), s0);
+        s1 = V::Fmadd(V::Load(a + i + V::W), V::Load(b + i + V::W), s1);
+    }
+
+    for(; i + V::W <= n; i += V::W)
+        s0 = V::Fmadd(V::Load(a + i), V::Load(b + i), s0);
+
+    T S = V::Sum(V::Add(s0, s1));
+
+    for(; i < n; ++i)
+        S += a[i] * b[i];
+
+    return S;
+}
+
+template <typename T>
+CPU_TARGET_AVX512 T VectorDotAvx512(const T* a, const T* b, std::size_t n)
+{
+    typedef Avx512Vector<T> V;
+
+    typename V::Vec s0 = V::Zero();
+    typename V::Vec s1 = V::Zero();
+
+    std::size_t i = 0;
+
+    for(; i + 2 * V::W <= n; i += 2 * V::W)
+    {
+        s0 = V::Fmadd(V::Load(a + i), V::Load(b + i), s0);
+        s1 = V::Fmadd(V::Load(a + i + V::W), V::Load(b + i + V::W), s1);
+    }
+
+    for(; i + V::W <= n; i += V::W)
+        s0 = V::Fmadd(V::Load(a + i), V::Load(b + i), s0);
+
+    T S = V::Sum(V::Add(s0, s1));
+
+    for(; i < n; ++i)
+        S += a[i] * b[i];
+
+    return S;
+}
+
+
+template <typename T>
+CPU_TARGET_AVX2 void VectorAxpyAvx2(T alpha, const T* x, T* y, std::size_t n)
+{
+    typedef Avx2Vector<T> V;
+
+    const typename V::Vec a = V::Set(alpha);
+
+    std::size_t i = 0;
+
+    for(; i + V::W <= n; i += V::W)
+        V::Store(y + i, V::Fmadd(a, V::Load(x + i), V::Load(y + i)));
+
+    for(; i < n; ++i)
+        y[i] += alpha * x[i];
+}
+
+template <typename T>
+CPU_TARGET_AVX512 void VectorAxpyAvx512(T alpha, const T* x, T* y, std::size_t n)
+{
+    typedef Avx512Vector<T> V;
+
+    const typename V::Vec a = V::Set(alpha);
+
+    std::size_t i = 0;
+
+    for(; i + V::W <= n; i += V::W)
+        V::Store(y + i, V::Fmadd(a, V::Load(x + i), V::Load(y + i)));
+
+    for(; i < n; ++i)
+        y[i] += alpha * x[i];
+}
+
+
+template <typename T>
+CPU_TARGET_AVX2 void VectorScaleAvx2(T* x, T alpha, std::size_t n)
+{
+    typedef Avx2Vector<T> V;
+
+    const typename V::Vec a = V::Set(alpha);
+
+    std::size_t i = 0;
+
+    for(; i + V::W <= n; i += V::W)
+        V::Store(x + i, V::Mul(V::Load(x + i), a));
+
+    for(; i < n; ++i)
+        x[i] *= alpha;
+}
+
+template <typename T>
+CPU_TARGET_AVX512 void VectorScaleAvx512(T* x, T alpha, std::size_t n)
+{
+    typedef Avx512Vector<T> V;
+
+    const typename V::Vec a = V::Set(alpha);
+
+    std::size_t i = 0;
+
+    for(; i + V::W <= n; i += V::W)
+        V::Store(x + i, V::Mul(V::Load(x + i), a));
+
+    for(; i < n; ++i)
+        x[i] *= alpha;
+}
+
+
+template <typename T>
+CPU_TARGET_AVX2 void VectorLeakyReluAvx2(const T* x, T* y, std::size_t n, T slope)
+{
+    typedef Avx2Vector<T> V;
+
+    const typename V::Vec s = V::Set(slope);
+
+    std::size_t i = 0;
+
+    for(; i + V::W <= n; i += V::W)
+    {
+        typename V::Vec v = V::Load(x + i);
+        V::Store(y + i, V::SelectNonNegative(v, v, V::Mul(v, s)));
+    }
+
+    for(; i < n; ++i)
+        y[i] = x[i] >= 0 ? x[i] : slope * x[i];
+}
+
+template <typename T>
+CPU_TARGET_AVX512 void VectorLeakyReluAvx512(const T* x, T* y, std::size_t n, T slope)
+{
+    typedef Avx512Vector<T> V;
+
+    const typename V::Vec s = V::Set(slope);
+
+    std::size_t i = 0;
+
+    for(; i + V::W <= n; i += V::W)
+    {
+        typename V::Vec v = V::Load(x + i);
+        V::Store(y + i, V::SelectNonNegative(v, v, V::Mul(v, s)));
+    }
+
+    for(; i < n; ++i)
+        y[i] = x[i] >= 0 ? x[i] : slope * x[i];
+}
+
+
+template <typename T>
+CPU_TARGET_AVX2 void VectorLeakyReluBackwardAvx2(const T* x, const T* g, T* out, std::size_t n, T slope)
+{
+    typedef Avx2Vector<T> V;
+
+    const typename V::Vec s = V::Set(slope);
+
+    std::size_t i = 0;
+
+    for(; i + V::W <= n; i += V::W)
+    {
+        typename V::Vec v = V::Load(g + i);
+        V::Store(out + i, V::SelectNonNegative(V::Load(x + i), v, V::Mul(v, s)));
+    }
+
+    for(; i < n; ++i)
+        out[i] = x[i] >= 0 ? g[i] : slope * g[i];
+}
+
+template <typename T>
+CPU_TARGET_AVX512 void VectorLeakyReluBackwardAvx512(const T* x, const T* g, T* out, std::size_t n, T slope)
+{
+    typedef Avx512Vector<T> V;
+
+    const typename V::Vec s = V::Set(slope);
+
+    std::size_t i = 0;
+
+    for(; i + V::W <= n; i += V::W)
+    {
+        typename V::Vec v = V::Load(g + i);
+        V::Store(out + i, V::SelectNonNegative(V::Load(x + i), v, V::Mul(v, s)));
+    }
+
+    for(; i < n; ++i)
+        out[i] = x[i] >= 0 ? g[i] : slope * g[i];
+}
+
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+template <typename T>
+T VectorDot(const T* a, const T* b, std::size_t n)
+{
+    static const auto kernel = CPU_DISPATCH(&VectorDotScalar<T>, &VectorDotAvx2<T>, &VectorDotAvx512<T>);
+    return kernel(a, b, n);
+}
+
+template <typename T>
+void VectorAxpy(T alpha, const T* x, T* y, std::size_t n)
+{
+    static const auto kernel = CPU_DISPATCH(&VectorAxpyScalar<T>, &VectorAxpyAvx2<T>, &VectorAxpyAvx512<T>);
+    kernel(alpha, x, y, n);
+}
+
+template <typename T>
+void VectorScale(T* x, T alpha, std::size_t n)
+{
+    static const auto kernel = CPU_DISPATCH(&VectorScaleScalar<T>, &VectorScaleAvx2<T>, &VectorScaleAvx512<T>);
+    kernel(x, alpha, n);
+}
+
+template <typename T>
+void VectorLeakyRelu(const T* x, T* y, std::size_t n, T slope)
+{
+    static const auto kernel = CPU_DISPATCH(&VectorLeakyReluScalar<T>, &VectorLeakyReluAvx2<T>, &VectorLeakyReluAvx512<T>);
+    kernel(x, y, n, slope);
+}
+
+template <typename T>
+void VectorLeakyReluBackward(const T* x, const T* g, T* out, std::size_t n, T slope)
+{
+    static const auto kernel = CPU_DISPATCH(&VectorLeakyReluBackwardScalar<T>, &VectorLeakyReluBackwardAvx2<T>, &VectorLeakyReluBackwardAvx512<T>);
+    kernel(x, g, out, n, slope);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
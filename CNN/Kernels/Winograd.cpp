@@ -0,0 +1,376 @@
+#ifndef WINOGRAD
+#define WINOGRAD
+
+#include <vector>
+#include <algorithm>
+
+#include "Vector.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Свёртка Винограда F(m x m, r x r): плитка выхода m x m считается из
+    плитки входа alpha x alpha (alpha = m + r - 1) за alpha^2 умножений
+    вместо m^2 * r^2:
+
+        Y = AT * [ (G * g * GT) .* (BT * d * B) ] * A
+
+    Матрицы строятся по схеме Кука-Тоома на точках 0, 1, -1, 2, -2, 1/2, ...
+    и бесконечности, поэтому подходят любые m и r. Для малых плиток
+    (F(2x2,3x3), F(4x4,3x3), F(2x2,5x5)) погрешность остаётся на уровне
+    обычной свёртки даже во float
+*/
+template <typename T>
+struct WinogradTransform
+{
+    unsigned int m = 0;
+    unsigned int r = 0;
+    unsigned int alpha = 0;
+
+    std::vector<T> AT; // m x alpha
+    std::vector<T> G;  // alpha x r
+    std::vector<T> BT; // alpha x alpha
+
+    void Initialize(unsigned int m, unsigned int r)
+    {
+        this->m = m;
+        this->r = r;
+        this->alpha = m + r - 1;
+
+        const unsigned int n = alpha;
+
+        // Конечные точки интерполяции, последняя точка - бесконечность
+        std::vector<double> points(n - 1);
+
+        for(unsigned int j = 0; j + 1 < n; ++j)
+        {
+            if (j == 0)
+                points[j] = 0;
+            else if (j <= 4)
+                points[j] = (j % 2 ? 1.0 : -1.0) * ((j + 1) / 2);
+            else
+                points[j] = (j % 2 ? 1.0 : -1.0) / ((j - 3) / 2 + 1);
+        }
+
+        AT.assign((std::size_t)m * n, 0);
+        G.assign((std::size_t)n * r, 0);
+        BT.assign((std::size_t)n * n, 0);
+
+        for(unsigned int i = 0; i < m; ++i)
+        {
+            for(unsigned int j = 0; j + 1 < n; ++j)
+                AT[i * n + j] = (T)Power(points[j], i);
+
+            AT[i * n + n - 1] = i == m - 1 ? 1 : 0;
+        }
+
+        for(unsigned int j = 0; j + 1 < n; ++j)
+        {
+            double f = 1;
+
+            for(unsigned int l = 0; l + 1 < n; ++l)
+                if (l != j)
+                    f *= points[j] - points[l];
+
+            for(unsigned int k = 0; k < r; ++k)
+                G[j * r + k] = (T)(Power(points[j], k) / f);
+
+            // Коэффициенты N_j(x) = произведение (x - p_l) по l != j
+            std::vector<double> poly = Polynomial(points, j);
+
+            for(unsigned int k = 0; k < poly.size(); ++k)
+                BT[j * n + k] = (T)poly[k];
+        }
+
+        G[(std::size_t)(n - 1) * r + r - 1] = 1;
+
+        // Последняя строка - коэффициенты M(x) = произведение (x - p_l) по всем l
+        std::vector<double> poly = Polynomial(points, n);
+
+        for(unsigned int k = 0; k < poly.size(); ++k)
+            BT[(std::size_t)(n - 1) * n + k] = (T)poly[k];
+    }
+
+private:
+
+    static double Power(double x, unsigned int k)
+    {
+        double p = 1;
+
+        for(unsigned int i = 0; i < k; ++i)
+            p *= x;
+
+        return p;
+    }
+
+    static std::vector<double> Polynomial(const std::vector<double>& points, unsigned int skip)
+    {
+        std::vector<double> poly = { 1 };
+
+        for(unsigned int l = 0; l < points.size(); ++l)
+        {
+            if (l == skip)
+                continue;
+
+            std::vector<double> next(poly.size() + 1, 0);
+
+            for(unsigned int k = 0; k < poly.size(); ++k)
+            {
+                next[k + 1] += poly[k];
+                next[k] -= poly[k] * points[l];
+            }
+
+            poly = next;
+        }
+
+        return poly;
+    }
+};
+
+
+/*
+    Размер плитки выхода для фильтра K x K, 0 - свёртка Винограда не подходит
+*/
+inline unsigned int WinogradOutputTile(unsigned int filter_size)
+{
+    if (filter_size == 3)
+        return 4;
+
+    if (filter_size >= 2 && filter_size <= 5)
+        return 2;
+
+    return 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    U = G * g * GT для одного канала фильтра r x r.
+    Элемент (i, j) записывается в U[(i * alpha + j) * stride]
+*/
+template <typename T>
+void WinogradFilterTransform(const WinogradTransform<T>& wt, const T* g, T* U, std::size_t stride)
+{
+    const unsigned int alpha = wt.alpha;
+    const unsigned int r = wt.r;
+
+    std::vector<T> tmp((std::size_t)alpha * r, 0);
+
+    for(unsigned int i = 0; i < alpha; ++i)
+        for(unsigned int k = 0; k < r; ++k)
+            for(unsigned int c = 0; c < r; ++c)
+                tmp[i * r + c] += wt.G[i * r + k] * g[k * r + c];
+
+    for(unsigned int i = 0; i < alpha; ++i)
+    {
+        for(unsigned int j = 0; j < alpha; ++j)
+        {
+            T S = 0;
+
+            for(unsigned int c = 0; c < r; ++c)
+                S += tmp[i * r + c] * wt.G[j * r + c];
+
+            U[(std::size_t)(i * alpha + j) * stride] = S;
+        }
+    }
+}
+
+
+/*
+    V = BT * d * B для всех плиток входа одного примера
+
+    Плитки соседних выходов перекрываются на r - 1 элемент, выход за
+    границы входа (паддинг и неполные крайние плитки) заполняется нулями.
+    Результат раскладывается как V[alpha^2][depth][columns], где columns -
+    плитки всех примеров батча (пример пишет свои плитки со смещением,
+    уже учтённым в указателе V). Для каждой из alpha^2 частот получается
+    одно умножение матриц на весь батч
+
+    Преобразование идёт сразу по всем плиткам канала: внутренний цикл
+    бежит по плиткам векторным ядром, нулевые коэффициенты BT пропускаются
+*/
+template <typename T>
+void WinogradInputTransform
+(
+    const WinogradTransform<T>& wt,
+    const T* X,
+    unsigned int depth, unsigned int height, unsigned int width, unsigned int padding,
+    unsigned int tiles_h, unsigned int tiles_w,
+    T* tiles, T* tmp, T* V, std::size_t columns
+)
+{
+    const unsigned int m = wt.m;
+    const unsigned int alpha = wt.alpha;
+    const unsigned int P = tiles_h * tiles_w;
+
+    for(unsigned int d = 0; d < depth; ++d)
+    {
+        const T* x = X + (std::size_t)d * height * width;
+
+        // tiles[a][b][p] - элемент (a, b) плитки p
+        for(unsigned int a = 0; a < alpha; ++a)
+        {
+            for(unsigned int b = 0; b < alpha; ++b)
+            {
+                T* dst = tiles + (std::size_t)(a * alpha + b) * P;
+
+                for(unsigned int th = 0; th < tiles_h; ++th)
+                {
+                    int i = (int)(th * m + a) - (int)padding;
+
+                    for(unsigned int tw = 0; tw < tiles_w; ++tw)
+                    {
+                        int j = (int)(tw * m + b) - (int)padding;
+
+                        bool inside = i >= 0 && i < (int)height && j >= 0 && j < (int)width;
+
+                        dst[th * tiles_w + tw] = inside ? x[(std::size_t)i * width + j] : 0;
+                    }
+                }
+            }
+        }
+
+        // tmp = BT * tiles
+        std::fill(tmp, tmp + (std::size_t)alpha * alpha * P, 0);
+
+        for(unsigned int i = 0; i < alpha; ++i)
+        {
+            for(unsigned int a = 0; a < alpha; ++a)
+            {
+                const T c = wt.BT[i * alpha + a];
+
+                if (c == 0)
+                    continue;
+
+                for(unsigned int b = 0; b < alpha; ++b)
+                {
+                    T* dst = tmp + (std::size_t)(i * alpha + b) * P;
+                    const T* src = tiles + (std::size_t)(a * alpha + b) * P;
+
+                    VectorAxpy(c, src, dst, P);
+                }
+            }
+        }
+
+        // V = tmp * B
+        for(unsigned int i = 0; i < alpha; ++i)
+        {
+            for(unsigned int j = 0; j < alpha; ++j)
+            {
+                T* dst = V + ((std::size_t)(i * alpha + j) * depth + d) * columns;
+
+                for(unsigned int p = 0; p < P; ++p)
+                    dst[p] = 0;
+
+                for(unsigned int b = 0; b < alpha; ++b)
+                {
+                    const T c = wt.BT[j * alpha + b];
+
+                    if (c == 0)
+                        continue;
+
+                    const T* src = tmp + (std::size_t)(i * alpha + b) * P;
+
+                    VectorAxpy(c, src, dst, P);
+                }
+            }
+        }
+    }
+}
+
+
+/*
+    Y = AT * M * A для всех плиток одного примера плюс смещение.
+    M раскладывается как M[alpha^2][filters][columns], из крайних
+    плиток записываются только элементы, попадающие в выход.
+    Размер tmp - (m * alpha + m * m) * tiles
+*/
+template <typename T>
+void WinogradOutputTransform
+(
+    const WinogradTransform<T>& wt,
+    const T* M,
+    unsigned int filter_count, unsigned int tiles_h, unsigned int tiles_w,
+    unsigned int output_height, unsigned int output_width,
+    const T* bias,
+    T* tmp, T* Y, std::size_t columns
+)
+{
+    const unsigned int m = wt.m;
+    const unsigned int alpha = wt.alpha;
+    const unsigned int P = tiles_h * tiles_w;
+
+    T* out = tmp + (std::size_t)m * alpha * P;
+
+    for(unsigned int f = 0; f < filter_count; ++f)
+    {
+        // tmp[x][j][p] = AT * M
+        std::fill(tmp, tmp + (std::size_t)m * alpha * P, 0);
+
+        for(unsigned int x = 0; x < m; ++x)
+        {
+            for(unsigned int i = 0; i < alpha; ++i)
+            {
+                const T c = wt.AT[x * alpha + i];
+
+                if (c == 0)
+                    continue;
+
+                for(unsigned int j = 0; j < alpha; ++j)
+                {
+                    T* dst = tmp + (std::size_t)(x * alpha + j) * P;
+                    const T* src = M + ((std::size_t)(i * alpha + j) * filter_count + f) * columns;
+
+                    VectorAxpy(c, src, dst, P);
+                }
+            }
+        }
+
+        // out[x][z][p] = tmp * A + смещение
+        for(unsigned int x = 0; x < m; ++x)
+        {
+            for(unsigned int z = 0; z < m; ++z)
+            {
+                T* dst = out + (std::size_t)(x * m + z) * P;
+
+                for(unsigned int p = 0; p < P; ++p)
+                    dst[p] = bias[f];
+
+                for(unsigned int j = 0; j < alpha; ++j)
+                {
+                    const T c = wt.AT[z * alpha + j];
+
+                    if (c == 0)
+                        continue;
+
+                    const T* src = tmp + (std::size_t)(x * alpha + j) * P;
+
+                    VectorAxpy(c, src, dst, P);
+                }
+            }
+        }
+
+        // Раскладка плиток обратно в карту выхода
+        T* y = Y + (std::size_t)f * output_height * output_width;
+
+        for(unsigned int th = 0; th < tiles_h; ++th)
+        {
+            for(unsigned int x = 0; x < m && th * m + x < output_height; ++x)
+            {
+                T* y_row = y + (std::size_t)(th * m + x) * output_width;
+
+                for(unsigned int tw = 0; tw < tiles_w; ++tw)
+                {
+                    const unsigned int p = th * tiles_w + tw;
+
+                    for(unsigned int z = 0; z < m && tw * m + z < output_width; ++z)
+                        y_row[tw * m + z] = out[(std::size_t)(x * m + z) * P + p];
+                }
+            }
+        }
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
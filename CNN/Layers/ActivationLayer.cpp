@@ -6,6 +6,7 @@
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+template <typename T>
 class ActivationLayer
 {
 
@@ -15,144 +16,172 @@ public:
 
     ActivationLayer()
     {
-        activation_function = identical;
-        d_activation_function = d_identical;
+        activation_function = &ActivationLayer::identical;
+        d_activation_function = &ActivationLayer::d_identical;
     }
 
     void SetActivationType(ActivationType activation_type)
     {        
+        this->activation_type = activation_type;
+
         switch (activation_type)
         {
         case ActivationType::Sigmoid:
-            activation_function = sigmoid;
-            d_activation_function = d_sigmoid;
+            activation_function = &ActivationLayer::sigmoid;
+            d_activation_function = &ActivationLayer::d_sigmoid;
             break;
         case ActivationType::LeakyReLU:
-            activation_function = leaky_relu;
-            d_activation_function = d_leaky_relu;
+            activation_function = &ActivationLayer::leaky_relu;
+            d_activation_function = &ActivationLayer::d_leaky_relu;
             break;
         case ActivationType::ReLU:
-            activation_function = relu;
-            d_activation_function = d_relu;
+            activation_function = &ActivationLayer::relu;
+            d_activation_function = &ActivationLayer::d_relu;
             break;
         case ActivationType::SoftPlus:
-            activation_function = softplus;
-            d_activation_function = d_softplus;
+            activation_function = &ActivationLayer::softplus;
+            d_activation_function = &ActivationLayer::d_softplus;
             break;
         case ActivationType::Tanh:
-            activation_function = tanh;
-            d_activation_function = d_tanh;
+            activation_function = &ActivationLayer::tanh;
+            d_activation_function = &ActivationLayer::d_tanh;
             break;
         case ActivationType::None:
-            activation_function = identical;
-            d_activation_function = d_identical;
+            activation_function = &ActivationLayer::identical;
+            d_activation_function = &ActivationLayer::d_identical;
             break;
         }
     }
 
-    Tensor Forward(const Tensor& X)
+    /*
+        Функция и её производная в одной точке - для слоёв, которые
+        применяют активацию внутри своего прохода
+    */
+    T Apply(T x)
+    {
+        return (this->*activation_function)(x);
+    }
+
+    T Derivative(T x)
     {
-        Tensor Y = Tensor(X.get_depth(), X.get_height(), X.get_width());
+        return (this->*d_activation_function)(x);
+    }
+
+    Tensor<T> Forward(const Tensor<T>& X)
+    {
+        Tensor<T> Y = Tensor<T>(X.get_batch(), X.get_depth(), X.get_height(), X.get_width(), 0);
+
+        const T* x = X.data();
+        T* y = Y.data();
 
-        for(unsigned int d = 0; d < X.get_depth(); ++d)
+        // ReLU и LeakyReLU считаются векторным ядром
+        if (activation_type == ActivationType::ReLU || activation_type == ActivationType::LeakyReLU)
         {
-            for(unsigned int h = 0; h < X.get_height(); ++h)
-            {
-                for(unsigned int w = 0; w < X.get_width(); ++w)
-                {
-                    Y[d][h][w] = (this->*activation_function)(X(d, h, w));
-                }
-            }
+            VectorLeakyRelu(x, y, X.size(), slope());
+            return Y;
         }
 
+        for(std::size_t i = 0; i < X.size(); ++i)
+            y[i] = (this->*activation_function)(x[i]);
+
         return Y;
     }
 
-    Tensor Backward(const Tensor& X, const Tensor& GFNL)
+    Tensor<T> Backward(const Tensor<T>& X, const Tensor<T>& GFNL)
     {
-        Tensor GFCL = Tensor(X.get_depth(), X.get_height(), X.get_width());
+        Tensor<T> GFCL = Tensor<T>(X.get_batch(), X.get_depth(), X.get_height(), X.get_width(), 0);
+
+        const T* x = X.data();
+        const T* g = GFNL.data();
+        T* gfcl = GFCL.data();
 
-        for(unsigned int d = 0; d < X.get_depth(); ++d)
+        if (activation_type == ActivationType::ReLU || activation_type == ActivationType::LeakyReLU)
         {
-            for(unsigned int h = 0; h < X.get_height(); ++h)
-            {
-                for(unsigned int w = 0; w < X.get_width(); ++w)
-                {
-                    GFCL[d][h][w] = (this->*d_activation_function)(X(d, h, w)) * GFNL(d, h, w);
-                }
-            }
+            VectorLeakyReluBackward(x, g, gfcl, X.size(), slope());
+            return GFCL;
         }
 
+        for(std::size_t i = 0; i < X.size(); ++i)
+            gfcl[i] = (this->*d_activation_function)(x[i]) * g[i];
+
         return GFCL;
     }
     
 private:
 
-    double (ActivationLayer::*activation_function) (double);
-    double (ActivationLayer::*d_activation_function) (double);
+    ActivationType activation_type = ActivationType::None;
+
+    T (ActivationLayer::*activation_function) (T);
+    T (ActivationLayer::*d_activation_function) (T);
+
+    // Наклон отрицательной части для ReLU (0) и LeakyReLU
+    T slope() const
+    {
+        return activation_type == ActivationType::LeakyReLU ? (T)0.01 : 0;
+    }
 
-    double identical(double x)
+    T identical(T x)
     {
         return x;
     }
 
-    double d_identical(double x)
+    T d_identical(T x)
     {
         return 1;
     }
 
 
-    double sigmoid(double x) 
+    T sigmoid(T x) 
     { 
-        return 1/(1 + exp(-x)); 
+        return 1/(1 + std::exp(-x)); 
     }
 
-    double d_sigmoid(double x) 
+    T d_sigmoid(T x) 
     {
-        double sigm = sigmoid(x);
+        T sigm = sigmoid(x);
         return sigm * (1 - sigm);
     }
 
 
-    double tanh(double x)
+    T tanh(T x)
     {
         return std::tanh(x);
     }
 
-    double d_tanh(double x)
+    T d_tanh(T x)
     {
-        return 1 - pow(std::tanh(x),2);
+        return 1 - std::pow(std::tanh(x),2);
     }
 
 
-    double relu(double x)
+    T relu(T x)
     {
         return x >= 0 ? x : 0;
     }
 
-    double d_relu(double x)
+    T d_relu(T x)
     {
         return x >= 0 ? 1 : 0;
     }
 
 
-    double leaky_relu(double x)
+    T leaky_relu(T x)
     {
         return x >= 0 ? x : 0.01 * x;
     }
 
-    double d_leaky_relu(double x)
+    T d_leaky_relu(T x)
     {
         return x >= 0 ? 1 : 0.01;
     }
 
 
-    double softplus(double x)
+    T softplus(T x)
     {
-        return log(1 + exp(x));
+        return std::log(1 + std::exp(x));
     }
 
-    double d_softplus(double x)
+    T d_softplus(T x)
     {
         return sigmoid(x);
     }
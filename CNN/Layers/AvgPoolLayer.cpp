@@ -7,6 +7,7 @@
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
 
+template <typename T>
 class AvgPoolLayer
 {
     unsigned int XD;
@@ -41,7 +42,7 @@ public:
         kernel_size_squared = kernel_size * kernel_size;
     }
 
-    Tensor Forward(const Tensor& X) 
+    Tensor<T> Forward(const Tensor<T>& X) 
     {
         if (X.get_height() != XH || X.get_width() != XW || X.get_depth() != XD)
         {
@@ -49,28 +50,33 @@ public:
             throw;
         }
 
-        Tensor Y = Tensor(YD, YH, YW);
-        
-        for(unsigned int d = 0; d < YD; ++d)
+        const unsigned int batch = X.get_batch();
+
+        Tensor<T> Y = Tensor<T>(batch, YD, YH, YW, 0);
+
+        for(unsigned int n = 0; n < batch; ++n)
         {
-            for(unsigned int h = 0; h < YH; ++h)
+            for(unsigned int d = 0; d < YD; ++d)
             {
-                for(unsigned int w = 0; w < YW; ++w)
+                for(unsigned int h = 0; h < YH; ++h)
                 {
-                    unsigned int window_top = kernel_stride * h;
-                    unsigned int window_bottom = window_top + kernel_size;
-                    unsigned int window_left = kernel_stride * w;
-                    unsigned int window_right = window_left + kernel_size;
-
-                    for(unsigned int kh = window_top; kh < window_bottom; ++kh)
+                    for(unsigned int w = 0; w < YW; ++w)
                     {
-                        for(unsigned int kw = window_left; kw < window_right; ++kw)
+                        unsigned int window_top = kernel_stride * h;
+                        unsigned int window_bottom = window_top + kernel_size;
+                        unsigned int window_left = kernel_stride * w;
+                        unsigned int window_right = window_left + kernel_size;
+
+                        for(unsigned int kh = window_top; kh < window_bottom; ++kh)
                         {
-                            Y[d][h][w] += X(d, kh, kw);
+                            for(unsigned int kw = window_left; kw < window_right; ++kw)
+                            {
+                                Y(n, d, h, w) += X(n, d, kh, kw);
+                            }
                         }
-                    }
 
-                    Y[d][h][w] /= kernel_size_squared;
+                        Y(n, d, h, w) /= kernel_size_squared;
+                    }
                 }
             }
         }
@@ -78,7 +84,7 @@ public:
         return Y;
     }
 
-    Tensor Backward(const Tensor& GFNL) // GNFL - gradient from next layer
+    Tensor<T> Backward(const Tensor<T>& GFNL) // GNFL - gradient from next layer
     {
         if (GFNL.get_height() != YH || GFNL.get_width() != YW || GFNL.get_depth() != YD)
         {
@@ -86,27 +92,32 @@ public:
             throw;
         }
 
-        Tensor GFCL = Tensor(XD, XH, XW);
+        const unsigned int batch = GFNL.get_batch();
 
-        for(unsigned int d = 0; d < YD; ++d)
+        Tensor<T> GFCL = Tensor<T>(batch, XD, XH, XW, 0);
+
+        for(unsigned int n = 0; n < batch; ++n)
         {
-            for(unsigned int h = 0; h < YH; ++h)
+            for(unsigned int d = 0; d < YD; ++d)
             {
-                for(unsigned int w = 0; w < YW; ++w)
+                for(unsigned int h = 0; h < YH; ++h)
                 {
-                    unsigned int window_top = kernel_stride * h;
-                    unsigned int window_bottom = window_top + kernel_size;
-                    unsigned int window_left = kernel_stride * w;
-                    unsigned int window_right = window_left + kernel_size;
-
-                    for(unsigned int kh = window_top; kh < window_bottom; ++kh)
+                    for(unsigned int w = 0; w < YW; ++w)
                     {
-                        for(unsigned int kw = window_left; kw < window_right; ++kw)
+                        unsigned int window_top = kernel_stride * h;
+                        unsigned int window_bottom = window_top + kernel_size;
+                        unsigned int window_left = kernel_stride * w;
+                        unsigned int window_right = window_left + kernel_size;
+
+                        for(unsigned int kh = window_top; kh < window_bottom; ++kh)
                         {
-                            GFCL[d][kh][kw] += GFNL(d, h, w);
+                            for(unsigned int kw = window_left; kw < window_right; ++kw)
+                            {
+                                GFCL(n, d, kh, kw) += GFNL(n, d, h, w);
+                            }
                         }
-                    }
 
+                    }
                 }
             }
         }
@@ -0,0 +1,325 @@
+#ifndef CONV_POOL_ACTIVATION_LAYER
+#define CONV_POOL_ACTIVATION_LAYER
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include "../Tensor.cpp"
+#include "../Kernels/ThreadPool.cpp"
+#include "ConvolutionalLayer.cpp"
+#include "ActivationLayer.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Слитый блок свёртка -> max pooling -> активация
+
+    Выход свёртки целиком не записывается: для каждой строки выхода
+    пулинга считается только полоса из pool_size строк свёртки (она
+    остаётся в кэше), из неё сразу берутся максимумы окон, к ним
+    применяется активация, и в память пишется только результат. Для
+    обратного прохода запоминаются положения максимумов и значения до
+    активации - это столько же элементов, сколько в выходе
+
+    Обратный проход тоже слитый: градиент свёртки отличен от нуля только
+    в положениях максимумов, поэтому градиенты весов и входа считаются
+    по ним напрямую, без разреженной карты размера выхода свёртки
+
+    Полосами считает ядро прямой свёртки с размерами из шаблона
+    (см. FixedConv.cpp). Для других форм фильтра свёртка считается
+    целиком выбранным в conv алгоритмом, а пулинг и активация всё равно
+    выполняются за один проход
+*/
+template <typename T>
+class ConvPoolActivationLayer
+{
+    unsigned int pool_size = 2;
+    unsigned int pool_stride = 2;
+
+    unsigned int output_height = 0;
+    unsigned int output_width = 0;
+
+    ActivationLayer<T> activation;
+
+    // Для каждого выхода: значение до активации и положение максимума в карте свёртки
+    std::vector<T> pooled;
+    std::vector<unsigned int> max_index;
+
+    // Полосы строк свёртки F x pool_size x OW, своя у каждой строки выхода
+    std::vector<T> band;
+
+public:
+
+    ConvolutionalLayer<T> conv;
+
+    ConvPoolActivationLayer(){}
+
+    void Initialize
+    (
+        unsigned int input_depth,
+        unsigned int input_height,
+        unsigned int input_width,
+        unsigned int filter_size,
+        unsigned int filter_count,
+        unsigned int padding,
+        unsigned int stride,
+        unsigned int pool_size,
+        unsigned int pool_stride,
+        typename ActivationLayer<T>::ActivationType activation_type,
+        T learning_rate = 1.0e-4,
+        T mean = 0,
+        T sigma = 0
+    )
+    {
+        conv.Initialize(
+            input_depth, input_height, input_width, filter_size, filter_count,
+            padding, stride, learning_rate, mean, sigma
+        );
+
+        this->pool_size = pool_size;
+        this->pool_stride = pool_stride;
+
+        output_height = (conv.output_height - pool_size) / pool_stride + 1;
+        output_width = (conv.output_width - pool_size) / pool_stride + 1;
+
+        activation.SetActivationType(activation_type);
+    }
+
+
+    Tensor<T> Forward(const Tensor<T>& X)
+    {
+        if (X.get_depth() != conv.input_depth || X.get_height() != conv.input_height || X.get_width() != conv.input_width)
+        {
+            std::cout << "Input tensor is wrong size (Conv-pool-activation layer)!" << std::endl;
+            throw;
+        }
+
+        const unsigned int batch = X.get_batch();
+
+        const unsigned int F = conv.filter_count;
+        const unsigned int conv_width = conv.output_width;
+
+        const unsigned int padded_height = conv.input_height + 2 * conv.padding;
+        const unsigned int padded_width = conv.input_width + 2 * conv.padding;
+        const std::size_t padded_size = (std::size_t)conv.input_depth * padded_height * padded_width;
+
+        Tensor<T> Y = Tensor<T>(batch, F, output_height, output_width, 0);
+
+        pooled.resize(Y.size());
+        max_index.resize(Y.size());
+
+        // Без ядра под форму фильтра или в int8 - свёртка целиком через conv.Forward
+        const bool fused = conv.fixed_forward != nullptr && !conv.Quantized();
+
+        Tensor<T> C;
+        const T* xp = nullptr;
+
+        const std::size_t band_size = (std::size_t)F * pool_size * conv_width;
+
+        if (fused)
+        {
+            xp = conv.PadBatch(conv.SimulatedInput(X));
+            band.resize(batch * output_height * band_size);
+        }
+        else
+        {
+            C = conv.Forward(X);
+        }
+
+        T* y = Y.data();
+
+        // Части работы для пула потоков - строка выхода одного примера
+        ThreadPool::Shared().ParallelFor((std::size_t)batch * output_height, [&](std::size_t item)
+        {
+            const unsigned int ph = item % output_height;
+            const unsigned int n = item / output_height;
+
+            const unsigned int oh0 = ph * pool_stride;
+
+            // Строки свёртки oh0 .. oh0 + pool_size - 1 всех фильтров
+            const T* rows;
+            std::size_t plane;
+
+            if (fused)
+            {
+                T* item_band = band.data() + item * band_size;
+
+                conv.fixed_forward(
+                    xp + n * padded_size + (std::size_t)oh0 * conv.stride * padded_width,
+                    conv.filters.data(), conv.B.data(),
+                    conv.input_depth, padded_height, padded_width,
+                    F, pool_size, conv_width,
+                    item_band
+                );
+
+                rows = item_band;
+                plane = (std::size_t)pool_size * conv_width;
+            }
+            else
+            {
+                rows = C.sample(n) + (std::size_t)oh0 * conv_width;
+                plane = (std::size_t)conv.output_height * conv_width;
+            }
+
+            for(unsigned int f = 0; f < F; ++f)
+            {
+                const T* r = rows + f * plane;
+
+                std::size_t i = (((std::size_t)n * F + f) * output_height + ph) * output_width;
+
+                for(unsigned int pw = 0; pw < output_width; ++pw, ++i)
+                {
+                    unsigned int best = pw * pool_stride;
+
+                    for(unsigned int kh = 0; kh < pool_size; ++kh)
+                    {
+                        for(unsigned int kw = 0; kw < pool_size; ++kw)
+                        {
+                            const unsigned int index = kh * conv_width + pw * pool_stride + kw;
+
+                            if (r[best] < r[index])
+                                best = index;
+                        }
+                    }
+
+                    pooled[i] = r[best];
+                    max_index[i] = oh0 * conv_width + best;
+
+                    y[i] = activation.Apply(r[best]);
+                }
+            }
+        });
+
+        return Y;
+    }
+
+
+    /*
+        X - тот же вход, что и у последнего Forward
+    */
+    Tensor<T> Backward(const Tensor<T>& X, const Tensor<T>& GFNL)
+    {
+        if (GFNL.size() != pooled.size() || GFNL.get_depth() != conv.filter_count || X.get_batch() != GFNL.get_batch())
+        {
+            std::cout << "Gradient from next layer is wrong dimension (Conv-pool-activation layer)!" << std::endl;
+            throw;
+        }
+
+        const unsigned int batch = X.get_batch();
+
+        const unsigned int D = conv.input_depth;
+        const unsigned int F = conv.filter_count;
+        const unsigned int K = conv.filter_size;
+        const unsigned int conv_width = conv.output_width;
+        const unsigned int rows = D * K * K;
+
+        const unsigned int padded_height = conv.input_height + 2 * conv.padding;
+        const unsigned int padded_width = conv.input_width + 2 * conv.padding;
+        const std::size_t channel = (std::size_t)padded_height * padded_width;
+
+        const T* xp = conv.PadBatch(conv.ObserveTraining(X));
+
+        // Градиент по выходу свёртки в положениях максимумов
+        Tensor<T> G = Tensor<T>(batch, F, output_height, output_width, 0);
+
+        for(std::size_t i = 0; i < G.size(); ++i)
+            G.data()[i] = GFNL.data()[i] * activation.Derivative(pooled[i]);
+
+        conv.weight_gradient.assign((std::size_t)F * rows, 0);
+        conv.padded_gradient.assign(batch * D * channel, 0);
+
+        const std::size_t outputs = (std::size_t)output_height * output_width;
+
+        ThreadPool& pool = ThreadPool::Shared();
+
+        // Градиент фильтра f целиком считает одна часть работы
+        pool.ParallelFor(F, [&](std::size_t f)
+        {
+            T* delta_w_f = conv.weight_gradient.data() + f * rows;
+
+            for(unsigned int n = 0; n < batch; ++n)
+            {
+                const T* x_n = xp + (std::size_t)n * D * channel;
+                const std::size_t base = ((std::size_t)n * F + f) * outputs;
+
+                for(std::size_t p = 0; p < outputs; ++p)
+                {
+                    const T g = G.data()[base + p];
+
+                    const unsigned int oh = max_index[base + p] / conv_width;
+                    const unsigned int ow = max_index[base + p] % conv_width;
+
+                    const std::size_t offset = (std::size_t)oh * conv.stride * padded_width + ow * conv.stride;
+
+                    for(unsigned int d = 0; d < D; ++d)
+                    {
+                        const T* x0 = x_n + d * channel + offset;
+                        T* delta_w_d = delta_w_f + (std::size_t)d * K * K;
+
+                        for(unsigned int fh = 0; fh < K; ++fh)
+                            for(unsigned int fw = 0; fw < K; ++fw)
+                                delta_w_d[fh * K + fw] += g * x0[(std::size_t)fh * padded_width + fw];
+                    }
+                }
+            }
+        });
+
+        // Градиент по входу: часть работы - канал входа одного примера
+        pool.ParallelFor((std::size_t)batch * D, [&](std::size_t item)
+        {
+            const unsigned int d = item % D;
+            const unsigned int n = item / D;
+
+            T* g_d = conv.padded_gradient.data() + item * channel;
+
+            for(unsigned int f = 0; f < F; ++f)
+            {
+                const T* w_d = conv.filters.sample(f) + (std::size_t)d * K * K;
+                const std::size_t base = ((std::size_t)n * F + f) * outputs;
+
+                for(std::size_t p = 0; p < outputs; ++p)
+                {
+                    const T g = G.data()[base + p];
+
+                    const unsigned int oh = max_index[base + p] / conv_width;
+                    const unsigned int ow = max_index[base + p] % conv_width;
+
+                    T* g0 = g_d + (std::size_t)oh * conv.stride * padded_width + ow * conv.stride;
+
+                    for(unsigned int fh = 0; fh < K; ++fh)
+                        for(unsigned int fw = 0; fw < K; ++fw)
+                            g0[(std::size_t)fh * padded_width + fw] += g * w_d[fh * K + fw];
+                }
+            }
+        });
+
+        // Отрезаем рамку паддинга
+        Tensor<T> GFCL = Tensor<T>(batch, D, conv.input_height, conv.input_width, 0);
+
+        for(unsigned int n = 0; n < batch; ++n)
+        {
+            for(unsigned int d = 0; d < D; ++d)
+            {
+                const T* src = conv.padded_gradient.data() + ((std::size_t)n * D + d) * channel;
+                T* dst = GFCL.sample(n) + (std::size_t)d * conv.input_height * conv.input_width;
+
+                for(unsigned int h = 0; h < conv.input_height; ++h)
+                    std::copy(
+                        src + (std::size_t)(h + conv.padding) * padded_width + conv.padding,
+                        src + (std::size_t)(h + conv.padding) * padded_width + conv.padding + conv.input_width,
+                        dst + (std::size_t)h * conv.input_width
+                    );
+            }
+        }
+
+        conv.ApplyGradient(G);
+
+        return GFCL;
+    }
+
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
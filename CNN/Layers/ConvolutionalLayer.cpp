@@ -3,15 +3,35 @@
 
 #include <vector>
 #include <random>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <complex>
+#include <iostream>
+#include <filesystem>
 
 #include "../Tensor.cpp"
+#include "../Kernels/Gemm.cpp"
+#include "../Kernels/Im2Col.cpp"
+#include "../Kernels/Winograd.cpp"
+#include "../Kernels/FFT.cpp"
+#include "../Kernels/BlockedConv.cpp"
+#include "../Kernels/FixedConv.cpp"
+#include "../Kernels/Quantize.cpp"
+#include "../Kernels/ThreadPool.cpp"
 
 using namespace std;
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
 
+template <typename T>
 class ConvolutionalLayer
 {
+    // Слитный слой считает свёртку по полосам строк с буферами этого слоя
+    template <typename> friend class ConvPoolActivationLayer;
+
     unsigned int input_depth;
     unsigned int input_height;
     unsigned int input_width;
@@ -22,15 +42,152 @@ class ConvolutionalLayer
     unsigned int padding;
     unsigned int stride;
 
+    // Расширение фильтра: соседние элементы фильтра берутся из входа
+    // через dilation позиций, окно занимает (K - 1) * dilation + 1
+    unsigned int dilation;
+
     unsigned int output_height;
     unsigned int output_width;
 
 public:
 
-    double learning_rate;
+    /*
+        Алгоритмы свёртки:
+        Direct     - прямые вложенные циклы, для фильтров 3x3 и 5x5 с шагом 1,
+                     3x3 и 2x2 с шагом 2 (понижение разрешения вместо пулинга)
+                     без расширения - развёрнутое ядро с размерами из шаблона
+        Im2ColGemm - развёртка входа im2col и блочное перемножение матриц
+        Winograd   - свёртка Винограда F(4x4,3x3) / F(2x2,K x K) для stride = 1
+                     и dilation = 1, иначе или при большом фильтре - Direct
+        FFT        - поэлементное умножение спектров, выгодно для больших
+                     фильтров и карт признаков
+        Blocked    - прямая свёртка в блочной раскладке NCHWc с SIMD-микроядром
+        Auto       - выбор по оценке стоимости для формы слоя
+        Tuned      - выбор замером всех вариантов (и размеров плиток Винограда)
+                     на этой машине, результат сохраняется в tuning_cache
+    */
+    enum Algorithm { Direct, Im2ColGemm, Winograd, FFT, Blocked, Auto, Tuned };
+
+    /*
+        В каком виде веса берёт умножение матриц (im2col и его обратный проход):
+        OIHW       - прямо из filters, блоки упаковываются при каждом вызове Gemm
+        GemmPacked - из копии, заранее упакованной в полосы микроядра; она
+                     пересчитывается только после изменения весов
+    */
+    enum WeightLayout { OIHW, GemmPacked };
+
+private:
+
+    Algorithm algorithm = Direct;
+
+    // Алгоритм, которым реально считается слой (для Auto и Tuned - выбранный)
+    Algorithm active_algorithm = Direct;
+
+    // Размер плитки выхода Винограда, 0 - по умолчанию для размера фильтра
+    unsigned int winograd_tile = 0;
+
+    WeightLayout weight_layout = GemmPacked;
+
+    // Рабочие буферы переиспользуются между вызовами
+    mutable vector<T> im2col_workspace;
+
+    vector<T> weight_gradient;
+    vector<T> column_gradient;
+
+    /*
+        Версия весов увеличивается при каждом их изменении. Производные
+        от весов данные (упакованная матрица, преобразования Винограда)
+        пересчитываются, только если их версия устарела
+    */
+    unsigned long weights_version = 1;
+
+    // Веса F x D*K*K и транспонированные, упакованные для Gemm
+    mutable GemmPackedA<T> packed_weights;
+    mutable GemmPackedA<T> packed_weights_t;
+    mutable unsigned long packed_version = 0;
+
+    mutable WinogradTransform<T> winograd;
+    mutable unsigned long winograd_version = 0;
+    mutable vector<T> winograd_filters;
+    mutable vector<T> winograd_tiles;
+    mutable vector<T> winograd_temp;
+    mutable vector<T> winograd_input;
+    mutable vector<T> winograd_product;
+
+    mutable FFTPlan<T> fft_rows;
+    mutable FFTPlan<T> fft_cols;
+    mutable unsigned long fft_version = 0;
+    mutable vector<complex<T>> fft_filters;
+    mutable vector<complex<T>> fft_input;
+    mutable vector<complex<T>> fft_output;
+
+    mutable unsigned long blocked_version = 0;
+    mutable vector<T> blocked_filters;
+    mutable vector<T> blocked_input;
+
+    /*
+        Фильтры в int8 и квантование входа (Quantize.cpp). Прямой проход
+        идёт в int8, пока версия квантованных весов совпадает с текущей:
+        любое изменение весов возвращает слой к вещественным
+    */
+    Int8Matrix<T> int8_filters;
+    Int8Activation<T> int8_input;
+    unsigned long int8_version = 0;
+
+    // Квантованный вход батча с паддингом и его развёртка четвёрками (Im2ColInt8)
+    mutable vector<std::uint8_t> int8_padded;
+    mutable vector<std::uint8_t> int8_col;
+
+    /*
+        Обучение с учётом квантования: filters на сетке int8, настоящие
+        веса - filters + int8_residual (SimulateInt8Rows), вход слоя
+        проходит через квантование в simulated_input
+    */
+    bool quantization_aware = false;
+    vector<T> int8_residual;
+    mutable Tensor<T> simulated_input;
+
+    // Ядро прямой свёртки под размер фильтра и шаг (nullptr - общий путь)
+    FixedConvFunction<T> fixed_forward = nullptr;
+
+    /*
+        Вход батча с нулевым паддингом для прямой свёртки и градиент по
+        нему: внутренние циклы идут без проверок границ, буферы
+        переиспользуются между вызовами
+    */
+    mutable vector<T> padded_input;
+    vector<T> padded_gradient;
+
+    /*
+        Разбиение работы между потоками пула: полосы по parallel_rows строк
+        выхода (прямая свёртка), полосы по parallel_columns позиций выхода
+        (im2col) и gradient_slots частичных буферов градиента весов по
+        блокам примеров (обратный проход im2col). Разбиение зависит только
+        от формы слоя, поэтому результат от числа потоков не зависит
+    */
+    static constexpr unsigned int parallel_rows = 8;
+    static constexpr unsigned int parallel_columns = 256;
+    static constexpr unsigned int gradient_slots = 8;
+
+public:
+
+    T learning_rate;
 
-    vector<Tensor> filters;
-    vector<double> B;
+    /*
+        Все фильтры в одном непрерывном буфере F x D x K x K (OIHW):
+        фильтр f - это filters.sample(f), а построчно весь буфер - уже
+        матрица F x D*K*K для im2col
+    */
+    Tensor<T> filters;
+    vector<T> B;
+
+    /*
+        Автонастройка (Algorithm::Tuned): файл кэша, размер батча, на котором
+        идут замеры, и учитывается ли обратный проход (для обучения)
+    */
+    string tuning_cache = "Models/conv_tuning.txt";
+    unsigned int tuning_batch = 1;
+    bool tuning_backward = true;
 
     ConvolutionalLayer(){}
 
@@ -43,9 +200,10 @@ public:
         unsigned int filter_count = 1,
         unsigned int padding = 0,
         unsigned int stride = 1,
-        double learning_rate = 1.0e-4,
-        double mean = 0,
-        double sigma = 0
+        T learning_rate = 1.0e-4,
+        T mean = 0,
+        T sigma = 0,
+        unsigned int dilation = 1
     )
     {
         this->input_depth=input_depth;
@@ -57,46 +215,46 @@ public:
 
         this->padding=padding;
         this->stride=stride;
+        this->dilation=dilation;
 
         this->learning_rate=learning_rate;
         
-        this->output_height = (input_height - filter_size + 2 * padding) / stride + 1;
-        this->output_width = (input_width - filter_size + 2 * padding) / stride + 1;
+        const unsigned int window = (filter_size - 1) * dilation + 1;
+
+        // При dilation = 0 окно схлопнулось бы в одну позицию
+        if (dilation == 0 || window > input_height + 2 * padding || window > input_width + 2 * padding)
+        {
+            std::cout << "Dilation must be positive and filter window must fit into padded input (Convolutional layer)!" << std::endl;
+            throw;
+        }
+
+        this->output_height = (input_height - window + 2 * padding) / stride + 1;
+        this->output_width = (input_width - window + 2 * padding) / stride + 1;
+
+        fixed_forward = dilation == 1 ? FixedConvSelect<T>(filter_size, stride) : nullptr;
 
         // Создание фильтров
 
 
-        filters.reserve(filter_count);
-        B.reserve(filter_count);
-        for(unsigned int i = 0; i < filter_count; ++i)
-        {      
-            filters.push_back(Tensor(input_depth, filter_size, filter_size));
-            B.push_back(0);
-        }
+        filters = Tensor<T>(filter_count, input_depth, filter_size, filter_size, 0);
+        B.assign(filter_count, 0);
 
 
         DefineWeights(sigma, mean);
+
+        // Для Tuned замеры требуют готовых фильтров
+        SetAlgorithm(algorithm);
     }
 
 
-    void DefineWeights(double mean, double sigma = 0)
+    void DefineWeights(T mean, T sigma = 0)
     {
         if (sigma == 0)
         {
+            filters.fill(mean);
+
             for(unsigned int f = 0; f < filter_count; ++f)
-            {
-                for(unsigned int d = 0; d < input_depth; ++d)
-                {
-                    for(unsigned int h = 0; h < filter_size; ++h)
-                    {
-                        for(unsigned int w = 0; w < filter_size; ++w)
-                        {
-                            filters[f][d][h][w] = mean;
-                        }
-                    }
-                }
                 B[f] = mean;
-            }
         }
         else
         {
@@ -106,180 +264,1309 @@ public:
             std::normal_distribution d = std::normal_distribution(mean, sigma);
             auto random_double = [&d, &gen]{ return d(gen); };
 
+            const std::size_t filter_volume = filters.sample_size();
+
             for(unsigned int f = 0; f < filter_count; ++f)
             {
-                for(unsigned int d = 0; d < input_depth; ++d)
-                {
-                    for(unsigned int h = 0; h < filter_size; ++h)
-                    {
-                        for(unsigned int w = 0; w < filter_size; ++w)
-                        {
-                            filters[f][d][h][w] = random_double();
-                        }
-                    }
-                }
+                T* filter = filters.sample(f);
+
+                for(std::size_t i = 0; i < filter_volume; ++i)
+                    filter[i] = random_double();
+
                 B[f] = random_double();
             }
         }
 
-        
+        InvalidateWeightCache();
+    }
 
-        
+
+    /*
+        Нужно вызывать после записи в filters или B напрямую (например,
+        при чтении модели из файла), чтобы сбросить кэши весов. При
+        обучении с учётом квантования записанные веса - настоящие:
+        остаток прежних весов отбрасывается, новые кладутся на сетку
+    */
+    void InvalidateWeightCache()
+    {
+        if (quantization_aware)
+        {
+            const unsigned int rows = input_depth * filter_size * filter_size;
+
+            int8_residual.assign(filters.size(), 0);
+            SimulateInt8Rows(filter_count, rows, filters.data(), rows, int8_residual.data());
+        }
+
+        ++weights_version;
+    }
+
+    /*
+        Настоящий вес i (в порядке filters): при обучении с учётом
+        квантования - точка сетки плюс остаток
+    */
+    T Weight(std::size_t i) const
+    {
+        return quantization_aware ? filters.data()[i] + int8_residual[i] : filters.data()[i];
     }
 
 
-    Tensor Forward(const Tensor& X) const
+    void SetAlgorithm(Algorithm algorithm)
     {
-        Tensor Y = Tensor(filter_count, output_height, output_width);
+        this->algorithm = algorithm;
 
-        for(unsigned int f = 0; f < filter_count; ++f)
+        winograd_tile = 0;
+
+        // До Initialize форма слоя неизвестна, выбор будет сделан в нём
+        if (filters.size() == 0)
+            active_algorithm = Algorithm::Direct;
+        else if (algorithm == Algorithm::Auto)
+            active_algorithm = ChooseAlgorithm();
+        else if (algorithm == Algorithm::Tuned)
+            TuneAlgorithm();
+        else
+            active_algorithm = algorithm;
+    }
+
+    Algorithm GetAlgorithm() const
+    {
+        return algorithm;
+    }
+
+    void SetWeightLayout(WeightLayout weight_layout)
+    {
+        this->weight_layout = weight_layout;
+    }
+
+    WeightLayout GetWeightLayout() const
+    {
+        return weight_layout;
+    }
+
+    Algorithm GetActiveAlgorithm() const
+    {
+        return active_algorithm;
+    }
+
+    unsigned int GetWinogradTile() const
+    {
+        return winograd_tile != 0 ? winograd_tile : WinogradOutputTile(filter_size);
+    }
+
+
+    static const char* AlgorithmName(Algorithm algorithm)
+    {
+        switch (algorithm)
         {
+        case Algorithm::Im2ColGemm:
+            return "im2col";
+        case Algorithm::Winograd:
+            return "winograd";
+        case Algorithm::FFT:
+            return "fft";
+        case Algorithm::Blocked:
+            return "blocked";
+        case Algorithm::Auto:
+            return "auto";
+        case Algorithm::Tuned:
+            return "tuned";
+        case Algorithm::Direct:
+        default:
+            return "direct";
+        }
+    }
 
-            for(unsigned int d = 0; d < input_depth; ++d)
-            {
-                
-                for(unsigned int yh = 0; yh < output_height; ++yh)
-                {
-                    for(unsigned int yw = 0; yw < output_width; ++yw)
-                    {
-                        unsigned int i0 = yh * stride - padding;
-                        unsigned int j0 = yw * stride - padding;
 
-                        Y[f][yh][yw] = B[f];
+    /*
+        Автонастройка: для формы слоя на этой машине замеряются все
+        алгоритмы (для Винограда - и несколько размеров плитки), лучший
+        записывается в файл кэша. Ключ включает форму, тип, размер батча,
+        модель процессора и активный набор инструкций, поэтому при
+        следующих запусках замеры не повторяются
+    */
+    void TuneAlgorithm()
+    {
+        const string key = TuningKey();
 
-                        for(unsigned int fh = 0; fh < filter_size; ++fh)
-                        {
-                            for(unsigned int fw = 0; fw < filter_size; ++fw)
-                            {
-                                
-                                unsigned int i = fh + i0;
-                                unsigned int j = fw + j0;
-                            
-                                if (i < 0 || i >= input_height || j < 0 || j >= input_width)
-                                    continue;
-
-                                Y[f][yh][yw] += filters[f](d, fh, fw) * X(d, i, j);
-                            }
-                        }
-                    }
-                }
+        Algorithm cached = Algorithm::Direct;
+        unsigned int cached_tile = 0;
+
+        if (ReadTuning(key, cached, cached_tile))
+        {
+            active_algorithm = cached;
+            winograd_tile = cached_tile;
+            return;
+        }
+
+        // Кандидаты: алгоритм и размер плитки Винограда
+        vector<pair<Algorithm, unsigned int>> candidates = {
+            { Algorithm::Direct, 0 },
+            { Algorithm::Im2ColGemm, 0 },
+            { Algorithm::FFT, 0 },
+            { Algorithm::Blocked, 0 }
+        };
+
+        const unsigned int default_tile = WinogradOutputTile(filter_size);
+
+        if (stride == 1 && dilation == 1 && default_tile != 0)
+            for(unsigned int m = 2; m <= default_tile; m += 2)
+                candidates.push_back({ Algorithm::Winograd, m });
+
+        Tensor<T> X = Tensor<T>(tuning_batch, input_depth, input_height, input_width, 0);
+        Tensor<T> G = Tensor<T>(tuning_batch, filter_count, output_height, output_width, 0);
+
+        for(std::size_t i = 0; i < X.size(); ++i)
+            X.data()[i] = (T)std::sin(0.1 * i);
+
+        for(std::size_t i = 0; i < G.size(); ++i)
+            G.data()[i] = (T)std::cos(0.1 * i);
+
+        // Обратный проход не должен менять веса во время замеров
+        const T saved_learning_rate = learning_rate;
+        learning_rate = 0;
+
+        double best_time = 0;
 
+        for(std::size_t c = 0; c < candidates.size(); ++c)
+        {
+            active_algorithm = candidates[c].first;
+            winograd_tile = candidates[c].second;
+
+            const double time = MeasureAlgorithm(X, G);
+
+            if (c == 0 || time < best_time)
+            {
+                best_time = time;
+                cached = candidates[c].first;
+                cached_tile = candidates[c].second;
             }
+        }
+
+        learning_rate = saved_learning_rate;
+
+        active_algorithm = cached;
+        winograd_tile = cached_tile;
+
+        WriteTuning(key, cached, cached_tile);
+    }
+
+private:
+
+    /*
+        Наименьшее время одного прохода: после прогрева (подготовка
+        кэшей весов и буферов) проходы повторяются, пока не наберётся
+        хотя бы 3 замера и 20 мс
+    */
+    double MeasureAlgorithm(const Tensor<T>& X, const Tensor<T>& G)
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        auto run = [&]
+        {
+            Tensor<T> Y = Forward(X);
+
+            if (tuning_backward)
+                Backward(X, G);
+        };
+
+        run();
 
+        double best = 0;
+        double total = 0;
+
+        for(unsigned int r = 0; r < 100 && (r < 3 || total < 0.02); ++r)
+        {
+            const Clock::time_point start = Clock::now();
+
+            run();
+
+            const double time = std::chrono::duration<double>(Clock::now() - start).count();
+
+            best = r == 0 ? time : std::min(best, time);
+            total += time;
         }
 
-        return Y;
+        return best;
     }
 
+    string TuningKey() const
+    {
+        ostringstream key;
+
+        key << (sizeof(T) == sizeof(float) ? "float" : "double")
+            << ":" << input_depth << "x" << input_height << "x" << input_width
+            << ":k" << filter_size << ":f" << filter_count
+            << ":p" << padding << ":s" << stride << ":d" << dilation
+            << ":n" << tuning_batch << (tuning_backward ? ":fb" : ":f")
+            << ":" << CpuBrand() << ":" << CpuIsaName(ActiveCpuIsa());
 
-    Tensor Backward(const Tensor& X, const Tensor& GFNL)
+        // Ключ - одно слово в строке файла
+        string result = key.str();
+
+        for(char& c : result)
+            if (c == ' ')
+                c = '_';
+
+        return result;
+    }
+
+    /*
+        Строка кэша: ключ, название алгоритма, размер плитки Винограда
+    */
+    bool ReadTuning(const string& key, Algorithm& algorithm, unsigned int& tile) const
     {
-        
-        // Обновление весов
+        ifstream file(tuning_cache);
 
-        vector<Tensor> delta_w_f;
-        delta_w_f.reserve(filter_count);
+        if (!file.is_open())
+            return false;
 
-        for(unsigned int f = 0; f < filter_count; ++f)
+        string line;
+
+        while (getline(file, line))
         {
-            delta_w_f.push_back(Tensor(input_depth, filter_size, filter_size, 0));
-            
-            for(unsigned int d = 0; d < input_depth; ++d)
+            istringstream fields(line);
+
+            string line_key, name;
+            unsigned int line_tile = 0;
+
+            if (!(fields >> line_key >> name >> line_tile) || line_key != key)
+                continue;
+
+            for(Algorithm a : { Algorithm::Direct, Algorithm::Im2ColGemm, Algorithm::Winograd, Algorithm::FFT, Algorithm::Blocked })
             {
-                for(unsigned int gh = 0; gh < output_height; ++gh)
+                if (name == AlgorithmName(a))
                 {
-                    for(unsigned int gw = 0; gw < output_width; ++gw)
-                    {
-                        unsigned int h0 = gh * stride - padding;
-                        unsigned int w0 = gw * stride - padding;
-
-                        for(unsigned int fh = 0; fh < filter_size; ++fh)
-                        {
-                            for(unsigned int fw = 0; fw < filter_size; ++fw)
-                            {
-                                unsigned int h = h0 + fh;
-                                unsigned int w = w0 + fw;
-
-                                if (h < 0 || h >= input_height || w < 0 || w >= input_width)
-                                    continue;
-                                
-                                delta_w_f[f][d][fh][fw] += GFNL(f, gh, gw) * X(d, h, w);
-                            }
-                        }
-                    }
+                    algorithm = a;
+                    tile = a == Algorithm::Winograd ? line_tile : 0;
+                    return true;
                 }
+            }
+        }
+
+        return false;
+    }
 
+    void WriteTuning(const string& key, Algorithm algorithm, unsigned int tile) const
+    {
+        const filesystem::path path(tuning_cache);
+
+        std::error_code error;
+
+        if (path.has_parent_path())
+            filesystem::create_directories(path.parent_path(), error);
+
+        ofstream file(tuning_cache, ios::app);
+
+        if (!file.is_open())
+        {
+            std::cout << "Can't write tuning cache '" << tuning_cache << "'" << std::endl;
+            return;
+        }
+
+        file << key << ' ' << AlgorithmName(algorithm) << ' ' << tile << '\n';
+    }
+
+public:
+
+    /*
+        Грубая модель стоимости прямого прохода одного примера в скалярных
+        операциях. Векторизованное умножение матриц считается в 8 раз
+        дешевле скалярного кода, преобразования Винограда - скалярными,
+        комплексное БПФ - 5 n log n операций. Блочная свёртка с SIMD-ядром
+        (если процессор поддерживает AVX2) держит всю плитку в регистрах, но считает каналы выхода целыми блоками
+    */
+    Algorithm ChooseAlgorithm() const
+    {
+        const double outputs = (double)output_height * output_width;
+        const double window = (double)input_depth * filter_size * filter_size;
+
+        Algorithm best = Algorithm::Im2ColGemm;
+        double best_cost = outputs * window + outputs * window * filter_count / 8;
+
+        {
+            constexpr unsigned int C = BlockedConvTile<T>::C;
+
+            const double filters = (double)((filter_count + C - 1) / C) * C;
+            const double cost = outputs * window * filters / (ActiveCpuIsa() >= CpuIsa::AVX2 ? 16 : 4);
+
+            if (cost < best_cost)
+            {
+                best = Algorithm::Blocked;
+                best_cost = cost;
             }
         }
 
-        for(unsigned int f = 0; f < filter_count; ++f)
+        const unsigned int m = WinogradOutputTile(filter_size);
+
+        if (stride == 1 && dilation == 1 && m != 0)
         {
-            for(unsigned int d = 0; d < input_depth; ++d)
+            const double alpha = m + filter_size - 1;
+            const double tiles = (double)((output_height + m - 1) / m) * ((output_width + m - 1) / m);
+
+            double cost = tiles * alpha * alpha * filter_count * input_depth / 8;
+            cost += tiles * input_depth * 2 * alpha * alpha * alpha;
+            cost += tiles * filter_count * (m * alpha * alpha + m * m * alpha);
+
+            if (cost < best_cost)
             {
-                for(unsigned int h = 0; h < filter_size; ++h)
-                {
-                    for(unsigned int w = 0; w < filter_size; ++w)
-                    {
-                        filters[f][d][h][w] -= delta_w_f[f][d][h][w] * learning_rate; 
-                    }
-                }
+                best = Algorithm::Winograd;
+                best_cost = cost;
             }
+        }
+
+        {
+            const double n = (double)FFTSize(input_height + 2 * padding) * FFTSize(input_width + 2 * padding);
 
-            double db = 0;
+            double cost = (input_depth + filter_count) * 5 * n * std::log2(n) / 2;
+            cost += (double)filter_count * input_depth * n * 4;
 
-            for(unsigned int gh = 0; gh < output_height; ++gh)
+            if (cost < best_cost)
             {
-                for(unsigned int gw = 0; gw < output_width; ++gw)
-                {
-                    db += GFNL(f, gh, gw);
-                }
+                best = Algorithm::FFT;
+                best_cost = cost;
             }
+        }
 
-            B[f] -= db * learning_rate;
+        return best;
+    }
+
+
+    /*
+        X может быть батчем N x D x H x W
+    */
+    Tensor<T> Forward(const Tensor<T>& X) const
+    {
+        if (Quantized())
+            return ForwardInt8(X);
+
+        const Tensor<T>& input = SimulatedInput(X);
+
+        switch (active_algorithm)
+        {
+        case Algorithm::Im2ColGemm:
+            return ForwardIm2ColGemm(input);
+        case Algorithm::Winograd:
+            return ForwardWinograd(input);
+        case Algorithm::FFT:
+            return ForwardFFT(input);
+        case Algorithm::Blocked:
+            return ForwardBlocked(input);
+        case Algorithm::Direct:
+        default:
+            return ForwardDirect(input);
         }
+    }
 
-        // Расчет возвращаемого градиента
-        
-        Tensor GFCL = Tensor(input_depth, input_height, input_width, 0);
 
-        for(unsigned int f = 0; f < filter_count; ++f)
+    /*
+        Квантование в int8 после обучения: Observe собирает диапазон входа
+        слоя на калибровочных примерах при обычном Forward, Quantize
+        переводит фильтры в int8 с масштабом на каждый фильтр. Dequantize
+        (или любое изменение весов) возвращает слой к вещественным
+    */
+    void Observe(const Tensor<T>& X)
+    {
+        int8_input.Observe(X.data(), X.size());
+    }
+
+    void Quantize()
+    {
+        const unsigned int rows = input_depth * filter_size * filter_size;
+        const unsigned int columns = output_height * output_width;
+
+        int8_input.Calibrate();
+        int8_filters.Quantize(filter_count, rows, filters.data(), rows, B.data(), int8_input);
+
+        int8_col.resize((std::size_t)(rows + 3) / 4 * 4 * columns);
+
+        int8_version = weights_version;
+    }
+
+    void Dequantize()
+    {
+        int8_version = 0;
+    }
+
+    bool Quantized() const
+    {
+        return int8_version == weights_version;
+    }
+
+    /*
+        Обучение с учётом квантования: все проходы (любым алгоритмом)
+        идут по фильтрам и входу, округлённым так же, как в int8 (фильтры
+        - по своей сетке, вход - по диапазону, собранному за обучение).
+        Градиент через округление проходит без изменений (straight-through),
+        обновление весов (ApplyGradient) снова кладёт их на сетку. При
+        выключении filters снова становятся настоящими весами
+    */
+    void SetQuantizationAware(bool enable)
+    {
+        if (enable == quantization_aware)
+            return;
+
+        quantization_aware = enable;
+
+        const unsigned int rows = input_depth * filter_size * filter_size;
+
+        if (enable)
         {
-            for(unsigned int d = 0; d < input_depth; ++d)
-            {
+            int8_residual.assign(filters.size(), 0);
+            SimulateInt8Rows(filter_count, rows, filters.data(), rows, int8_residual.data());
+        }
+        else
+        {
+            VectorAxpy((T)1, int8_residual.data(), filters.data(), filters.size());
+            int8_residual = vector<T>();
+        }
 
-                for(unsigned int gh = 0; gh < output_height; ++gh)
-                {
-                    for(unsigned int gw = 0; gw < output_width; ++gw)
-                    {
+        ++weights_version;
+    }
 
-                        unsigned int h0 = gh * stride - padding;
-                        unsigned int w0 = gw * stride - padding;
+    bool QuantizationAware() const
+    {
+        return quantization_aware;
+    }
 
-                        for(unsigned int fh = 0; fh < filter_size; ++fh)
-                        {
-                            for(unsigned int fw = 0; fw < filter_size; ++fw)
-                            {
-                                unsigned int h = h0 + fh;
-                                unsigned int w = w0 + fw;
+    // Размер фильтров в памяти
+    std::size_t WeightBytes() const
+    {
+        if (Quantized())
+            return int8_filters.Bytes();
 
-                                if (h < 0 || h >= input_height || w < 0 || w >= input_width)
-                                    continue;
+        return filters.size() * sizeof(T);
+    }
 
-                                GFCL[d][h][w] += GFNL(f, gh, gw) * filters[f](d, fh, fw);
-                                
-                            }
-                        }
 
-                    }   
-                }
+    /*
+        Градиенты весов копятся в заранее выделенном буфере и применяются
+        один раз после прохода по всему батчу.
+        Обратный проход для Winograd, FFT и Blocked идёт через im2col и GEMM
+    */
+    Tensor<T> Backward(const Tensor<T>& X, const Tensor<T>& GFNL)
+    {
+        // Градиенты считаются по входу, который видел Forward
+        const Tensor<T>& input = ObserveTraining(X);
 
-            }
+        switch (active_algorithm)
+        {
+        case Algorithm::Im2ColGemm:
+        case Algorithm::Winograd:
+        case Algorithm::FFT:
+        case Algorithm::Blocked:
+            return BackwardIm2ColGemm(input, GFNL);
+        case Algorithm::Direct:
+        default:
+            return BackwardDirect(input, GFNL);
         }
+    }
 
-        return GFCL;
+private:
+
+    // Вход, каким его видит int8, при обучении с учётом квантования, иначе сам X
+    const Tensor<T>& SimulatedInput(const Tensor<T>& X) const
+    {
+        if (!quantization_aware)
+            return X;
+
+        simulated_input = X;
+        int8_input.Simulate(X.data(), X.size(), simulated_input.data());
+
+        return simulated_input;
     }
 
+    /*
+        Обратный проход при обучении с учётом квантования пополняет
+        диапазон входа. Параметры квантования от этого не меняются: Forward
+        уже считал их по диапазону вместе с X
+    */
+    const Tensor<T>& ObserveTraining(const Tensor<T>& X)
+    {
+        if (quantization_aware)
+            Observe(X);
+
+        return SimulatedInput(X);
+    }
 
+    /*
+        Части работы - пример, фильтр и полоса строк выхода
+    */
+    Tensor<T> ForwardDirect(const Tensor<T>& X) const
+    {
+        if (fixed_forward != nullptr)
+            return ForwardFixed(X);
+
+        const unsigned int batch = X.get_batch();
+
+        const unsigned int padded_height = input_height + 2 * padding;
+        const unsigned int padded_width = input_width + 2 * padding;
+        const std::size_t channel = (std::size_t)padded_height * padded_width;
+
+        const unsigned int row_tiles = (output_height + parallel_rows - 1) / parallel_rows;
+
+        Tensor<T> Y = Tensor<T>(batch, filter_count, output_height, output_width, 0);
+
+        const T* xp = PadBatch(X);
+
+        ThreadPool::Shared().ParallelFor((std::size_t)batch * filter_count * row_tiles, [&](std::size_t item)
+        {
+            const unsigned int tile = item % row_tiles;
+            const unsigned int f = item / row_tiles % filter_count;
+            const unsigned int n = item / row_tiles / filter_count;
+
+            const T* filter = filters.sample(f);
+            const T* x_n = xp + (std::size_t)n * input_depth * channel;
+
+            const unsigned int row_end = std::min(output_height, (tile + 1) * parallel_rows);
+
+            for(unsigned int yh = tile * parallel_rows; yh < row_end; ++yh)
+            {
+                for(unsigned int yw = 0; yw < output_width; ++yw)
+                {
+                    // Левый верхний угол окна во входе с паддингом
+                    const T* x0 = x_n + (std::size_t)yh * stride * padded_width + yw * stride;
+
+                    T S = B[f];
+
+                    for(unsigned int d = 0; d < input_depth; ++d)
+                    {
+                        const T* x_d = x0 + d * channel;
+                        const T* w_d = filter + (std::size_t)d * filter_size * filter_size;
+
+                        for(unsigned int fh = 0; fh < filter_size; ++fh)
+                            for(unsigned int fw = 0; fw < filter_size; ++fw)
+                                S += w_d[fh * filter_size + fw] * x_d[((std::size_t)fh * padded_width + fw) * dilation];
+                    }
+
+                    Y(n, f, yh, yw) = S;
+                }
+            }
+        });
+
+        return Y;
+    }
+
+
+    /*
+        Вход всего батча с нулевым паддингом. Без паддинга копия не
+        нужна, и возвращаются данные самого X
+    */
+    const T* PadBatch(const Tensor<T>& X) const
+    {
+        if (padding == 0)
+            return X.data();
+
+        const std::size_t padded_size = (std::size_t)input_depth * (input_height + 2 * padding) * (input_width + 2 * padding);
+
+        padded_input.resize(X.get_batch() * padded_size);
+
+        for(unsigned int n = 0; n < X.get_batch(); ++n)
+            PadInput(X.sample(n), input_depth, input_height, input_width, padding, padded_input.data() + n * padded_size);
+
+        return padded_input.data();
+    }
+
+
+    /*
+        Прямая свёртка ядром с размером фильтра и шагом из шаблона,
+        фильтры берутся прямо из filters (F x D*K*K подряд)
+    */
+    Tensor<T> ForwardFixed(const Tensor<T>& X) const
+    {
+        const unsigned int batch = X.get_batch();
+
+        const unsigned int padded_height = input_height + 2 * padding;
+        const unsigned int padded_width = input_width + 2 * padding;
+
+        const std::size_t padded_size = (std::size_t)input_depth * padded_height * padded_width;
+
+        const std::size_t outputs = (std::size_t)output_height * output_width;
+
+        const unsigned int row_tiles = (output_height + parallel_rows - 1) / parallel_rows;
+
+        Tensor<T> Y = Tensor<T>(batch, filter_count, output_height, output_width, 0);
+
+        const T* xp = PadBatch(X);
+
+        // Части работы - пример, фильтр и полоса строк выхода
+        ThreadPool::Shared().ParallelFor((std::size_t)batch * filter_count * row_tiles, [&](std::size_t item)
+        {
+            const unsigned int tile = item % row_tiles;
+            const unsigned int f = item / row_tiles % filter_count;
+            const unsigned int n = item / row_tiles / filter_count;
+
+            const unsigned int row_begin = tile * parallel_rows;
+            const unsigned int rows = std::min(parallel_rows, output_height - row_begin);
+
+            fixed_forward(
+                xp + n * padded_size + (std::size_t)row_begin * stride * padded_width,
+                filters.sample(f), B.data() + f,
+                input_depth, padded_height, padded_width,
+                1, rows, output_width,
+                Y.sample(n) + f * outputs + (std::size_t)row_begin * output_width
+            );
+        });
+
+        return Y;
+    }
+
+
+    /*
+        Упаковка весов для Gemm (при WeightLayout::GemmPacked)
+    */
+    void PackWeights() const
+    {
+        if (packed_version == weights_version)
+            return;
+
+        packed_version = weights_version;
+
+        const unsigned int rows = input_depth * filter_size * filter_size;
+
+        packed_weights.Pack(false, filters.data(), rows, filter_count, rows);
+        packed_weights_t.Pack(true, filters.data(), rows, rows, filter_count);
+    }
+
+
+    /*
+        Для каждого примера вход разворачивается в матрицу im2col,
+        после чего все фильтры применяются одним умножением матриц
+    */
+    Tensor<T> ForwardIm2ColGemm(const Tensor<T>& X) const
+    {
+        const unsigned int batch = X.get_batch();
+
+        const unsigned int rows = input_depth * filter_size * filter_size;
+        const unsigned int columns = output_height * output_width;
+
+        Tensor<T> Y = Tensor<T>(batch, filter_count, output_height, output_width, 0);
+
+        const bool packed = weight_layout == WeightLayout::GemmPacked;
+
+        if (packed)
+            PackWeights();
+
+        im2col_workspace.resize((std::size_t)rows * columns);
+
+        const unsigned int column_tiles = (columns + parallel_columns - 1) / parallel_columns;
+
+        for(unsigned int n = 0; n < batch; ++n)
+        {
+            Im2Col(
+                X.sample(n), input_depth, input_height, input_width,
+                filter_size, padding, stride, dilation, output_height, output_width,
+                im2col_workspace.data()
+            );
+
+            T* y = Y.sample(n);
+
+            // Части работы - полосы позиций выхода, у каждой свои столбцы C и B
+            ThreadPool::Shared().ParallelFor(column_tiles, [&](std::size_t tile)
+            {
+                const unsigned int c0 = tile * parallel_columns;
+                const unsigned int nc = std::min(parallel_columns, columns - c0);
+
+                for(unsigned int f = 0; f < filter_count; ++f)
+                    std::fill(y + (std::size_t)f * columns + c0, y + (std::size_t)f * columns + c0 + nc, B[f]);
+
+                if (packed)
+                    Gemm<T>(
+                        packed_weights, false, nc,
+                        1, im2col_workspace.data() + c0, columns,
+                        1, y + c0, columns
+                    );
+                else
+                    Gemm<T>(
+                        false, false, filter_count, nc, rows,
+                        1, filters.data(), rows,
+                        im2col_workspace.data() + c0, columns,
+                        1, y + c0, columns
+                    );
+            });
+        }
+
+        return Y;
+    }
+
+
+    /*
+        Прямой проход в int8: вход с паддингом квантуется в uint8 один раз,
+        развёртка Im2ColInt8 раскладывает окна четвёрками байтов, и Int8Gemm
+        считает все фильтры сразу для блока позиций выхода, записывая
+        результат уже в T
+    */
+    Tensor<T> ForwardInt8(const Tensor<T>& X) const
+    {
+        const unsigned int batch = X.get_batch();
+
+        const unsigned int padded_height = input_height + 2 * padding;
+        const unsigned int padded_width = input_width + 2 * padding;
+        const std::size_t padded_size = (std::size_t)input_depth * padded_height * padded_width;
+
+        const unsigned int groups = (input_depth * filter_size * filter_size + 3) / 4;
+        const unsigned int columns = output_height * output_width;
+
+        Tensor<T> Y = Tensor<T>(batch, filter_count, output_height, output_width, 0);
+
+        int8_padded.resize(batch * padded_size);
+        int8_input.Quantize(PadBatch(X), batch * padded_size, int8_padded.data());
+
+        const unsigned int column_tiles = (columns + parallel_columns - 1) / parallel_columns;
+
+        for(unsigned int n = 0; n < batch; ++n)
+        {
+            Im2ColInt8(
+                int8_padded.data() + n * padded_size, input_depth, padded_height, padded_width,
+                filter_size, stride, dilation, output_height, output_width,
+                int8_col.data()
+            );
+
+            T* y = Y.sample(n);
+
+            // Части работы - полосы позиций выхода
+            ThreadPool::Shared().ParallelFor(column_tiles, [&](std::size_t tile)
+            {
+                const unsigned int c0 = tile * parallel_columns;
+                const unsigned int nc = std::min(parallel_columns, columns - c0);
+
+                Int8Gemm<T>(
+                    filter_count, nc, groups,
+                    int8_filters.value.data(), int8_filters.stride,
+                    int8_col.data() + (std::size_t)c0 * 4, columns,
+                    int8_filters.alpha.data(), int8_filters.beta.data(),
+                    y + c0, columns
+                );
+            });
+        }
+
+        return Y;
+    }
+
+
+    /*
+        Преобразованные фильтры U = G * g * GT раскладываются как
+        U[alpha^2][F][D] и пересчитываются только после изменения весов
+    */
+    void PrepareWinograd() const
+    {
+        const unsigned int m = GetWinogradTile();
+
+        if (winograd.m != m || winograd.r != filter_size)
+        {
+            winograd.Initialize(m, filter_size);
+            winograd_version = 0;
+        }
+
+        if (winograd_version == weights_version)
+            return;
+
+        winograd_version = weights_version;
+
+        const unsigned int alpha = winograd.alpha;
+        const std::size_t stride = (std::size_t)filter_count * input_depth;
+
+        winograd_filters.resize((std::size_t)alpha * alpha * stride);
+
+        for(unsigned int f = 0; f < filter_count; ++f)
+            for(unsigned int d = 0; d < input_depth; ++d)
+                WinogradFilterTransform(
+                    winograd, filters.sample(f) + (std::size_t)d * filter_size * filter_size,
+                    winograd_filters.data() + (std::size_t)f * input_depth + d, stride
+                );
+    }
+
+
+    /*
+        Плитки входа всех примеров переводятся в область Винограда, затем
+        для каждой из alpha^2 частот выполняется одно умножение матриц
+        U [F x D] * V [D x плитки батча], и результат переводится обратно
+    */
+    Tensor<T> ForwardWinograd(const Tensor<T>& X) const
+    {
+        if (stride != 1 || dilation != 1 || WinogradOutputTile(filter_size) == 0)
+            return ForwardDirect(X);
+
+        PrepareWinograd();
+
+        const unsigned int batch = X.get_batch();
+
+        const unsigned int m = winograd.m;
+        const unsigned int alpha = winograd.alpha;
+
+        const unsigned int tiles_h = (output_height + m - 1) / m;
+        const unsigned int tiles_w = (output_width + m - 1) / m;
+        const unsigned int P = tiles_h * tiles_w;
+        const unsigned int columns = batch * P;
+
+        Tensor<T> Y = Tensor<T>(batch, filter_count, output_height, output_width, 0);
+
+        // Рабочие буферы преобразований у каждого примера свои
+        const std::size_t tiles_size = (std::size_t)alpha * alpha * P;
+        const std::size_t temp_size = (std::size_t)std::max(alpha * alpha, m * alpha + m * m) * P;
+
+        winograd_tiles.resize(batch * tiles_size);
+        winograd_temp.resize(batch * temp_size);
+        winograd_input.resize((std::size_t)alpha * alpha * input_depth * columns);
+        winograd_product.resize((std::size_t)alpha * alpha * filter_count * columns);
+
+        ThreadPool& pool = ThreadPool::Shared();
+
+        pool.ParallelFor(batch, [&](std::size_t n)
+        {
+            WinogradInputTransform(
+                winograd, X.sample(n), input_depth, input_height, input_width, padding,
+                tiles_h, tiles_w, winograd_tiles.data() + n * tiles_size, winograd_temp.data() + n * temp_size,
+                winograd_input.data() + n * P, columns
+            );
+        });
+
+        pool.ParallelFor(alpha * alpha, [&](std::size_t k)
+        {
+            Gemm<T>(
+                false, false, filter_count, columns, input_depth,
+                1, winograd_filters.data() + k * filter_count * input_depth, input_depth,
+                winograd_input.data() + k * input_depth * columns, columns,
+                0, winograd_product.data() + k * filter_count * columns, columns
+            );
+        });
+
+        pool.ParallelFor(batch, [&](std::size_t n)
+        {
+            WinogradOutputTransform(
+                winograd, winograd_product.data() + n * P, filter_count, tiles_h, tiles_w,
+                output_height, output_width, B.data(), winograd_temp.data() + n * temp_size, Y.sample(n), columns
+            );
+        });
+
+        return Y;
+    }
+
+
+    /*
+        Спектры фильтров считаются для размера БПФ, покрывающего вход
+        с паддингом, хранятся сопряжёнными и пересчитываются только
+        после изменения весов
+    */
+    void PrepareFFT() const
+    {
+        const unsigned int rows = FFTSize(input_height + 2 * padding);
+        const unsigned int cols = FFTSize(input_width + 2 * padding);
+
+        if (fft_rows.n != rows || fft_cols.n != cols)
+        {
+            fft_rows.Initialize(rows);
+            fft_cols.Initialize(cols);
+            fft_version = 0;
+        }
+
+        if (fft_version == weights_version)
+            return;
+
+        fft_version = weights_version;
+
+        const std::size_t size = (std::size_t)rows * cols;
+
+        fft_filters.assign((std::size_t)filter_count * input_depth * size, 0);
+
+        for(unsigned int f = 0; f < filter_count; ++f)
+        {
+            for(unsigned int d = 0; d < input_depth; ++d)
+            {
+                complex<T>* spectrum = fft_filters.data() + ((std::size_t)f * input_depth + d) * size;
+
+                for(unsigned int fh = 0; fh < filter_size; ++fh)
+                    for(unsigned int fw = 0; fw < filter_size; ++fw)
+                        spectrum[((std::size_t)fh * cols + fw) * dilation] = filters(f, d, fh, fw);
+
+                FFT2D(fft_rows, fft_cols, spectrum, false);
+
+                for(std::size_t i = 0; i < size; ++i)
+                    spectrum[i] = std::conj(spectrum[i]);
+            }
+        }
+    }
+
+
+    /*
+        Взаимная корреляция через спектры: Y_f = IFFT( sum_d X_d * conj(G_fd) ).
+        Размер БПФ не меньше входа с паддингом, поэтому циклический сдвиг
+        не заворачивается на нужные позиции выхода. Шаг stride берётся
+        прореживанием результата
+    */
+    Tensor<T> ForwardFFT(const Tensor<T>& X) const
+    {
+        PrepareFFT();
+
+        const unsigned int batch = X.get_batch();
+
+        const unsigned int cols = fft_cols.n;
+        const std::size_t size = (std::size_t)fft_rows.n * cols;
+
+        Tensor<T> Y = Tensor<T>(batch, filter_count, output_height, output_width, 0);
+
+        fft_input.resize((std::size_t)input_depth * size);
+        fft_output.resize((std::size_t)filter_count * size);
+
+        ThreadPool& pool = ThreadPool::Shared();
+
+        for(unsigned int n = 0; n < batch; ++n)
+        {
+            pool.ParallelFor(input_depth, [&](std::size_t d)
+            {
+                complex<T>* spectrum = fft_input.data() + d * size;
+
+                std::fill(spectrum, spectrum + size, complex<T>(0));
+
+                for(unsigned int h = 0; h < input_height; ++h)
+                    for(unsigned int w = 0; w < input_width; ++w)
+                        spectrum[(std::size_t)(h + padding) * cols + w + padding] = X(n, d, h, w);
+
+                FFT2D(fft_rows, fft_cols, spectrum, false);
+            });
+
+            // У каждого фильтра свой буфер спектра выхода
+            pool.ParallelFor(filter_count, [&](std::size_t f)
+            {
+                complex<T>* output = fft_output.data() + f * size;
+
+                std::fill(output, output + size, complex<T>(0));
+
+                for(unsigned int d = 0; d < input_depth; ++d)
+                {
+                    const complex<T>* x = fft_input.data() + (std::size_t)d * size;
+                    const complex<T>* g = fft_filters.data() + (f * input_depth + d) * size;
+
+                    for(std::size_t i = 0; i < size; ++i)
+                        output[i] += ComplexMultiply(x[i], g[i]);
+                }
+
+                FFT2D(fft_rows, fft_cols, output, true);
+
+                for(unsigned int yh = 0; yh < output_height; ++yh)
+                    for(unsigned int yw = 0; yw < output_width; ++yw)
+                        Y(n, f, yh, yw) = B[f] + output[(std::size_t)yh * stride * cols + yw * stride].real();
+            });
+        }
+
+        return Y;
+    }
+
+
+    /*
+        Фильтры в раскладке Wb [F/C][D/C][K][K][C][C], хвосты блоков нулевые
+    */
+    void PrepareBlocked() const
+    {
+        if (blocked_version == weights_version)
+            return;
+
+        blocked_version = weights_version;
+
+        constexpr unsigned int C = BlockedConvTile<T>::C;
+
+        const unsigned int filter_blocks = (filter_count + C - 1) / C;
+        const unsigned int depth_blocks = (input_depth + C - 1) / C;
+
+        blocked_filters.assign((std::size_t)filter_blocks * depth_blocks * filter_size * filter_size * C * C, 0);
+
+        for(unsigned int f = 0; f < filter_count; ++f)
+        {
+            for(unsigned int d = 0; d < input_depth; ++d)
+            {
+                for(unsigned int fh = 0; fh < filter_size; ++fh)
+                {
+                    for(unsigned int fw = 0; fw < filter_size; ++fw)
+                    {
+                        std::size_t block = (std::size_t)(f / C) * depth_blocks + d / C;
+                        std::size_t index = (((block * filter_size + fh) * filter_size + fw) * C + d % C) * C + f % C;
+
+                        blocked_filters[index] = filters(f, d, fh, fw);
+                    }
+                }
+            }
+        }
+    }
+
+
+    Tensor<T> ForwardBlocked(const Tensor<T>& X) const
+    {
+        PrepareBlocked();
+
+        constexpr unsigned int C = BlockedConvTile<T>::C;
+        constexpr unsigned int RW = BlockedConvTile<T>::MaxRW;
+
+        const unsigned int batch = X.get_batch();
+
+        unsigned int padded_height, padded_width;
+
+        BlockedConvPaddedSize(
+            input_height, input_width, filter_size, padding, stride, dilation,
+            output_width, RW, padded_height, padded_width
+        );
+
+        const unsigned int depth_blocks = (input_depth + C - 1) / C;
+
+        Tensor<T> Y = Tensor<T>(batch, filter_count, output_height, output_width, 0);
+
+        // Паддинг не перезаписывается, поэтому буфер обнуляется один раз
+        blocked_input.assign((std::size_t)depth_blocks * padded_height * padded_width * C, 0);
+
+        for(unsigned int n = 0; n < batch; ++n)
+        {
+            BlockedConvPackInput(
+                X.sample(n), input_depth, input_height, input_width, padding,
+                padded_height, padded_width, blocked_input.data()
+            );
+
+            BlockedConvForward(
+                blocked_input.data(), blocked_filters.data(), B.data(),
+                input_depth, filter_count, padded_height, padded_width,
+                filter_size, stride, dilation, output_height, output_width, Y.sample(n)
+            );
+        }
+
+        return Y;
+    }
+
+
+    /*
+        Обратный проход через те же матрицы:
+
+        dW   [F x D*K*K]     += G [F x OH*OW] * col^T
+        dcol [D*K*K x OH*OW]  = W^T * G,  после чего col2im даёт градиент по входу
+    */
+    Tensor<T> BackwardIm2ColGemm(const Tensor<T>& X, const Tensor<T>& GFNL)
+    {
+        const unsigned int batch = X.get_batch();
+
+        const unsigned int rows = input_depth * filter_size * filter_size;
+        const unsigned int columns = output_height * output_width;
+
+        const bool packed = weight_layout == WeightLayout::GemmPacked;
+
+        if (packed)
+            PackWeights();
+
+        /*
+            Примеры делятся на slots блоков подряд, каждый блок копит
+            градиент весов в свой буфер (блок 0 - прямо в weight_gradient)
+            и имеет свои буферы im2col. Буферы складываются в порядке блоков
+        */
+        const unsigned int slots = std::min(batch, gradient_slots);
+
+        const std::size_t weights = (std::size_t)filter_count * rows;
+        const std::size_t workspace = (std::size_t)rows * columns;
+
+        weight_gradient.assign(slots * weights, 0);
+        im2col_workspace.resize(slots * workspace);
+        column_gradient.resize(slots * workspace);
+
+        Tensor<T> GFCL = Tensor<T>(batch, input_depth, input_height, input_width, 0);
+
+        ThreadPool::Shared().ParallelFor(slots, [&](std::size_t slot)
+        {
+            T* col = im2col_workspace.data() + slot * workspace;
+            T* col_gradient = column_gradient.data() + slot * workspace;
+            T* delta_w = weight_gradient.data() + slot * weights;
+
+            for(unsigned int n = slot * batch / slots; n < (slot + 1) * batch / slots; ++n)
+            {
+                const T* g = GFNL.sample(n);
+
+                Im2Col(
+                    X.sample(n), input_depth, input_height, input_width,
+                    filter_size, padding, stride, dilation, output_height, output_width,
+                    col
+                );
+
+                Gemm<T>(
+                    false, true, filter_count, rows, columns,
+                    1, g, columns,
+                    col, columns,
+                    1, delta_w, rows
+                );
+
+                if (packed)
+                    Gemm<T>(
+                        packed_weights_t, false, columns,
+                        1, g, columns,
+                        0, col_gradient, columns
+                    );
+                else
+                    Gemm<T>(
+                        true, false, rows, columns, filter_count,
+                        1, filters.data(), rows,
+                        g, columns,
+                        0, col_gradient, columns
+                    );
+
+                Col2Im(
+                    col_gradient, input_depth, input_height, input_width,
+                    filter_size, padding, stride, dilation, output_height, output_width,
+                    GFCL.sample(n)
+                );
+            }
+        });
+
+        for(unsigned int slot = 1; slot < slots; ++slot)
+            VectorAxpy((T)1, weight_gradient.data() + slot * weights, weight_gradient.data(), weights);
+
+        ApplyGradient(GFNL);
+
+        return GFCL;
+    }
+
+
+    Tensor<T> BackwardDirect(const Tensor<T>& X, const Tensor<T>& GFNL)
+    {
+        const unsigned int batch = X.get_batch();
+
+        const unsigned int rows = input_depth * filter_size * filter_size;
+
+        const unsigned int padded_height = input_height + 2 * padding;
+        const unsigned int padded_width = input_width + 2 * padding;
+        const std::size_t channel = (std::size_t)padded_height * padded_width;
+
+        const T* xp = PadBatch(X);
+
+        ThreadPool& pool = ThreadPool::Shared();
+
+        // Градиенты весов суммируются по всему батчу. Градиент фильтра f
+        // целиком считает одна часть работы, поэтому сводить буферы не нужно
+
+        weight_gradient.assign((std::size_t)filter_count * rows, 0);
+
+        pool.ParallelFor(filter_count, [&](std::size_t f)
+        {
+            T* delta_w_f = weight_gradient.data() + f * rows;
+
+            for(unsigned int n = 0; n < batch; ++n)
+            {
+                const T* x_n = xp + (std::size_t)n * input_depth * channel;
+
+                for(unsigned int d = 0; d < input_depth; ++d)
+                {
+                    T* delta_w_d = delta_w_f + (std::size_t)d * filter_size * filter_size;
+
+                    for(unsigned int gh = 0; gh < output_height; ++gh)
+                    {
+                        for(unsigned int gw = 0; gw < output_width; ++gw)
+                        {
+                            const T g = GFNL(n, f, gh, gw);
+                            const T* x0 = x_n + d * channel + (std::size_t)gh * stride * padded_width + gw * stride;
+
+                            for(unsigned int fh = 0; fh < filter_size; ++fh)
+                                for(unsigned int fw = 0; fw < filter_size; ++fw)
+                                    delta_w_d[fh * filter_size + fw] += g * x0[((std::size_t)fh * padded_width + fw) * dilation];
+                        }
+                    }
+                }
+            }
+        });
+
+        // Расчет возвращаемого градиента (по весам до обновления)
+        
+        Tensor<T> GFCL = Tensor<T>(batch, input_depth, input_height, input_width, 0);
+
+        // Без паддинга градиент копится прямо в GFCL, иначе - во вход
+        // с паддингом, от которого потом отрезается рамка
+        T* gp = GFCL.data();
+
+        if (padding != 0)
+        {
+            padded_gradient.assign(batch * input_depth * channel, 0);
+            gp = padded_gradient.data();
+        }
+
+        // Части работы - канал входа одного примера, фильтры внутри
+        // перебираются по порядку
+        pool.ParallelFor((std::size_t)batch * input_depth, [&](std::size_t item)
+        {
+            const unsigned int d = item % input_depth;
+            const unsigned int n = item / input_depth;
+
+            T* g_d = gp + item * channel;
+
+            for(unsigned int f = 0; f < filter_count; ++f)
+            {
+                const T* w_d = filters.sample(f) + (std::size_t)d * filter_size * filter_size;
+
+                for(unsigned int gh = 0; gh < output_height; ++gh)
+                {
+                    for(unsigned int gw = 0; gw < output_width; ++gw)
+                    {
+                        const T g = GFNL(n, f, gh, gw);
+                        T* g0 = g_d + (std::size_t)gh * stride * padded_width + gw * stride;
+
+                        for(unsigned int fh = 0; fh < filter_size; ++fh)
+                            for(unsigned int fw = 0; fw < filter_size; ++fw)
+                                g0[((std::size_t)fh * padded_width + fw) * dilation] += g * w_d[fh * filter_size + fw];
+                    }
+                }
+            }
+        });
+
+        if (padding != 0)
+        {
+            for(unsigned int n = 0; n < batch; ++n)
+            {
+                for(unsigned int d = 0; d < input_depth; ++d)
+                {
+                    const T* src = gp + ((std::size_t)n * input_depth + d) * channel;
+                    T* dst = GFCL.sample(n) + (std::size_t)d * input_height * input_width;
+
+                    for(unsigned int h = 0; h < input_height; ++h)
+                        std::copy(
+                            src + (std::size_t)(h + padding) * padded_width + padding,
+                            src + (std::size_t)(h + padding) * padded_width + padding + input_width,
+                            dst + (std::size_t)h * input_width
+                        );
+                }
+            }
+        }
+
+        ApplyGradient(GFNL);
+
+        return GFCL;
+    }
+
+
+    /*
+        Обновление весов накопленным weight_gradient (фильтры и градиент
+        лежат одинаково, поэтому это один проход по буферу) и смещений
+        суммой градиента по каждой карте выхода
+    */
+    void ApplyGradient(const Tensor<T>& GFNL)
+    {
+        VectorAxpy(-learning_rate, weight_gradient.data(), filters.data(), filters.size());
+
+        // Карта градиента может быть меньше выхода (только ненулевые
+        // позиции после слитого пулинга), смещению нужна лишь её сумма
+        const unsigned int columns = GFNL.get_height() * GFNL.get_width();
+
+        for(unsigned int f = 0; f < filter_count; ++f)
+        {
+            T db = 0;
+
+            for(unsigned int n = 0; n < GFNL.get_batch(); ++n)
+            {
+                const T* g = GFNL.sample(n) + (std::size_t)f * columns;
+
+                for(unsigned int c = 0; c < columns; ++c)
+                    db += g[c];
+            }
+
+            B[f] -= db * learning_rate;
+        }
+
+        // Изменённые веса снова кладутся на сетку int8
+        if (quantization_aware)
+        {
+            const unsigned int rows = input_depth * filter_size * filter_size;
+            SimulateInt8Rows(filter_count, rows, filters.data(), rows, int8_residual.data());
+        }
+
+        ++weights_version;
+    }
 
 };
 
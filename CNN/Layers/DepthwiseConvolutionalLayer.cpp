@@ -0,0 +1,274 @@
+#ifndef DEPTHWISE_CONVOLUTIONAL_LAYER
+#define DEPTHWISE_CONVOLUTIONAL_LAYER
+
+#include <vector>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+#include "../Tensor.cpp"
+#include "../Kernels/Im2Col.cpp"
+#include "../Kernels/ThreadPool.cpp"
+#include "../Kernels/DepthwiseConv.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Поканальная свёртка: у каждого канала свой фильтр K x K, глубина
+    выхода равна глубине входа. Вместе с поточечной свёрткой 1x1
+    (PointwiseConvolutionalLayer) заменяет обычную свёртку, как в
+    MobileNet: D*K*K + D*F умножений на позицию выхода вместо D*K*K*F
+
+    Вход, как и у ConvolutionalLayer, может быть батчем N x D x H x W.
+    Каналы независимы, поэтому части работы для пула потоков - канал
+    одного примера (прямой проход) или канал всего батча (обратный)
+*/
+template <typename T>
+class DepthwiseConvolutionalLayer
+{
+    unsigned int input_depth;
+    unsigned int input_height;
+    unsigned int input_width;
+
+    unsigned int filter_size;
+
+    unsigned int padding;
+    unsigned int stride;
+
+    unsigned int output_height;
+    unsigned int output_width;
+
+    // Вход батча с паддингом и градиент по нему, переиспользуются между вызовами
+    mutable std::vector<T> padded_input;
+    std::vector<T> padded_gradient;
+
+    std::vector<T> weight_gradient;
+
+public:
+
+    T learning_rate;
+
+    // D x K x K, по фильтру на канал
+    Tensor<T> filters;
+    std::vector<T> B;
+
+    DepthwiseConvolutionalLayer(){}
+
+    void Initialize
+    (
+        unsigned int input_depth,
+        unsigned int input_height,
+        unsigned int input_width,
+        unsigned int filter_size = 3,
+        unsigned int padding = 0,
+        unsigned int stride = 1,
+        T learning_rate = 1.0e-4,
+        T mean = 0,
+        T sigma = 0
+    )
+    {
+        this->input_depth = input_depth;
+        this->input_height = input_height;
+        this->input_width = input_width;
+
+        this->filter_size = filter_size;
+
+        this->padding = padding;
+        this->stride = stride;
+
+        this->learning_rate = learning_rate;
+
+        if (stride == 0 || filter_size == 0 || filter_size > input_height + 2 * padding || filter_size > input_width + 2 * padding)
+        {
+            std::cout << "Stride must be positive and filter window must fit into padded input (Depthwise convolutional layer)!" << std::endl;
+            throw;
+        }
+
+        this->output_height = (input_height - filter_size + 2 * padding) / stride + 1;
+        this->output_width = (input_width - filter_size + 2 * padding) / stride + 1;
+
+        filters = Tensor<T>(input_depth, filter_size, filter_size);
+        B.assign(input_depth, 0);
+
+        DefineWeights(mean, sigma);
+    }
+
+
+    void DefineWeights(T mean, T sigma = 0)
+    {
+        if (sigma == 0)
+        {
+            std::fill(filters.data(), filters.data() + filters.size(), mean);
+            std::fill(B.begin(), B.end(), mean);
+        }
+        else
+        {
+            // Создание генератора шума, распределенного нормально
+            std::random_device rd{};
+            std::mt19937 gen{rd()};
+            std::normal_distribution d = std::normal_distribution(mean, sigma);
+            auto random_double = [&d, &gen]{ return d(gen); };
+
+            for(std::size_t i = 0; i < filters.size(); ++i)
+                filters.data()[i] = random_double();
+
+            for(unsigned int c = 0; c < input_depth; ++c)
+                B[c] = random_double();
+        }
+    }
+
+
+    Tensor<T> Forward(const Tensor<T>& X) const
+    {
+        if (X.get_depth() != input_depth || X.get_height() != input_height || X.get_width() != input_width)
+        {
+            std::cout << "Input tensor is wrong size (Depthwise convolutional layer)!" << std::endl;
+            throw;
+        }
+
+        const unsigned int batch = X.get_batch();
+
+        const unsigned int padded_height = input_height + 2 * padding;
+        const unsigned int padded_width = input_width + 2 * padding;
+        const std::size_t channel = (std::size_t)padded_height * padded_width;
+        const std::size_t outputs = (std::size_t)output_height * output_width;
+        const unsigned int window = filter_size * filter_size;
+
+        Tensor<T> Y = Tensor<T>(batch, input_depth, output_height, output_width, 0);
+
+        const T* xp = PadBatch(X);
+
+        // Часть работы - канал d примера n, item = n * D + d
+        ThreadPool::Shared().ParallelFor((std::size_t)batch * input_depth, [&](std::size_t item)
+        {
+            const unsigned int d = item % input_depth;
+
+            DepthwiseConvForward(
+                xp + item * channel, filters.data() + (std::size_t)d * window, B.data() + d,
+                1, padded_height, padded_width,
+                filter_size, stride, output_height, output_width,
+                Y.data() + item * outputs
+            );
+        });
+
+        return Y;
+    }
+
+
+    /*
+        Градиент по входу считается по весам до обновления
+    */
+    Tensor<T> Backward(const Tensor<T>& X, const Tensor<T>& GFNL)
+    {
+        if (GFNL.get_depth() != input_depth || GFNL.get_height() != output_height || GFNL.get_width() != output_width || GFNL.get_batch() != X.get_batch())
+        {
+            std::cout << "Gradient from next layer is wrong dimension (Depthwise convolutional layer)!" << std::endl;
+            throw;
+        }
+
+        const unsigned int batch = X.get_batch();
+
+        const unsigned int padded_height = input_height + 2 * padding;
+        const unsigned int padded_width = input_width + 2 * padding;
+        const std::size_t channel = (std::size_t)padded_height * padded_width;
+        const std::size_t padded_size = input_depth * channel;
+
+        const T* xp = PadBatch(X);
+
+        Tensor<T> GFCL = Tensor<T>(batch, input_depth, input_height, input_width, 0);
+
+        // Без паддинга градиент копится прямо в GFCL
+        T* gp = GFCL.data();
+
+        if (padding != 0)
+        {
+            padded_gradient.assign(batch * padded_size, 0);
+            gp = padded_gradient.data();
+        }
+
+        weight_gradient.assign(filters.size(), 0);
+
+        const std::size_t outputs = (std::size_t)output_height * output_width;
+        const unsigned int window = filter_size * filter_size;
+
+        ThreadPool& pool = ThreadPool::Shared();
+
+        // Градиент фильтра канала d целиком считает одна часть работы, по всем примерам
+        pool.ParallelFor(input_depth, [&](std::size_t d)
+        {
+            for(unsigned int n = 0; n < batch; ++n)
+            {
+                const std::size_t item = (std::size_t)n * input_depth + d;
+
+                DepthwiseConvBackward(
+                    xp + item * channel, filters.data() + d * window, GFNL.data() + item * outputs,
+                    1, padded_height, padded_width,
+                    filter_size, stride, output_height, output_width,
+                    weight_gradient.data() + d * window, gp + item * channel
+                );
+            }
+        });
+
+        if (padding != 0)
+        {
+            pool.ParallelFor((std::size_t)batch * input_depth, [&](std::size_t item)
+            {
+                const T* src = gp + item * channel;
+                T* dst = GFCL.data() + item * input_height * input_width;
+
+                for(unsigned int h = 0; h < input_height; ++h)
+                    std::copy(
+                        src + (std::size_t)(h + padding) * padded_width + padding,
+                        src + (std::size_t)(h + padding) * padded_width + padding + input_width,
+                        dst + (std::size_t)h * input_width
+                    );
+            });
+        }
+
+        // Обновление весов и смещений
+
+        VectorAxpy(-learning_rate, weight_gradient.data(), filters.data(), filters.size());
+
+        for(unsigned int d = 0; d < input_depth; ++d)
+        {
+            T db = 0;
+
+            for(unsigned int n = 0; n < batch; ++n)
+            {
+                const T* g = GFNL.sample(n) + d * outputs;
+
+                for(std::size_t i = 0; i < outputs; ++i)
+                    db += g[i];
+            }
+
+            B[d] -= db * learning_rate;
+        }
+
+        return GFCL;
+    }
+
+private:
+
+    /*
+        Вход всего батча с нулевым паддингом, без паддинга - данные самого X
+    */
+    const T* PadBatch(const Tensor<T>& X) const
+    {
+        if (padding == 0)
+            return X.data();
+
+        const std::size_t padded_size = (std::size_t)input_depth * (input_height + 2 * padding) * (input_width + 2 * padding);
+
+        padded_input.resize(X.get_batch() * padded_size);
+
+        for(unsigned int n = 0; n < X.get_batch(); ++n)
+            PadInput(X.sample(n), input_depth, input_height, input_width, padding, padded_input.data() + n * padded_size);
+
+        return padded_input.data();
+    }
+
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
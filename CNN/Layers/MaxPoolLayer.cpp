@@ -1,11 +1,13 @@
 #ifndef MAX_POOL_LAYER
 #define MAX_POOL_LAYER
 
+#include <vector>
 #include <iostream>
 #include "../Tensor.cpp"
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
 
+template <typename T>
 class MaxPoolLayer
 {
     unsigned int D;
@@ -19,8 +21,8 @@ class MaxPoolLayer
     unsigned int kernel_size = 0;
     unsigned int kernel_stride = 0;
 
-    unsigned int*** GHIndex;
-    unsigned int*** GWIndex;
+    // Для каждого выхода - положение максимума во входном тензоре (с учётом батча)
+    std::vector<std::size_t> max_index;
 
 public:
 
@@ -40,27 +42,11 @@ public:
         YH = (XH - kernel_size) / kernel_stride + 1;
         YW = (XW - kernel_size) / kernel_stride + 1;
 
-        GHIndex = new unsigned int**[D];
-        GWIndex = new unsigned int**[D];
-        for(unsigned int d = 0; d < D; ++d)
-        {
-            GHIndex[d] = new unsigned int*[YH];
-            GWIndex[d] = new unsigned int*[YH];
-            for(unsigned int h = 0; h < YH; ++h)
-            {
-                GHIndex[d][h] = new unsigned int[YW];
-                GWIndex[d][h] = new unsigned int[YW];
-                for(unsigned int w = 0; w < YW; ++w)
-                {
-                    GHIndex[d][h][w] = 0;
-                    GWIndex[d][h][w] = 0;
-                }
-            }
-        }
+        max_index.assign((std::size_t)D * YH * YW, 0);
     }
 
 
-    Tensor Forward(const Tensor& X) 
+    Tensor<T> Forward(const Tensor<T>& X) 
     {
         if (X.get_height() != XH || X.get_width() != XW || X.get_depth() != D)
         {
@@ -68,34 +54,47 @@ public:
             throw;
         }
 
-        Tensor Y = Tensor(D, YH, YW);
+        const unsigned int batch = X.get_batch();
+
+        Tensor<T> Y = Tensor<T>(batch, D, YH, YW, 0);
 
-        for(unsigned int d = 0; d < D; ++d)
+        max_index.resize(Y.size());
+
+        const T* x = X.data();
+        T* y = Y.data();
+
+        std::size_t y_index = 0;
+
+        for(unsigned int n = 0; n < batch; ++n)
         {
-            for(unsigned int h = 0; h < YH; ++h)
+            for(unsigned int d = 0; d < D; ++d)
             {
-                for(unsigned int w = 0; w < YW; ++w)
+                const std::size_t channel_offset = ((std::size_t)n * D + d) * XH * XW;
+
+                for(unsigned int h = 0; h < YH; ++h)
                 {
-                    unsigned int window_top = kernel_stride * h;
-                    unsigned int window_bottom = window_top + kernel_size;
-                    unsigned int window_left = kernel_stride * w;
-                    unsigned int window_right = window_left + kernel_size;
+                    for(unsigned int w = 0; w < YW; ++w, ++y_index)
+                    {
+                        unsigned int window_top = kernel_stride * h;
+                        unsigned int window_bottom = window_top + kernel_size;
+                        unsigned int window_left = kernel_stride * w;
+                        unsigned int window_right = window_left + kernel_size;
 
-                    Y[d][h][w] = X(d, window_top, window_left);
-                    GHIndex[d][h][w] = window_top;
-                    GWIndex[d][h][w] = window_left;
+                        std::size_t best = channel_offset + window_top * XW + window_left;
 
-                    for(unsigned int kh = window_top; kh < window_bottom; ++kh)
-                    {
-                        for(unsigned int kw = window_left; kw < window_right; ++kw)
+                        for(unsigned int kh = window_top; kh < window_bottom; ++kh)
                         {
-                            if (Y(d, h, w) < X(d, kh, kw))
+                            for(unsigned int kw = window_left; kw < window_right; ++kw)
                             {
-                                Y[d][h][w] = X(d, kh, kw);
-                                GHIndex[d][h][w] = kh;
-                                GWIndex[d][h][w] = kw;
+                                std::size_t index = channel_offset + kh * XW + kw;
+
+                                if (x[best] < x[index])
+                                    best = index;
                             }
                         }
+
+                        y[y_index] = x[best];
+                        max_index[y_index] = best;
                     }
                 }
             }
@@ -104,21 +103,22 @@ public:
         return Y;
     }
 
-    Tensor Backward(Tensor& GFNL) // GNFL - gradient from next layer
+    Tensor<T> Backward(const Tensor<T>& GFNL) // GNFL - gradient from next layer
     {
-        Tensor GFCL = Tensor(D, XH, XW);
-
-        for(unsigned int d = 0; d < D; ++d)
+        if (GFNL.size() != max_index.size())
         {
-            for(unsigned int h = 0; h < YH; ++h)
-            {
-                for(unsigned int w = 0; w < YW; ++w)
-                {
-                    GFCL[d][GHIndex[d][h][w]][GWIndex[d][h][w]] = GFNL(d, h, w);
-                }
-            }
+            std::cout << "Input tensor is wrong size (Max pool layer)!" << std::endl;
+            throw;
         }
 
+        Tensor<T> GFCL = Tensor<T>(GFNL.get_batch(), D, XH, XW, 0);
+
+        const T* g = GFNL.data();
+        T* gfcl = GFCL.data();
+
+        for(std::size_t i = 0; i < max_index.size(); ++i)
+            gfcl[max_index[i]] += g[i];
+
         return GFCL;
     }
 
@@ -0,0 +1,230 @@
+#ifndef POINTWISE_CONVOLUTIONAL_LAYER
+#define POINTWISE_CONVOLUTIONAL_LAYER
+
+#include <vector>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+#include "../Tensor.cpp"
+#include "../Kernels/Gemm.cpp"
+#include "../Kernels/Vector.cpp"
+#include "../Kernels/ThreadPool.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Поточечная свёртка 1x1: смешивает каналы в каждой позиции, размер
+    карты не меняется. Пример батча D x H x W уже лежит как матрица
+    D x H*W, поэтому без какой-либо развёртки:
+
+        Y  [F x H*W]  = W [F x D] * X [D x H*W] + b
+        dW [F x D]   += G * X^T
+        dX [D x H*W]  = W^T * G
+
+    Части работы для пула потоков - полосы по parallel_columns позиций
+    одного примера (Y и dX) и блоки примеров со своим буфером dW, как в
+    обратном проходе im2col у ConvolutionalLayer
+*/
+template <typename T>
+class PointwiseConvolutionalLayer
+{
+    unsigned int input_depth;
+    unsigned int input_height;
+    unsigned int input_width;
+
+    unsigned int filter_count;
+
+    std::vector<T> weight_gradient;
+
+    static constexpr unsigned int parallel_columns = 256;
+    static constexpr unsigned int gradient_slots = 8;
+
+public:
+
+    T learning_rate;
+
+    // F x D
+    Tensor<T> W;
+    std::vector<T> B;
+
+    PointwiseConvolutionalLayer(){}
+
+    void Initialize
+    (
+        unsigned int input_depth,
+        unsigned int input_height,
+        unsigned int input_width,
+        unsigned int filter_count = 1,
+        T learning_rate = 1.0e-4,
+        T mean = 0,
+        T sigma = 0
+    )
+    {
+        this->input_depth = input_depth;
+        this->input_height = input_height;
+        this->input_width = input_width;
+
+        this->filter_count = filter_count;
+
+        this->learning_rate = learning_rate;
+
+        // Шага и окна у свёртки 1x1 нет, размер выхода равен размеру входа
+        if (input_depth == 0 || input_height == 0 || input_width == 0 || filter_count == 0)
+        {
+            std::cout << "Input size and filter count must be positive (Pointwise convolutional layer)!" << std::endl;
+            throw;
+        }
+
+        W = Tensor<T>(1, filter_count, input_depth);
+        B.assign(filter_count, 0);
+
+        DefineWeights(mean, sigma);
+    }
+
+
+    void DefineWeights(T mean, T sigma = 0)
+    {
+        if (sigma == 0)
+        {
+            std::fill(W.data(), W.data() + W.size(), mean);
+            std::fill(B.begin(), B.end(), mean);
+        }
+        else
+        {
+            // Создание генератора шума, распределенного нормально
+            std::random_device rd{};
+            std::mt19937 gen{rd()};
+            std::normal_distribution d = std::normal_distribution(mean, sigma);
+            auto random_double = [&d, &gen]{ return d(gen); };
+
+            for(std::size_t i = 0; i < W.size(); ++i)
+                W.data()[i] = random_double();
+
+            for(unsigned int f = 0; f < filter_count; ++f)
+                B[f] = random_double();
+        }
+    }
+
+
+    Tensor<T> Forward(const Tensor<T>& X) const
+    {
+        if (X.get_depth() != input_depth || X.get_height() != input_height || X.get_width() != input_width)
+        {
+            std::cout << "Input tensor is wrong size (Pointwise convolutional layer)!" << std::endl;
+            throw;
+        }
+
+        const unsigned int batch = X.get_batch();
+        const unsigned int columns = input_height * input_width;
+
+        Tensor<T> Y = Tensor<T>(batch, filter_count, input_height, input_width, 0);
+
+        const unsigned int column_tiles = (columns + parallel_columns - 1) / parallel_columns;
+
+        ThreadPool::Shared().ParallelFor((std::size_t)batch * column_tiles, [&](std::size_t item)
+        {
+            const unsigned int n = item / column_tiles;
+            const unsigned int c0 = (item % column_tiles) * parallel_columns;
+            const unsigned int width = std::min(parallel_columns, columns - c0);
+
+            T* y = Y.sample(n) + c0;
+
+            for(unsigned int f = 0; f < filter_count; ++f)
+                std::fill(y + (std::size_t)f * columns, y + (std::size_t)f * columns + width, B[f]);
+
+            Gemm<T>(
+                false, false, filter_count, width, input_depth,
+                1, W.data(), input_depth,
+                X.sample(n) + c0, columns,
+                1, y, columns
+            );
+        });
+
+        return Y;
+    }
+
+
+    /*
+        Градиент по входу считается по весам до обновления
+    */
+    Tensor<T> Backward(const Tensor<T>& X, const Tensor<T>& GFNL)
+    {
+        if (GFNL.get_depth() != filter_count || GFNL.get_height() != input_height || GFNL.get_width() != input_width || GFNL.get_batch() != X.get_batch())
+        {
+            std::cout << "Gradient from next layer is wrong dimension (Pointwise convolutional layer)!" << std::endl;
+            throw;
+        }
+
+        const unsigned int batch = X.get_batch();
+        const unsigned int columns = input_height * input_width;
+
+        Tensor<T> GFCL = Tensor<T>(batch, input_depth, input_height, input_width, 0);
+
+        const unsigned int column_tiles = (columns + parallel_columns - 1) / parallel_columns;
+
+        ThreadPool& pool = ThreadPool::Shared();
+
+        pool.ParallelFor((std::size_t)batch * column_tiles, [&](std::size_t item)
+        {
+            const unsigned int n = item / column_tiles;
+            const unsigned int c0 = (item % column_tiles) * parallel_columns;
+            const unsigned int width = std::min(parallel_columns, columns - c0);
+
+            Gemm<T>(
+                true, false, input_depth, width, filter_count,
+                1, W.data(), input_depth,
+                GFNL.sample(n) + c0, columns,
+                0, GFCL.sample(n) + c0, columns
+            );
+        });
+
+        // Блок 0 копит градиент весов прямо в weight_gradient, буферы складываются по порядку
+        const unsigned int slots = std::min(batch, gradient_slots);
+        const std::size_t weights = W.size();
+
+        weight_gradient.assign(slots * weights, 0);
+
+        pool.ParallelFor(slots, [&](std::size_t slot)
+        {
+            T* delta_w = weight_gradient.data() + slot * weights;
+
+            for(unsigned int n = slot * batch / slots; n < (slot + 1) * batch / slots; ++n)
+                Gemm<T>(
+                    false, true, filter_count, input_depth, columns,
+                    1, GFNL.sample(n), columns,
+                    X.sample(n), columns,
+                    1, delta_w, input_depth
+                );
+        });
+
+        for(unsigned int slot = 1; slot < slots; ++slot)
+            VectorAxpy((T)1, weight_gradient.data() + slot * weights, weight_gradient.data(), weights);
+
+        // Обновление весов и смещений
+
+        VectorAxpy(-learning_rate, weight_gradient.data(), W.data(), weights);
+
+        for(unsigned int f = 0; f < filter_count; ++f)
+        {
+            T db = 0;
+
+            for(unsigned int n = 0; n < batch; ++n)
+            {
+                const T* g = GFNL.sample(n) + (std::size_t)f * columns;
+
+                for(unsigned int c = 0; c < columns; ++c)
+                    db += g[c];
+            }
+
+            B[f] -= db * learning_rate;
+        }
+
+        return GFCL;
+    }
+
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
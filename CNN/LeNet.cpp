@@ -12,58 +12,50 @@
 #include "Layers/AvgPoolLayer.cpp"
 #include "Layers/ConvolutionalLayer.cpp"
 #include "Layers/ActivationLayer.cpp"
+#include "Layers/ConvPoolActivationLayer.cpp"
 #include "Layers/FullyConnectedLayer.cpp"
 #include "Layers/SoftmaxLayer.cpp"
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+template <typename T>
 class LeNet
 {
-    ConvolutionalLayer convl_0;
-    MaxPoolLayer mpl_0;
-    ActivationLayer convactl_0;
-
-    ConvolutionalLayer convl_1;
-    MaxPoolLayer mpl_1;
-    ActivationLayer convactl_1;
+    ConvPoolActivationLayer<T> cpal_0;
+    ConvPoolActivationLayer<T> cpal_1;
 
     // -- 
 
-    FullyConnectedLayer fcl_0;
-    ActivationLayer actl_0;
+    FullyConnectedLayer<T> fcl_0;
+    ActivationLayer<T> actl_0;
 
-    FullyConnectedLayer fcl_1;
-    ActivationLayer actl_1;
+    FullyConnectedLayer<T> fcl_1;
+    ActivationLayer<T> actl_1;
 
-    FullyConnectedLayer fcl_2;
-    SoftmaxLayer sml;
+    FullyConnectedLayer<T> fcl_2;
+    SoftmaxLayer<T> sml;
 
     // - - - -
 
-    Tensor CL_0_X;
-    Tensor MPL_0_X;
-    Tensor CONVACTL_0_X;
-    
-    Tensor CL_1_X;
-    Tensor MPL_1_X;
-    Tensor CONVACTL_1_X;
+    Tensor<T> CPAL_0_X;
+    Tensor<T> CPAL_1_X;
 
-    Tensor FCL_0_X;
-    Tensor ACTL_0_X;
+    Tensor<T> FCL_0_X;
+    Tensor<T> ACTL_0_X;
 
-    Tensor FCL_1_X;
-    Tensor ACTL_1_X;
+    Tensor<T> FCL_1_X;
+    Tensor<T> ACTL_1_X;
 
-    Tensor FCL_2_X;
-    Tensor SML_X;
+    Tensor<T> FCL_2_X;
+    Tensor<T> SML_X;
 
     bool initialized = false;
 
 public:
 
-    LeNet(double learning_rate = 1.0E-4, double mean = 0, double sigma = 0)
+    LeNet(T learning_rate = 1.0E-4, T mean = 0, T sigma = 0)
     {
-        convl_0.Initialize(
+        cpal_0.Initialize(
             3,                  // input channels
             32,                 // image height
             32,                 // image width
@@ -71,23 +63,16 @@ public:
             6,                  // amount of filters
             0,                  // padding
             1,                  // stride
+            2,                  // pool size
+            2,                  // pool stride
+            ActivationLayer<T>::ActivationType::Tanh,
             learning_rate,      // learning rate
             mean,               // mean
-            sigma           // sigma
-        );
-        
-        mpl_0.Initialize(
-            6,                  // input channels
-            28,                 // image height
-            28,                 // image width
-            2,                  // pool size
-            2                   // stride
+            sigma               // sigma
         );
 
-        convactl_0.SetActivationType(ActivationLayer::ActivationType::Tanh);
 
-
-        convl_1.Initialize(
+        cpal_1.Initialize(
             6,                  // input channels
             14,                 // image height
             14,                 // image width
@@ -95,20 +80,13 @@ public:
             16,                 // amount of filters
             0,                  // padding
             1,                  // stride
+            2,                  // pool size
+            2,                  // pool stride
+            ActivationLayer<T>::ActivationType::Tanh,
             learning_rate,      // learning rate
             mean,               // mean
             sigma               // sigma
         );
-        
-        mpl_1.Initialize(
-            16,                 // input channels
-            10,                 // image height
-            10,                 // image width
-            2,                  // pool size
-            2                   // stride
-        );
-
-        convactl_1.SetActivationType(ActivationLayer::ActivationType::Tanh);
 
         // -- 
 
@@ -120,7 +98,7 @@ public:
             sigma
         );
         
-        actl_0.SetActivationType(ActivationLayer::ActivationType::Tanh);
+        actl_0.SetActivationType(ActivationLayer<T>::ActivationType::Tanh);
 
 
         fcl_1.Initialize(
@@ -130,7 +108,7 @@ public:
             mean,
             sigma
         );
-        actl_1.SetActivationType(ActivationLayer::ActivationType::Tanh);
+        actl_1.SetActivationType(ActivationLayer<T>::ActivationType::Tanh);
 
         
         fcl_2.Initialize(
@@ -147,7 +125,7 @@ public:
     }
 
 
-    unsigned int get_height_index_of_maximum_in_tensor(const Tensor& X)
+    unsigned int get_height_index_of_maximum_in_tensor(const Tensor<T>& X)
     {
         unsigned int index = 0;
 
@@ -161,23 +139,18 @@ public:
     }
 
 
-    unsigned int Predict(Tensor& X)
+    unsigned int Predict(const Tensor<T>& X)
     {
         return get_height_index_of_maximum_in_tensor(Forward(X));
     }
 
 
-    Tensor Forward(Tensor& X)
+    Tensor<T> Forward(const Tensor<T>& X)
     {
-        CL_0_X = X;
-        
-        MPL_0_X = convl_0.Forward(CL_0_X);
-        CONVACTL_0_X = mpl_0.Forward(MPL_0_X);
-        CL_1_X = convactl_0.Forward(CONVACTL_0_X);
+        CPAL_0_X = X;
 
-        MPL_1_X = convl_1.Forward(CL_1_X);
-        CONVACTL_1_X = mpl_1.Forward(MPL_1_X);
-        FCL_0_X = convactl_1.Forward(CONVACTL_1_X);
+        CPAL_1_X = cpal_0.Forward(CPAL_0_X);
+        FCL_0_X = cpal_1.Forward(CPAL_1_X);
 
         FCL_0_X.reshape(1, 400, 1);
 
@@ -188,39 +161,31 @@ public:
         FCL_2_X = actl_1.Forward(ACTL_1_X);
 
         SML_X = fcl_2.Forward(FCL_2_X);
-        Tensor Y = sml.Forward(SML_X);
+        Tensor<T> Y = sml.Forward(SML_X);
 
         return Y;
     }
 
 
-    void Backward(const Tensor& dL)
+    void Backward(const Tensor<T>& dL)
     {
-        Tensor sml_grad = sml.Backward(SML_X, dL);
-        Tensor fcl_2_grad = fcl_2.Backward(FCL_2_X, sml_grad);
+        Tensor<T> sml_grad = sml.Backward(SML_X, dL);
+        Tensor<T> fcl_2_grad = fcl_2.Backward(FCL_2_X, sml_grad);
         
-        Tensor actl_1_grad = actl_1.Backward(ACTL_1_X, fcl_2_grad);
-        Tensor fcl_1_grad = fcl_1.Backward(FCL_1_X, actl_1_grad);
+        Tensor<T> actl_1_grad = actl_1.Backward(ACTL_1_X, fcl_2_grad);
+        Tensor<T> fcl_1_grad = fcl_1.Backward(FCL_1_X, actl_1_grad);
 
-        Tensor actl_0_grad = actl_0.Backward(ACTL_0_X, fcl_1_grad);
-        Tensor fcl_0_grad = fcl_0.Backward(FCL_0_X, actl_0_grad);
+        Tensor<T> actl_0_grad = actl_0.Backward(ACTL_0_X, fcl_1_grad);
+        Tensor<T> fcl_0_grad = fcl_0.Backward(FCL_0_X, actl_0_grad);
 
         fcl_0_grad.reshape(16, 5, 5);
 
-        Tensor convactl_1_grad = convactl_1.Backward(CONVACTL_1_X, fcl_0_grad);
-        Tensor mpl_1_grad = mpl_1.Backward(convactl_1_grad);
-        Tensor convl_1_grad = convl_1.Backward(CL_1_X, mpl_1_grad);
-
-        Tensor convactl_0_grad = convactl_0.Backward(CONVACTL_0_X, convl_1_grad);
-        Tensor mpl_0_grad = mpl_0.Backward(convactl_0_grad);
-        Tensor convl_0_grad = convl_0.Backward(CL_0_X, mpl_0_grad);
-
-// #include <iostream>
-// std::cout << std::endl << "mpl_0_grad" << std::endl << mpl_0_grad << std::endl;
+        Tensor<T> cpal_1_grad = cpal_1.Backward(CPAL_1_X, fcl_0_grad);
+        Tensor<T> cpal_0_grad = cpal_0.Backward(CPAL_0_X, cpal_1_grad);
     }
 
 
-    double Accuracy(vector<Tensor> X, vector<unsigned int> Y, unsigned int check_sample_size = 0)
+    double Accuracy(const vector<Tensor<T>>& X, const vector<unsigned int>& Y, unsigned int check_sample_size = 0)
     {
         if (X.size() != Y.size())
         {
@@ -255,7 +220,7 @@ public:
     }
 
 
-    Tensor LossGradient(unsigned int Y, Tensor prediction)
+    Tensor<T> LossGradient(unsigned int Y, const Tensor<T>& prediction)
     {
         if (prediction.get_width() != 1 || prediction.get_depth() != 1)
         {
@@ -263,7 +228,7 @@ public:
             throw;
         }
 
-        Tensor grad = Tensor(1, prediction.get_height(), 1);
+        Tensor<T> grad = Tensor<T>(1, prediction.get_height(), 1);
 
         for(unsigned int i = 0; i < prediction.get_height(); ++i)
         {
@@ -281,7 +246,27 @@ public:
     }
 
 
-    double Loss(vector<Tensor> X, vector<unsigned int> Y, unsigned int check_sample_size = 0)
+    /*
+        Градиент для батча: отдельная метка на каждый пример
+    */
+    Tensor<T> LossGradient(const vector<unsigned int>& Y, const Tensor<T>& prediction)
+    {
+        if (prediction.get_width() != 1 || prediction.get_depth() != 1 || prediction.get_batch() != Y.size())
+        {
+            cout << "Input data must be vertical vectors!"  << endl;
+            throw;
+        }
+
+        Tensor<T> grad = prediction;
+
+        for(unsigned int n = 0; n < Y.size(); ++n)
+            grad(n, 0, Y[n], 0) -= 1;
+
+        return grad;
+    }
+
+
+    double Loss(const vector<Tensor<T>>& X, const vector<unsigned int>& Y, unsigned int check_sample_size = 0)
     {
         if (X.size() != Y.size())
         {
@@ -319,7 +304,7 @@ public:
     /*
         Бинарная кросс энтропия
     */
-    double Loss(unsigned int Y, Tensor prediction)
+    double Loss(unsigned int Y, const Tensor<T>& prediction)
     {
         if (prediction.get_width() != 1 || prediction.get_depth() != 1)
         {
@@ -339,6 +324,83 @@ public:
     }
 
 
+    /*
+        Прореживание полносвязных слоёв после обучения: доля sparsity
+        весов каждого слоя обнуляется блоками, Forward дальше идёт только
+        по оставшимся (FullyConnectedLayer::Prune). После
+        ReadModel или дообучения вызывается заново
+    */
+    void Prune(T sparsity)
+    {
+        fcl_0.Prune(sparsity);
+        fcl_1.Prune(sparsity);
+        fcl_2.Prune(sparsity);
+    }
+
+    // Размер весов свёрток и полносвязных слоёв в памяти, байт
+    std::size_t WeightBytes() const
+    {
+        return cpal_0.conv.WeightBytes() + cpal_1.conv.WeightBytes() + fcl_0.WeightBytes() + fcl_1.WeightBytes() + fcl_2.WeightBytes();
+    }
+
+
+    /*
+        Квантование в int8 после обучения: калибровочные примеры проходят
+        через сеть в вещественных числах, и слои собирают диапазоны своих
+        входов. Затем веса свёрток и полносвязных слоёв переводятся в
+        int8 (Quantize слоёв), и Forward дальше считает их в целых числах.
+        После обучения с учётом квантования к калибровке добавляются
+        диапазоны, собранные за обучение. Dequantize возвращает сеть к
+        вещественным весам
+    */
+    void Quantize(const vector<Tensor<T>>& calibration)
+    {
+        Dequantize();
+
+        for(const Tensor<T>& X : calibration)
+        {
+            Forward(X);
+
+            cpal_0.conv.Observe(CPAL_0_X);
+            cpal_1.conv.Observe(CPAL_1_X);
+            fcl_0.Observe(FCL_0_X);
+            fcl_1.Observe(FCL_1_X);
+            fcl_2.Observe(FCL_2_X);
+        }
+
+        cpal_0.conv.Quantize();
+        cpal_1.conv.Quantize();
+        fcl_0.Quantize();
+        fcl_1.Quantize();
+        fcl_2.Quantize();
+    }
+
+    void Dequantize()
+    {
+        cpal_0.conv.Dequantize();
+        cpal_1.conv.Dequantize();
+        fcl_0.Dequantize();
+        fcl_1.Dequantize();
+        fcl_2.Dequantize();
+    }
+
+    /*
+        Обучение с учётом квантования: свёртки и полносвязные слои
+        округляют веса и входы так же, как int8 (SetQuantizationAware
+        слоёв), и сеть учится под ошибку квантования. SaveModel сохраняет
+        настоящие веса (сетка плюс остаток), ReadModel снова кладёт их на
+        сетку, если обучение с учётом квантования включено
+    */
+    void SetQuantizationAware(bool enable)
+    {
+        cpal_0.conv.SetQuantizationAware(enable);
+        cpal_1.conv.SetQuantizationAware(enable);
+        fcl_0.SetQuantizationAware(enable);
+        fcl_1.SetQuantizationAware(enable);
+        fcl_2.SetQuantizationAware(enable);
+    }
+
+
     bool SaveModel(std::string name)
     {
         if (!initialized)
@@ -357,31 +419,23 @@ public:
         file.open (path);
 
         // Saving zero conv layer
-        for(unsigned int f = 0; f < convl_0.filters.size(); ++f)
-            for(unsigned int d = 0; d < convl_0.filters[0].get_depth(); ++d)
-                for(unsigned int h = 0; h < convl_0.filters[0].get_height(); ++h)
-                    for(unsigned int w = 0; w < convl_0.filters[0].get_width(); ++w)
-                        file << convl_0.filters[f][d][h][w] << ' ';
+        for(std::size_t i = 0; i < cpal_0.conv.filters.size(); ++i)
+            file << cpal_0.conv.Weight(i) << ' ';
         
-        for(unsigned int f = 0; f < convl_0.B.size(); ++f)
-            file << convl_0.B[f] << ' ';
+        for(unsigned int f = 0; f < cpal_0.conv.B.size(); ++f)
+            file << cpal_0.conv.B[f] << ' ';
 
         // Saving one conv layer
-        for(unsigned int f = 0; f < convl_1.filters.size(); ++f)
-            for(unsigned int d = 0; d < convl_1.filters[0].get_depth(); ++d)
-                for(unsigned int h = 0; h < convl_1.filters[0].get_height(); ++h)
-                    for(unsigned int w = 0; w < convl_1.filters[0].get_width(); ++w)
-                        file << convl_1.filters[f][d][h][w] << ' ';
+        for(std::size_t i = 0; i < cpal_1.conv.filters.size(); ++i)
+            file << cpal_1.conv.Weight(i) << ' ';
         
-        for(unsigned int f = 0; f < convl_1.B.size(); ++f)
-            file << convl_1.B[f] << ' ';
+        for(unsigned int f = 0; f < cpal_1.conv.B.size(); ++f)
+            file << cpal_1.conv.B[f] << ' ';
         
 
         // Saving zero fully conn layer
-        for(unsigned int d = 0; d < fcl_0.W.get_depth(); ++d)
-            for(unsigned int h = 0; h < fcl_0.W.get_height(); ++h)
-                for(unsigned int w = 0; w < fcl_0.W.get_width(); ++w)
-                    file << fcl_0.W[d][h][w] << ' ';
+        for(std::size_t i = 0; i < fcl_0.W.size(); ++i)
+            file << fcl_0.Weight(i) << ' ';
         
         for(unsigned int d = 0; d < fcl_0.B.get_depth(); ++d)
             for(unsigned int h = 0; h < fcl_0.B.get_height(); ++h)
@@ -389,10 +443,8 @@ public:
                     file << fcl_0.B[d][h][w] << ' ';
         
         // Saving one fully conn layer
-        for(unsigned int d = 0; d < fcl_1.W.get_depth(); ++d)
-            for(unsigned int h = 0; h < fcl_1.W.get_height(); ++h)
-                for(unsigned int w = 0; w < fcl_1.W.get_width(); ++w)
-                    file << fcl_1.W[d][h][w] << ' ';
+        for(std::size_t i = 0; i < fcl_1.W.size(); ++i)
+            file << fcl_1.Weight(i) << ' ';
         
         for(unsigned int d = 0; d < fcl_1.B.get_depth(); ++d)
             for(unsigned int h = 0; h < fcl_1.B.get_height(); ++h)
@@ -400,10 +452,8 @@ public:
                     file << fcl_1.B[d][h][w] << ' ';
         
         // Saving two fully conn layer
-        for(unsigned int d = 0; d < fcl_2.W.get_depth(); ++d)
-            for(unsigned int h = 0; h < fcl_2.W.get_height(); ++h)
-                for(unsigned int w = 0; w < fcl_2.W.get_width(); ++w)
-                    file << fcl_2.W[d][h][w] << ' ';
+        for(std::size_t i = 0; i < fcl_2.W.size(); ++i)
+            file << fcl_2.Weight(i) << ' ';
         
         for(unsigned int d = 0; d < fcl_2.B.get_depth(); ++d)
             for(unsigned int h = 0; h < fcl_2.B.get_height(); ++h)
@@ -432,24 +482,21 @@ public:
             return false;
 
         // Saving zero conv layer
-        for(unsigned int f = 0; f < convl_0.filters.size(); ++f)
-            for(unsigned int d = 0; d < convl_0.filters[0].get_depth(); ++d)
-                for(unsigned int h = 0; h < convl_0.filters[0].get_height(); ++h)
-                    for(unsigned int w = 0; w < convl_0.filters[0].get_width(); ++w)
-                        file >> convl_0.filters[f][d][h][w];
+        for(std::size_t i = 0; i < cpal_0.conv.filters.size(); ++i)
+            file >> cpal_0.conv.filters.data()[i];
         
-        for(unsigned int f = 0; f < convl_0.B.size(); ++f)
-            file >> convl_0.B[f];
+        for(unsigned int f = 0; f < cpal_0.conv.B.size(); ++f)
+            file >> cpal_0.conv.B[f];
 
         // Saving one conv layer
-        for(unsigned int f = 0; f < convl_1.filters.size(); ++f)
-            for(unsigned int d = 0; d < convl_1.filters[0].get_depth(); ++d)
-                for(unsigned int h = 0; h < convl_1.filters[0].get_height(); ++h)
-                    for(unsigned int w = 0; w < convl_1.filters[0].get_width(); ++w)
-                        file >> convl_1.filters[f][d][h][w];
+        for(std::size_t i = 0; i < cpal_1.conv.filters.size(); ++i)
+            file >> cpal_1.conv.filters.data()[i];
         
-        for(unsigned int f = 0; f < convl_1.B.size(); ++f)
-            file >> convl_1.B[f];
+        for(unsigned int f = 0; f < cpal_1.conv.B.size(); ++f)
+            file >> cpal_1.conv.B[f];
+
+        cpal_0.conv.InvalidateWeightCache();
+        cpal_1.conv.InvalidateWeightCache();
         
 
         // Saving zero fully conn layer
@@ -484,6 +531,10 @@ public:
             for(unsigned int h = 0; h < fcl_2.B.get_height(); ++h)
                 for(unsigned int w = 0; w < fcl_2.B.get_width(); ++w)
                     file >> fcl_2.B[d][h][w];
+
+        fcl_0.InvalidateWeightCache();
+        fcl_1.InvalidateWeightCache();
+        fcl_2.InvalidateWeightCache();
         
         return true;
     }
@@ -0,0 +1,592 @@
+#ifndef LENET_MNIST_SEPARABLE
+#define LENET_MNIST_SEPARABLE
+
+#include <random>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+#include "Tensor.cpp"
+#include "Layers/MaxPoolLayer.cpp"
+#include "Layers/AvgPoolLayer.cpp"
+#include "Layers/ConvolutionalLayer.cpp"
+#include "Layers/ActivationLayer.cpp"
+#include "Layers/ConvPoolActivationLayer.cpp"
+#include "Layers/DepthwiseConvolutionalLayer.cpp"
+#include "Layers/PointwiseConvolutionalLayer.cpp"
+#include "Layers/FullyConnectedLayer.cpp"
+#include "Layers/SoftmaxLayer.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    LeNetMnist, в которой вторая свёртка 6 -> 16 с фильтром 5x5 разделена,
+    как в MobileNet: поканальная свёртка 5x5 (DepthwiseConvolutionalLayer)
+    и поточечная 1x1 (PointwiseConvolutionalLayer), затем max pooling и
+    активация. Умножений на позицию выхода 6*25 + 6*16 = 246 вместо
+    6*25*16 = 2400, весов второго блока 246 вместо 2400
+
+    В int8 (Quantize) и с учётом квантования (SetQuantizationAware)
+    считаются первая свёртка и полносвязные слои, разделённый блок
+    остаётся вещественным
+
+    Всё, кроме второго блока (полносвязные слои, Accuracy, Loss,
+    Prune, Quantize, SaveModel/ReadModel), скопировано из LeNetMnist,
+    как LeNetMnist из LeNet: изменения там нужно повторять и здесь
+*/
+template <typename T>
+class LeNetMnistSeparable
+{
+    ConvPoolActivationLayer<T> cpal_0;
+
+    DepthwiseConvolutionalLayer<T> dwcl;
+    PointwiseConvolutionalLayer<T> pwcl;
+    MaxPoolLayer<T> mpl;
+    ActivationLayer<T> actl_c;
+
+    // -- 
+
+    FullyConnectedLayer<T> fcl_0;
+    ActivationLayer<T> actl_0;
+
+    FullyConnectedLayer<T> fcl_1;
+    ActivationLayer<T> actl_1;
+
+    FullyConnectedLayer<T> fcl_2;
+    SoftmaxLayer<T> sml;
+
+    // - - - -
+
+    Tensor<T> CPAL_0_X;
+
+    Tensor<T> DWCL_X;
+    Tensor<T> PWCL_X;
+    Tensor<T> MPL_X;
+    Tensor<T> ACTL_C_X;
+
+    Tensor<T> FCL_0_X;
+    Tensor<T> ACTL_0_X;
+
+    Tensor<T> FCL_1_X;
+    Tensor<T> ACTL_1_X;
+
+    Tensor<T> FCL_2_X;
+    Tensor<T> SML_X;
+
+    bool initialized = false;
+
+public:
+
+    LeNetMnistSeparable(T learning_rate = 1.0E-4, T mean = 0, T sigma = 0)
+    {
+        cpal_0.Initialize(
+            1,                  // input channels
+            28,                 // image height
+            28,                 // image width
+            5,                  // filter kernel size
+            6,                  // amount of filters
+            0,                  // padding
+            1,                  // stride
+            2,                  // pool size
+            2,                  // pool stride
+            ActivationLayer<T>::ActivationType::Tanh,
+            learning_rate,      // learning rate
+            mean,               // mean
+            sigma               // sigma
+        );
+
+
+        dwcl.Initialize(
+            6,                  // input channels
+            12,                 // image height
+            12,                 // image width
+            5,                  // filter kernel size
+            0,                  // padding
+            1,                  // stride
+            learning_rate,      // learning rate
+            mean,               // mean
+            sigma               // sigma
+        );
+
+        pwcl.Initialize(
+            6,                  // input channels
+            8,                  // image height
+            8,                  // image width
+            16,                 // amount of filters
+            learning_rate,      // learning rate
+            mean,               // mean
+            sigma               // sigma
+        );
+
+        mpl.Initialize(16, 8, 8, 2, 2);
+        actl_c.SetActivationType(ActivationLayer<T>::ActivationType::Tanh);
+
+        // -- 
+
+        fcl_0.Initialize(
+            256,
+            120,
+            learning_rate,
+            mean,
+            sigma
+        );
+        
+        actl_0.SetActivationType(ActivationLayer<T>::ActivationType::Tanh);
+
+
+        fcl_1.Initialize(
+            120,
+            84,
+            learning_rate,
+            mean,
+            sigma
+        );
+        actl_1.SetActivationType(ActivationLayer<T>::ActivationType::Tanh);
+
+        
+        fcl_2.Initialize(
+            84,
+            10,
+            learning_rate,
+            mean,
+            sigma
+        );
+
+        // And Softmaxlayer (sml)
+
+        initialized = true;
+    }
+
+
+    unsigned int get_height_index_of_maximum_in_tensor(const Tensor<T>& X)
+    {
+        unsigned int index = 0;
+
+        for(unsigned int j = 0; j < X.get_height(); ++j)
+        {
+            if (X(0, index, 0) < X(0, j, 0))
+                index = j;
+        }
+
+        return index;
+    }
+
+
+    unsigned int Predict(const Tensor<T>& X)
+    {
+        return get_height_index_of_maximum_in_tensor(Forward(X));
+    }
+
+
+    Tensor<T> Forward(const Tensor<T>& X)
+    {
+        CPAL_0_X = X;
+
+        DWCL_X = cpal_0.Forward(CPAL_0_X);
+        PWCL_X = dwcl.Forward(DWCL_X);
+        MPL_X = pwcl.Forward(PWCL_X);
+        ACTL_C_X = mpl.Forward(MPL_X);
+        FCL_0_X = actl_c.Forward(ACTL_C_X);
+
+        FCL_0_X.reshape(1, 256, 1);
+
+        ACTL_0_X = fcl_0.Forward(FCL_0_X);
+        FCL_1_X = actl_0.Forward(ACTL_0_X);
+
+        ACTL_1_X = fcl_1.Forward(FCL_1_X);
+        FCL_2_X = actl_1.Forward(ACTL_1_X);
+
+        SML_X = fcl_2.Forward(FCL_2_X);
+        Tensor<T> Y = sml.Forward(SML_X);
+
+        return Y;
+    }
+
+
+    void Backward(const Tensor<T>& dL)
+    {
+        Tensor<T> sml_grad = sml.Backward(SML_X, dL);
+        Tensor<T> fcl_2_grad = fcl_2.Backward(FCL_2_X, sml_grad);
+        
+        Tensor<T> actl_1_grad = actl_1.Backward(ACTL_1_X, fcl_2_grad);
+        Tensor<T> fcl_1_grad = fcl_1.Backward(FCL_1_X, actl_1_grad);
+
+        Tensor<T> actl_0_grad = actl_0.Backward(ACTL_0_X, fcl_1_grad);
+        Tensor<T> fcl_0_grad = fcl_0.Backward(FCL_0_X, actl_0_grad);
+
+        fcl_0_grad.reshape(16, 4, 4);
+
+        Tensor<T> actl_c_grad = actl_c.Backward(ACTL_C_X, fcl_0_grad);
+        Tensor<T> mpl_grad = mpl.Backward(actl_c_grad);
+        Tensor<T> pwcl_grad = pwcl.Backward(PWCL_X, mpl_grad);
+        Tensor<T> dwcl_grad = dwcl.Backward(DWCL_X, pwcl_grad);
+        Tensor<T> cpal_0_grad = cpal_0.Backward(CPAL_0_X, dwcl_grad);
+    }
+
+
+    double Accuracy(const vector<Tensor<T>>& X, const vector<unsigned int>& Y, unsigned int check_sample_size = 0)
+    {
+        if (X.size() != Y.size())
+        {
+            cout << "Input data must have the same size!" << endl;
+            throw;
+        }
+
+        unsigned int correct_count = 0;
+
+        if (check_sample_size > 0)
+        {
+            for(unsigned int i = 0; i < check_sample_size; ++i)
+            {
+                unsigned int idx = rand() % X.size();
+
+                if (Y[idx] == Predict(X[idx]))
+                    ++correct_count;
+            }
+
+            return ((double)correct_count) / ((double)check_sample_size) * 100;
+        }
+        else
+        {
+            for(unsigned int i = 0; i < X.size(); ++i)
+            {
+                if (Y[i] == Predict(X[i]))
+                    ++correct_count;    
+            }
+
+            return ((double)correct_count) / ((double)X.size()) * 100;
+        }
+    }
+
+
+    Tensor<T> LossGradient(unsigned int Y, const Tensor<T>& prediction)
+    {
+        if (prediction.get_width() != 1 || prediction.get_depth() != 1)
+        {
+            cout << "Input data must be vertical vectors!"  << endl;
+            throw;
+        }
+
+        Tensor<T> grad = Tensor<T>(1, prediction.get_height(), 1);
+
+        for(unsigned int i = 0; i < prediction.get_height(); ++i)
+        {
+            if (i == Y)
+            {
+                grad[0][i][0] = prediction(0, i, 0) - 1;
+            }
+            else
+            {
+                grad[0][i][0] = prediction(0, i, 0);
+            }
+        }
+
+        return grad;
+    }
+
+
+    /*
+        Градиент для батча: отдельная метка на каждый пример
+    */
+    Tensor<T> LossGradient(const vector<unsigned int>& Y, const Tensor<T>& prediction)
+    {
+        if (prediction.get_width() != 1 || prediction.get_depth() != 1 || prediction.get_batch() != Y.size())
+        {
+            cout << "Input data must be vertical vectors!"  << endl;
+            throw;
+        }
+
+        Tensor<T> grad = prediction;
+
+        for(unsigned int n = 0; n < Y.size(); ++n)
+            grad(n, 0, Y[n], 0) -= 1;
+
+        return grad;
+    }
+
+
+    double Loss(const vector<Tensor<T>>& X, const vector<unsigned int>& Y, unsigned int check_sample_size = 0)
+    {
+        if (X.size() != Y.size())
+        {
+            cout << "Input data must have the same size!"  << endl;
+            throw;
+        }
+
+        double L = 0;
+
+        if (check_sample_size > 0)
+        {
+            for(unsigned int i = 0; i < check_sample_size; ++i)
+            {
+                unsigned int idx = rand() % X.size();
+                L += Loss(Y[idx], Forward(X[idx]));
+            }
+            
+            L /= check_sample_size;
+        }
+        else
+        {
+            for(unsigned int i = 0; i < X.size(); ++i)
+            {
+                L += Loss(Y[i], Forward(X[i]));
+            }
+                
+            L /= X.size();
+        }
+        
+        
+        return L;
+    }
+
+
+    /*
+        Бинарная кросс энтропия
+    */
+    double Loss(unsigned int Y, const Tensor<T>& prediction)
+    {
+        if (prediction.get_width() != 1 || prediction.get_depth() != 1)
+        {
+            cout << "Input data must be vertical vectors!"  << endl;
+            throw;
+        }
+
+        double L = -log(prediction(0, Y, 0));
+
+        for(unsigned int i = 0; i < prediction.get_height(); ++i)
+        {
+            if (i != Y)
+                L -= log(1 - prediction(0, i, 0));
+        }
+        
+        return L;
+    }
+
+
+    /*
+        Прореживание полносвязных слоёв после обучения: доля sparsity
+        весов каждого слоя обнуляется блоками, Forward дальше идёт только
+        по оставшимся (FullyConnectedLayer::Prune). После
+        ReadModel или дообучения вызывается заново
+    */
+    void Prune(T sparsity)
+    {
+        fcl_0.Prune(sparsity);
+        fcl_1.Prune(sparsity);
+        fcl_2.Prune(sparsity);
+    }
+
+    // Размер весов свёрток и полносвязных слоёв в памяти, байт
+    std::size_t WeightBytes() const
+    {
+        return cpal_0.conv.WeightBytes() + (dwcl.filters.size() + pwcl.W.size()) * sizeof(T) + fcl_0.WeightBytes() + fcl_1.WeightBytes() + fcl_2.WeightBytes();
+    }
+
+
+    /*
+        Квантование в int8 после обучения: калибровочные примеры проходят
+        через сеть в вещественных числах, и слои собирают диапазоны своих
+        входов. Затем веса свёрток и полносвязных слоёв переводятся в
+        int8 (Quantize слоёв), и Forward дальше считает их в целых числах.
+        После обучения с учётом квантования к калибровке добавляются
+        диапазоны, собранные за обучение. Dequantize возвращает сеть к
+        вещественным весам
+    */
+    void Quantize(const vector<Tensor<T>>& calibration)
+    {
+        Dequantize();
+
+        for(const Tensor<T>& X : calibration)
+        {
+            Forward(X);
+
+            cpal_0.conv.Observe(CPAL_0_X);
+            fcl_0.Observe(FCL_0_X);
+            fcl_1.Observe(FCL_1_X);
+            fcl_2.Observe(FCL_2_X);
+        }
+
+        cpal_0.conv.Quantize();
+        fcl_0.Quantize();
+        fcl_1.Quantize();
+        fcl_2.Quantize();
+    }
+
+    void Dequantize()
+    {
+        cpal_0.conv.Dequantize();
+        fcl_0.Dequantize();
+        fcl_1.Dequantize();
+        fcl_2.Dequantize();
+    }
+
+    /*
+        Обучение с учётом квантования: свёртки и полносвязные слои
+        округляют веса и входы так же, как int8 (SetQuantizationAware
+        слоёв), и сеть учится под ошибку квантования. SaveModel сохраняет
+        настоящие веса (сетка плюс остаток), ReadModel снова кладёт их на
+        сетку, если обучение с учётом квантования включено
+    */
+    void SetQuantizationAware(bool enable)
+    {
+        cpal_0.conv.SetQuantizationAware(enable);
+        fcl_0.SetQuantizationAware(enable);
+        fcl_1.SetQuantizationAware(enable);
+        fcl_2.SetQuantizationAware(enable);
+    }
+
+
+    bool SaveModel(std::string name)
+    {
+        if (!initialized)
+            return false;
+
+        std::string dir = "Models";
+
+        if (!std::filesystem::exists(dir)) {
+            if (!std::filesystem::create_directories(dir))
+                return false;
+        }
+
+        std::string path = dir + "/" + name + ".mdl";
+
+        std::ofstream file;
+        file.open (path);
+
+        // Saving zero conv layer
+        for(std::size_t i = 0; i < cpal_0.conv.filters.size(); ++i)
+            file << cpal_0.conv.Weight(i) << ' ';
+        
+        for(unsigned int f = 0; f < cpal_0.conv.B.size(); ++f)
+            file << cpal_0.conv.B[f] << ' ';
+
+        // Saving depthwise and pointwise conv layers
+        for(std::size_t i = 0; i < dwcl.filters.size(); ++i)
+            file << dwcl.filters.data()[i] << ' ';
+        
+        for(unsigned int c = 0; c < dwcl.B.size(); ++c)
+            file << dwcl.B[c] << ' ';
+
+        for(std::size_t i = 0; i < pwcl.W.size(); ++i)
+            file << pwcl.W.data()[i] << ' ';
+        
+        for(unsigned int f = 0; f < pwcl.B.size(); ++f)
+            file << pwcl.B[f] << ' ';
+        
+
+        // Saving zero fully conn layer
+        for(std::size_t i = 0; i < fcl_0.W.size(); ++i)
+            file << fcl_0.Weight(i) << ' ';
+        
+        for(unsigned int d = 0; d < fcl_0.B.get_depth(); ++d)
+            for(unsigned int h = 0; h < fcl_0.B.get_height(); ++h)
+                for(unsigned int w = 0; w < fcl_0.B.get_width(); ++w)
+                    file << fcl_0.B[d][h][w] << ' ';
+        
+        // Saving one fully conn layer
+        for(std::size_t i = 0; i < fcl_1.W.size(); ++i)
+            file << fcl_1.Weight(i) << ' ';
+        
+        for(unsigned int d = 0; d < fcl_1.B.get_depth(); ++d)
+            for(unsigned int h = 0; h < fcl_1.B.get_height(); ++h)
+                for(unsigned int w = 0; w < fcl_1.B.get_width(); ++w)
+                    file << fcl_1.B[d][h][w] << ' ';
+        
+        // Saving two fully conn layer
+        for(std::size_t i = 0; i < fcl_2.W.size(); ++i)
+            file << fcl_2.Weight(i) << ' ';
+        
+        for(unsigned int d = 0; d < fcl_2.B.get_depth(); ++d)
+            for(unsigned int h = 0; h < fcl_2.B.get_height(); ++h)
+                for(unsigned int w = 0; w < fcl_2.B.get_width(); ++w)
+                    file << fcl_2.B[d][h][w] << ' ';
+        
+        return true;
+    }
+
+    bool ReadModel(std::string name)
+    {
+        if (!initialized)
+            return false;
+
+        std::string dir = "Models";
+
+        if (!std::filesystem::exists(dir)) 
+            return false;
+
+        std::string path = dir + "/" + name + ".mdl";
+
+        std::ifstream file;
+        file.open(path);
+
+        if (!file.is_open())
+            return false;
+
+        // Saving zero conv layer
+        for(std::size_t i = 0; i < cpal_0.conv.filters.size(); ++i)
+            file >> cpal_0.conv.filters.data()[i];
+        
+        for(unsigned int f = 0; f < cpal_0.conv.B.size(); ++f)
+            file >> cpal_0.conv.B[f];
+
+        // Saving depthwise and pointwise conv layers
+        for(std::size_t i = 0; i < dwcl.filters.size(); ++i)
+            file >> dwcl.filters.data()[i];
+        
+        for(unsigned int c = 0; c < dwcl.B.size(); ++c)
+            file >> dwcl.B[c];
+
+        for(std::size_t i = 0; i < pwcl.W.size(); ++i)
+            file >> pwcl.W.data()[i];
+        
+        for(unsigned int f = 0; f < pwcl.B.size(); ++f)
+            file >> pwcl.B[f];
+
+        cpal_0.conv.InvalidateWeightCache();
+        
+
+        // Saving zero fully conn layer
+        for(unsigned int d = 0; d < fcl_0.W.get_depth(); ++d)
+            for(unsigned int h = 0; h < fcl_0.W.get_height(); ++h)
+                for(unsigned int w = 0; w < fcl_0.W.get_width(); ++w)
+                    file >> fcl_0.W[d][h][w];
+        
+        for(unsigned int d = 0; d < fcl_0.B.get_depth(); ++d)
+            for(unsigned int h = 0; h < fcl_0.B.get_height(); ++h)
+                for(unsigned int w = 0; w < fcl_0.B.get_width(); ++w)
+                    file >> fcl_0.B[d][h][w];
+        
+        // Saving one fully conn layer
+        for(unsigned int d = 0; d < fcl_1.W.get_depth(); ++d)
+            for(unsigned int h = 0; h < fcl_1.W.get_height(); ++h)
+                for(unsigned int w = 0; w < fcl_1.W.get_width(); ++w)
+                    file >> fcl_1.W[d][h][w];
+        
+        for(unsigned int d = 0; d < fcl_1.B.get_depth(); ++d)
+            for(unsigned int h = 0; h < fcl_1.B.get_height(); ++h)
+                for(unsigned int w = 0; w < fcl_1.B.get_width(); ++w)
+                    file >> fcl_1.B[d][h][w];
+        
+        // Saving two fully conn layer
+        for(unsigned int d = 0; d < fcl_2.W.get_depth(); ++d)
+            for(unsigned int h = 0; h < fcl_2.W.get_height(); ++h)
+                for(unsigned int w = 0; w < fcl_2.W.get_width(); ++w)
+                    file >> fcl_2.W[d][h][w];
+        
+        for(unsigned int d = 0; d < fcl_2.B.get_depth(); ++d)
+            for(unsigned int h = 0; h < fcl_2.B.get_height(); ++h)
+                for(unsigned int w = 0; w < fcl_2.B.get_width(); ++w)
+                    file >> fcl_2.B[d][h][w];
+
+        fcl_0.InvalidateWeightCache();
+        fcl_1.InvalidateWeightCache();
+        fcl_2.InvalidateWeightCache();
+        
+        return true;
+    }
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
\ No newline at end of file
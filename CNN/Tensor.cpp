@@ -1,198 +1,243 @@
 #ifndef TENSOR
 #define TENSOR
 
+#include <new>
+#include <cstddef>
 #include <iostream>
 
+#include "Kernels/Vector.cpp"
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+/*
+    Тензор шаблонный по типу скаляра: float для быстрого обучения,
+    double как эталонный режим для сравнения точности.
+
+    Тензор четырёхмерный: N x D x H x W, где N - количество примеров
+    в мини-батче. Обычный трёхмерный тензор - это батч из одного примера,
+    поэтому все слои принимают и одиночные примеры, и целые батчи.
+
+    Все элементы тензора лежат в одном выровненном буфере в порядке n, d, h, w.
+    Положение элемента: n * stride_n + d * stride_d + h * stride_h + w
+
+    Поэтому создание тензора - это одно выделение памяти, а ядра слоёв
+    могут проходить по данным линейно через data()
+*/
+template <typename T = double>
 class Tensor
 {
 
 private:
 
-    double*** data = nullptr;
+    static constexpr std::size_t ALIGNMENT = 64;
+
+    T* buffer = nullptr;
+    unsigned int N = 0;
     unsigned int D = 0;
     unsigned int W = 0;
     unsigned int H = 0;
 
+    std::size_t stride_n = 0;
+    unsigned int stride_d = 0;
+    unsigned int stride_h = 0;
+
+    static T* allocate(std::size_t count)
+    {
+        return static_cast<T*>(::operator new[](count * sizeof(T), std::align_val_t(ALIGNMENT)));
+    }
+
+    static void release(T* ptr)
+    {
+        if (ptr != nullptr)
+            ::operator delete[](ptr, std::align_val_t(ALIGNMENT));
+    }
+
+    void set_shape(unsigned int N, unsigned int D, unsigned int H, unsigned int W)
+    {
+        this->N = N;
+        this->D = D;
+        this->H = H;
+        this->W = W;
+
+        stride_h = W;
+        stride_d = H * W;
+        stride_n = (std::size_t)D * H * W;
+    }
+
 public:
 
+    /*
+        Срез тензора по глубине, нужен только для того, чтобы
+        продолжала работать запись X[d][h][w]
+    */
+    class Slice
+    {
+        T* ptr;
+        unsigned int stride_h;
+
+    public:
+
+        Slice(T* ptr, unsigned int stride_h) : ptr(ptr), stride_h(stride_h) {}
+
+        T* operator[](unsigned int h) const
+        {
+            return ptr + h * stride_h;
+        }
+    };
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
     Tensor()
     {
-        data = nullptr;
-        D = 0;
-        W = 0;
-        H = 0;
+        buffer = nullptr;
+        set_shape(0, 0, 0, 0);
     }
 
-    Tensor(const Tensor& other){
+    Tensor(const Tensor& other)
+    {
+        set_shape(other.N, other.D, other.H, other.W);
 
-        if (D > 0 && H > 0 && W > 0)
-        {
-            for(unsigned int d = 0; d < D; ++d)
-            {
-                for(unsigned int h = 0; h < H; ++h)
-                {
-                    delete [] data[d][h];
-                }
-                delete [] data[d];
-            }
-            delete [] data;
-        }
-        
-        D = other.D;
-        H = other.H;
-        W = other.W;
-        
-        data = new double**[D];
-        for(unsigned int d = 0; d < D; ++d)
-        {
-            data[d] = new double*[H];
-            for(unsigned int h = 0; h < H; ++h)
-            {
-                data[d][h] = new double[W];
+        if (other.buffer == nullptr)
+            return;
 
-                for(unsigned int w = 0; w < W; ++w)
-                    data[d][h][w] = other.data[d][h][w];
-            }
-        }
+        buffer = allocate(size());
+
+        for(std::size_t i = 0; i < size(); ++i)
+            buffer[i] = other.buffer[i];
     }
 
-    Tensor(unsigned int D, unsigned int H, unsigned int W, double fill_val = 0)
+    Tensor(Tensor&& other) noexcept
     {
-        if (D <= 0 || H <= 0 || W <= 0)
+        buffer = other.buffer;
+        set_shape(other.N, other.D, other.H, other.W);
+
+        other.buffer = nullptr;
+        other.set_shape(0, 0, 0, 0);
+    }
+
+    Tensor(unsigned int D, unsigned int H, unsigned int W, T fill_val = 0) : Tensor(1, D, H, W, fill_val) {}
+
+    /*
+        Батч из N примеров. Значение заполнения здесь обязательное,
+        чтобы вызов не путался с конструктором D x H x W
+    */
+    Tensor(unsigned int N, unsigned int D, unsigned int H, unsigned int W, T fill_val)
+    {
+        if (N <= 0 || D <= 0 || H <= 0 || W <= 0)
         {
-            std::cout << "Height, width and depth of matrix must be greater then 0! " << D << 'x' << H << 'x' << W << std::endl;
+            std::cout << "Batch size, height, width and depth of matrix must be greater then 0! " << N << 'x' << D << 'x' << H << 'x' << W << std::endl;
             throw;
         }
 
-        this->D = D;
-        this->H = H;
-        this->W = W;
+        set_shape(N, D, H, W);
 
-        data = new double**[D];
-        for(unsigned int d = 0; d < D; ++d)
-        {
-            data[d] = new double*[H];
-            for(unsigned int h = 0; h < H; ++h)
-            {
-                data[d][h] = new double[W];
+        buffer = allocate(size());
 
-                for(unsigned int w = 0; w < W; ++w)
-                    data[d][h][w] = fill_val;
-            }
-        }
+        fill(fill_val);
     }
 
     ~Tensor()
     {
-        for(unsigned int d = 0; d < D; ++d)
-        {
-            for(unsigned int h = 0; h < H; ++h)
-            {
-                delete[] data[d][h];
-            }
-            delete[] data[d];
-        }
-        delete[] data;  
+        release(buffer);
+        buffer = nullptr;
 
-        D = 0;
-        H = 0;
-        W = 0; 
+        set_shape(0, 0, 0, 0);
     }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-    const double operator()(unsigned int d, unsigned int h, unsigned int w) const
+    const T operator()(unsigned int d, unsigned int h, unsigned int w) const
     {
-        return data[d][h][w];
+        return buffer[d * stride_d + h * stride_h + w];
     }
 
-    double** operator[](unsigned int d)
+    T& operator()(unsigned int d, unsigned int h, unsigned int w)
     {
-        return data[d];
+        return buffer[d * stride_d + h * stride_h + w];
     }
 
-    void operator/=(double val)
+    const T operator()(unsigned int n, unsigned int d, unsigned int h, unsigned int w) const
     {
-        for(unsigned int d = 0; d < D; ++d)
-        {
-            for(unsigned int h = 0; h < H; ++h)
-            {
-                for(unsigned int w = 0; w < W; ++w)
-                {
-                    data[d][h][w] /= val;
-                }
-            }
-        }
+        return buffer[n * stride_n + d * stride_d + h * stride_h + w];
     }
 
-    void operator*=(double val)
+    T& operator()(unsigned int n, unsigned int d, unsigned int h, unsigned int w)
     {
-        for(unsigned int d = 0; d < D; ++d)
-        {
-            for(unsigned int h = 0; h < H; ++h)
-            {
-                for(unsigned int w = 0; w < W; ++w)
-                {
-                    data[d][h][w] *= val;
-                }
-            }
-        }
+        return buffer[n * stride_n + d * stride_d + h * stride_h + w];
+    }
+
+    Slice operator[](unsigned int d)
+    {
+        return Slice(buffer + d * stride_d, stride_h);
+    }
+
+    void operator/=(T val)
+    {
+        VectorScale(buffer, (T)1 / val, size());
+    }
+
+    void operator*=(T val)
+    {
+        VectorScale(buffer, val, size());
     }
 
     Tensor& operator=(const Tensor& other)
     {
-        if (D > 0 && H > 0 && W > 0)
+        if (this == &other)
+            return *this;
+
+        // Если размер совпадает, то буфер можно не перевыделять
+        if (buffer == nullptr || size() != other.size())
         {
-            for(unsigned int d = 0; d < D; ++d)
-            {
-                for(unsigned int h = 0; h < H; ++h)
-                {
-                    delete [] data[d][h];
-                }
-                delete [] data[d];
-            }
-            delete [] data;
+            release(buffer);
+            buffer = other.buffer == nullptr ? nullptr : allocate(other.size());
         }
 
-        D = other.D;
-        H = other.H;
-        W = other.W;
-        
-        data = new double**[D];
-        for(unsigned int d = 0; d < D; ++d)
-        {
-            data[d] = new double*[H];
-            for(unsigned int h = 0; h < H; ++h)
-            {
-                data[d][h] = new double[W];
+        set_shape(other.N, other.D, other.H, other.W);
 
-                for(unsigned int w = 0; w < W; ++w)
-                    data[d][h][w] = other.data[d][h][w];
-            }
-        }
+        for(std::size_t i = 0; i < size(); ++i)
+            buffer[i] = other.buffer[i];
+
+        return *this;
+    }
+
+    Tensor& operator=(Tensor&& other) noexcept
+    {
+        if (this == &other)
+            return *this;
+
+        release(buffer);
+
+        buffer = other.buffer;
+        set_shape(other.N, other.D, other.H, other.W);
+
+        other.buffer = nullptr;
+        other.set_shape(0, 0, 0, 0);
 
         return *this;
     }
 
     friend std::ostream& operator<<(std::ostream& os,const Tensor& tensor) {
 
+        if (tensor.N > 1)
+            os << tensor.N << 'x';
+
         os << tensor.D << 'x' << tensor.H << 'x' <<  tensor.W << std::endl;
 
-        for (unsigned int d = 0; d < tensor.D; ++d) 
+        for (unsigned int n = 0; n < tensor.N; ++n)
         {
-            for (unsigned int h = 0; h < tensor.H; ++h) {
-                
-                for (unsigned int w = 0; w < tensor.W; ++w)
-                    os << tensor.data[d][h][w] << " ";
-                
+            for (unsigned int d = 0; d < tensor.D; ++d)
+            {
+                for (unsigned int h = 0; h < tensor.H; ++h) {
+
+                    for (unsigned int w = 0; w < tensor.W; ++w)
+                        os << tensor(n, d, h, w) << " ";
+
+                    os << std::endl;
+                }
+
                 os << std::endl;
             }
-
-            os << std::endl;
         }
 
         return os;
@@ -200,21 +245,71 @@ public:
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-    void fill(double val)
+    T* data()
+    {
+        return buffer;
+    }
+
+    const T* data() const
+    {
+        return buffer;
+    }
+
+    /*
+        Указатель на начало n-го примера батча
+    */
+    T* sample(unsigned int n)
+    {
+        return buffer + n * stride_n;
+    }
+
+    const T* sample(unsigned int n) const
     {
-        for(unsigned int d = 0; d < D; ++d)
+        return buffer + n * stride_n;
+    }
+
+    /*
+        Копирование одиночного примера на n-е место в батче
+    */
+    void set_sample(unsigned int n, const Tensor& X)
+    {
+        if (X.sample_size() != sample_size() || n >= N)
         {
-            for(unsigned int h = 0; h < H; ++h)
-            {
-                for(unsigned int w = 0; w < W; ++w)
-                    data[d][h][w] = val;
-            }
+            std::cout << "Sample does not fit the batch!" << std::endl;
+            throw;
         }
+
+        T* dst = sample(n);
+        const T* src = X.data();
+
+        for(std::size_t i = 0; i < stride_n; ++i)
+            dst[i] = src[i];
+    }
+
+    std::size_t size() const
+    {
+        return (std::size_t)N * stride_n;
+    }
+
+    std::size_t sample_size() const
+    {
+        return stride_n;
+    }
+
+    void fill(T val)
+    {
+        for(std::size_t i = 0; i < size(); ++i)
+            buffer[i] = val;
+    }
+
+    unsigned int get_batch() const
+    {
+        return N;
     }
 
     unsigned int get_depth() const
-    { 
-        return D; 
+    {
+        return D;
     }
 
     unsigned int get_height() const
@@ -227,54 +322,44 @@ public:
         return W;
     }
 
+    unsigned int get_depth_stride() const
+    {
+        return stride_d;
+    }
+
+    unsigned int get_height_stride() const
+    {
+        return stride_h;
+    }
+
+    /*
+        Данные лежат непрерывно, поэтому достаточно переписать форму и шаги.
+        Меняется форма каждого примера, размер батча остаётся прежним
+    */
     void reshape(unsigned int newD, unsigned int newH, unsigned int newW)
     {
-        if (newD * newH * newW != D * H * W)
+        if ((std::size_t)newD * newH * newW != sample_size())
         {
             std::cout << "Uncorrect shape for reshaping!" << std::endl;
             throw;
         }
 
-        double* arr = new double[D * H * W];
+        set_shape(N, newD, newH, newW);
+    }
 
-        for(unsigned int d = 0; d < D; ++d)
-            for(unsigned int h = 0; h < H; ++h)
-                for(unsigned int w = 0; w < W; ++w)
-                    arr[d * H * W + h * W + w] = data[d][h][w];
-        
-        for(unsigned int d = 0; d < D; ++d)
+    void reshape(unsigned int newN, unsigned int newD, unsigned int newH, unsigned int newW)
+    {
+        if ((std::size_t)newN * newD * newH * newW != size())
         {
-            for(unsigned int h = 0; h < H; ++h)
-            {
-                delete [] data[d][h];
-            }
-            delete [] data[d];
+            std::cout << "Uncorrect shape for reshaping!" << std::endl;
+            throw;
         }
 
-        delete [] data;
-
-        D = newD;
-        H = newH;
-        W = newW;
-
-        data = new double**[D];
-        for(unsigned int d = 0; d < D; ++d)
-        {
-            data[d] = new double*[H];
-            for(unsigned int h = 0; h < H; ++h)
-            {
-                data[d][h] = new double[W];
-            }
-        }
-        
-        for(unsigned int d = 0; d < D; ++d)
-            for(unsigned int h = 0; h < H; ++h)
-                for(unsigned int w = 0; w < W; ++w)
-                    data[d][h][w] = arr[d * H * W + h * W + w];
+        set_shape(newN, newD, newH, newW);
     }
 };
 
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-#endif
\ No newline at end of file
+#endif
@@ -4,14 +4,122 @@
 #include <string>
 #include <random>
 #include <algorithm>
+#include <chrono>
 
 #include "Tensor.cpp"
 #include "LeNet.cpp"
 #include "LeNetMnist.cpp"
+#include "LeNetMnistSeparable.cpp"
 
 using namespace std;
 
 
+/*
+    Один шаг обучения: count примеров начиная с first собираются
+    в батч и проходят через сеть одним тензором
+*/
+template <typename T, typename Model>
+void TrainStep(Model& net, const vector<Tensor<T>>& images, const vector<unsigned int>& labels, unsigned int first, unsigned int count)
+{
+    const Tensor<T>& first_image = images[first];
+
+    Tensor<T> X = Tensor<T>(count, first_image.get_depth(), first_image.get_height(), first_image.get_width(), 0);
+    vector<unsigned int> Y(count);
+
+    for(unsigned int k = 0; k < count; ++k)
+    {
+        X.set_sample(k, images[first + k]);
+        Y[k] = labels[first + k];
+    }
+
+    Tensor<T> prediction = net.Forward(X);
+    Tensor<T> gradient = net.LossGradient(Y, prediction);
+    net.Backward(gradient);
+}
+
+
+/*
+    Прореживание обученной сети: для каждой доли нулевых весов
+    полносвязных слоёв - точность на тестовых изображениях, время
+    предсказания одного изображения и размер весов сети. Прореживается
+    копия, сама сеть остаётся плотной
+*/
+template <typename T, typename Model>
+void PruningReport(const Model& net, const vector<Tensor<T>>& test_images, const vector<unsigned int>& test_labels)
+{
+    typedef chrono::steady_clock Clock;
+
+    const T levels[] = {0, 0.5, 0.7, 0.8, 0.9, 0.95};
+
+    cout << endl << "Sparsity\tAccuracy\tLatency(us)\tWeights(KB)" << endl;
+
+    for(T sparsity : levels)
+    {
+        Model pruned = net;
+
+        if (sparsity > 0)
+            pruned.Prune(sparsity);
+
+        double accur = pruned.Accuracy(test_images, test_labels);
+
+        auto start = Clock::now();
+
+        for(const Tensor<T>& image : test_images)
+            pruned.Predict(image);
+
+        double latency = chrono::duration<double, micro>(Clock::now() - start).count() / test_images.size();
+
+        cout << sparsity * 100 << "%\t\t" << accur << "%\t\t" << latency << "\t\t" << pruned.WeightBytes() / 1024.0 << endl;
+    }
+}
+
+
+/*
+    Квантование обученной сети в int8: калибровка на calibration_size
+    случайных тестовых изображениях, затем для вещественной и
+    квантованной сети - точность на всех тестовых изображениях, время
+    предсказания одного изображения и размер весов. Квантуется копия,
+    сама сеть остаётся вещественной
+*/
+template <typename T, typename Model>
+void QuantizationReport(Model& net, const vector<Tensor<T>>& test_images, const vector<unsigned int>& test_labels, unsigned int calibration_size = 256)
+{
+    typedef chrono::steady_clock Clock;
+
+    vector<Tensor<T>> calibration;
+
+    for(unsigned int i = 0; i < calibration_size; ++i)
+        calibration.push_back(test_images[rand() % test_images.size()]);
+
+    Model quantized = net;
+    quantized.Quantize(calibration);
+
+    cout << endl << "Weights\tAccuracy\tLatency(us)\tWeights(KB)" << endl;
+
+    double accuracy[2];
+
+    for(unsigned int k = 0; k < 2; ++k)
+    {
+        Model& model = k == 0 ? net : quantized;
+
+        auto start = Clock::now();
+
+        accuracy[k] = model.Accuracy(test_images, test_labels);
+
+        double latency = chrono::duration<double, micro>(Clock::now() - start).count() / test_images.size();
+
+        cout << (k == 0 ? (sizeof(T) == 8 ? "double" : "float") : "int8") << "\t" << accuracy[k] << "%\t\t" << latency << "\t\t" << model.WeightBytes() / 1024.0 << endl;
+    }
+
+    cout << "Accuracy delta (int8 - " << (sizeof(T) == 8 ? "double" : "float") << "): " << accuracy[1] - accuracy[0] << '%' << endl;
+}
+
+
+/*
+    Model - LeNetMnist или LeNetMnistSeparable (вторая свёртка разделена
+    на поканальную и поточечную)
+*/
+template <typename T, typename Model = LeNetMnist<T>>
 void TrainCNN_MNIST()
 {
     cout << endl << endl <<  "- - - - - - - - - - - - - - - - - - - - - " << endl << endl;
@@ -20,11 +128,13 @@ void TrainCNN_MNIST()
 
     srand(time(0));
 
-    double learning_rate = 0.001;
-    double mean = 0;
-    double sigma = 0.01;
+    T learning_rate = 0.001;
+    T mean = 0;
+    T sigma = 0.01;
     bool mini_batch_mode = true;
     bool show_start_accuracy = false;
+    bool quantization_aware = false;
+    unsigned int samples_per_step = 1;
     string load_model = "";
 
     cout << endl << "Learning rate: "; 
@@ -35,10 +145,14 @@ void TrainCNN_MNIST()
     cin >> sigma;
     cout << "Learning mode (minibatch - 1, entire sample - 0): "; 
     cin >> mini_batch_mode;
+    cout << "Samples per training step (1 - one sample): "; 
+    cin >> samples_per_step;
     cout << "Load model (n - no model): "; 
     cin >> load_model;
     cout << "Show start accuracy (1 - yes, 0 - no): "; 
     cin >> show_start_accuracy;
+    cout << "Quantization-aware training (1 - yes, 0 - no): "; 
+    cin >> quantization_aware;
     cout << endl;
 
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -49,10 +163,10 @@ void TrainCNN_MNIST()
 
     cout << "> Reading data... ";
 
-    vector<Tensor> train_images;
+    vector<Tensor<T>> train_images;
     vector<unsigned int> train_labels;
 
-    vector<Tensor> test_images;
+    vector<Tensor<T>> test_images;
     vector<unsigned int> test_labels;
 
     // Загрузка данных
@@ -97,18 +211,18 @@ void TrainCNN_MNIST()
             train_images.reserve(train_image_amount);
             for(int image_index = 0; image_index < train_image_amount; ++image_index)
             {
-                Tensor img = Tensor(1, 28, 28);
+                Tensor<T> img = Tensor<T>(1, 28, 28);
 
                 for(int row = 0; row < 28; ++row)
                 {
                     for(int col = 0; col < 28; ++col)
                     {
                         inputFileStream.read((char*)&cursor, sizeof(cursor));
-                        img[0][row][col] = (double)cursor/255.0;
+                        img[0][row][col] = (T)cursor/255.0;
                     }
                 }
 
-                train_images.push_back(img);
+                train_images.push_back(std::move(img));
             }
 
             inputFileStream.close();
@@ -149,18 +263,18 @@ void TrainCNN_MNIST()
             test_images.reserve(test_image_amount);
             for(int image_index = 0; image_index < test_image_amount; ++image_index)
             {
-                Tensor img = Tensor(1, 28, 28);
+                Tensor<T> img = Tensor<T>(1, 28, 28);
 
                 for(int row = 0; row < 28; ++row)
                 {
                     for(int col = 0; col < 28; ++col)
                     {
                         inputFileStream.read((char*)&cursor, sizeof(cursor));
-                        img[0][row][col] = (double)cursor/255.0;
+                        img[0][row][col] = (T)cursor/255.0;
                     }
                 }
 
-                test_images.push_back(img);
+                test_images.push_back(std::move(img));
             }
 
             inputFileStream.close();
@@ -171,7 +285,7 @@ void TrainCNN_MNIST()
 
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-    LeNetMnist net = LeNetMnist(learning_rate, mean, sigma);
+    Model net = Model(learning_rate, mean, sigma);
 
     // Загрузка уже предобученной модели
     if (load_model != "n")
@@ -180,6 +294,9 @@ void TrainCNN_MNIST()
         cout << (net.ReadModel(load_model) ? "model is loaded" : "failed to load model...") << endl;
     }
 
+    // Веса и входы слоёв округляются как в int8, сеть потом квантуется без потерь
+    net.SetQuantizationAware(quantization_aware);
+
     if (show_start_accuracy)
     {
         cout << "> Start accuracy: " << net.Accuracy(test_images, test_labels, 1000) << endl;
@@ -201,13 +318,13 @@ void TrainCNN_MNIST()
 
             unsigned int batch_idx = rand() % 6;
 
-            for(unsigned int j = 0; j < batch_size; ++j)
+            for(unsigned int j = 0; j < batch_size; j += samples_per_step)
             {
-                Tensor prediction = net.Forward(train_images[j + batch_size * batch_idx]);
-                Tensor gradient = net.LossGradient(train_labels[j + batch_size * batch_idx], prediction);
-                net.Backward(gradient);
+                unsigned int count = min(samples_per_step, batch_size - j);
 
-                if (j % (batch_size / 10) == 0)
+                TrainStep(net, train_images, train_labels, j + batch_size * batch_idx, count);
+
+                if ((j + count) * 10 / batch_size > j * 10 / batch_size)
                     cout << "-";
             }
 
@@ -236,11 +353,11 @@ void TrainCNN_MNIST()
 
             for(unsigned int i = 0; i < 6; ++i)
             {
-                for(unsigned int j = batch_sequence[i] * batch_size; j < (batch_sequence[i] + 1) * batch_size; ++j)
+                for(unsigned int j = batch_sequence[i] * batch_size; j < (batch_sequence[i] + 1) * batch_size; j += samples_per_step)
                 {
-                    Tensor prediction = net.Forward(train_images[j]);
-                    Tensor gradient = net.LossGradient(train_labels[j], prediction);
-                    net.Backward(gradient);
+                    unsigned int count = min(samples_per_step, (batch_sequence[i] + 1) * batch_size - j);
+
+                    TrainStep(net, train_images, train_labels, j, count);
                 }
                 cout << "--";
 
@@ -255,9 +372,12 @@ void TrainCNN_MNIST()
         }
     }
 
+    PruningReport(net, test_images, test_labels);
+    QuantizationReport(net, test_images, test_labels);
 }
 
 
+template <typename T>
 void TrainCNN_CIFAR10()
 {
     cout << endl << endl <<  "- - - - - - - - - - - - - - - - - - - - - " << endl << endl;
@@ -266,11 +386,13 @@ void TrainCNN_CIFAR10()
 
     srand(time(0));
 
-    double learning_rate = 0.001;
-    double mean = 0;
-    double sigma = 0.01;
+    T learning_rate = 0.001;
+    T mean = 0;
+    T sigma = 0.01;
     bool mini_batch_mode = true;
     bool show_start_accuracy = false;
+    bool quantization_aware = false;
+    unsigned int samples_per_step = 1;
     string load_model = "";
 
     cout << endl << "Learning rate: "; 
@@ -281,10 +403,14 @@ void TrainCNN_CIFAR10()
     cin >> sigma;
     cout << "Learning mode (minibatch - 1, entire sample - 0): "; 
     cin >> mini_batch_mode;
+    cout << "Samples per training step (1 - one sample): "; 
+    cin >> samples_per_step;
     cout << "Load model (n - no model): "; 
     cin >> load_model;
     cout << "Show start accuracy (1 - yes, 0 - no): "; 
     cin >> show_start_accuracy;
+    cout << "Quantization-aware training (1 - yes, 0 - no): "; 
+    cin >> quantization_aware;
     cout << endl;
 
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -296,11 +422,11 @@ void TrainCNN_CIFAR10()
     cout << "> Reading data... ";  
 
     // 50000
-    vector<Tensor> train_images;
+    vector<Tensor<T>> train_images;
     vector<unsigned int> train_labels;
 
     // 10000
-    vector<Tensor> test_images;
+    vector<Tensor<T>> test_images;
     vector<unsigned int> test_labels;
 
     // Чтение тренировочных картинок
@@ -321,7 +447,7 @@ void TrainCNN_CIFAR10()
 
             train_labels.push_back((int)cursor);
 
-            Tensor X = Tensor(3, 32, 32);
+            Tensor<T> X = Tensor<T>(3, 32, 32);
 
             for(unsigned int d = 0; d < 3; ++d)
             {
@@ -331,12 +457,12 @@ void TrainCNN_CIFAR10()
                     {
                         inputFileStream.read((char*)&cursor, sizeof(cursor) );
                         
-                        X[d][h][w] = (double)cursor / 255;
+                        X[d][h][w] = (T)cursor / 255;
                     }
                 }
             }
 
-            train_images.push_back(X);
+            train_images.push_back(std::move(X));
         }
 
         inputFileStream.close();
@@ -359,7 +485,7 @@ void TrainCNN_CIFAR10()
 
             test_labels.push_back((int)cursor);
 
-            Tensor X = Tensor(3, 32, 32);
+            Tensor<T> X = Tensor<T>(3, 32, 32);
 
             for(unsigned int d = 0; d < 3; ++d)
             {
@@ -369,12 +495,12 @@ void TrainCNN_CIFAR10()
                     {
                         inputFileStream.read((char*)&cursor, sizeof(cursor) );
                         
-                        X[d][h][w] = (double)cursor / 255;
+                        X[d][h][w] = (T)cursor / 255;
                     }
                 }
             }
 
-            test_images.push_back(X);
+            test_images.push_back(std::move(X));
         }
 
         inputFileStream.close();
@@ -384,7 +510,7 @@ void TrainCNN_CIFAR10()
 
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-    LeNet net = LeNet(learning_rate, mean, sigma);
+    LeNet<T> net = LeNet<T>(learning_rate, mean, sigma);
 
     // Загрузка уже предобученной модели
     if (load_model != "n")
@@ -393,6 +519,9 @@ void TrainCNN_CIFAR10()
         cout << (net.ReadModel(load_model) ? "model is loaded" : "failed to load model...") << endl;
     }
 
+    // Веса и входы слоёв округляются как в int8, сеть потом квантуется без потерь
+    net.SetQuantizationAware(quantization_aware);
+
     if (show_start_accuracy)
         cout << "> Start accuracy: " << net.Accuracy(test_images, test_labels, 1000) << endl;
     
@@ -410,13 +539,13 @@ void TrainCNN_CIFAR10()
 
             unsigned int batch_idx = rand() % 5;
 
-            for(unsigned int j = 0; j < batch_size; ++j)
+            for(unsigned int j = 0; j < batch_size; j += samples_per_step)
             {
-                Tensor prediction = net.Forward(train_images[j + batch_size * batch_idx]);
-                Tensor gradient = net.LossGradient(train_labels[j + batch_size * batch_idx], prediction);
-                net.Backward(gradient);
+                unsigned int count = min(samples_per_step, batch_size - j);
+
+                TrainStep(net, train_images, train_labels, j + batch_size * batch_idx, count);
 
-                if (j % (batch_size / 10) == 0)
+                if ((j + count) * 10 / batch_size > j * 10 / batch_size)
                     cout << "-";
             }
 
@@ -445,11 +574,11 @@ void TrainCNN_CIFAR10()
 
             for(unsigned int i = 0; i < 5; ++i)
             {
-                for(unsigned int j = batch_sequence[i] * batch_size; j < (batch_sequence[i] + 1) * batch_size; ++j)
+                for(unsigned int j = batch_sequence[i] * batch_size; j < (batch_sequence[i] + 1) * batch_size; j += samples_per_step)
                 {
-                    Tensor prediction = net.Forward(train_images[j]);
-                    Tensor gradient = net.LossGradient(train_labels[j], prediction);
-                    net.Backward(gradient);
+                    unsigned int count = min(samples_per_step, (batch_sequence[i] + 1) * batch_size - j);
+
+                    TrainStep(net, train_images, train_labels, j, count);
                 }
                 cout << "--";
             }
@@ -462,15 +591,40 @@ void TrainCNN_CIFAR10()
         }
     }
 
+    PruningReport(net, test_images, test_labels);
+    QuantizationReport(net, test_images, test_labels);
 }
 
 
 int main()
 {
+    // float - быстрое обучение, double - эталон для сравнения точности
+    unsigned int precision = 32;
+    bool separable = false;
 
-    // TrainCNN_CIFAR10();
+    cout << "Precision (32 - float, 64 - double): ";
+    cin >> precision;
+    cout << "Depthwise separable second convolution (1 - yes, 0 - no): ";
+    cin >> separable;
 
-    TrainCNN_MNIST();
+    if (precision == 64)
+    {
+        // TrainCNN_CIFAR10<double>();
+
+        if (separable)
+            TrainCNN_MNIST<double, LeNetMnistSeparable<double>>();
+        else
+            TrainCNN_MNIST<double>();
+    }
+    else
+    {
+        // TrainCNN_CIFAR10<float>();
+
+        if (separable)
+            TrainCNN_MNIST<float, LeNetMnistSeparable<float>>();
+        else
+            TrainCNN_MNIST<float>();
+    }
 
     return 0;
 }
\ No newline at end of file
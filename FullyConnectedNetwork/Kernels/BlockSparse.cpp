@@ -0,0 +1,263 @@
+#ifndef BLOCK_SPARSE
+#define BLOCK_SPARSE
+
+#include <cstddef>
+#include <vector>
+
+#include "CpuFeatures.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Блочно-разреженная матрица: строка делится на блоки по
+    SparseBlockBytes байт (линия кэша), хранятся только ненулевые блоки.
+    Это CSR, где элемент - не одно число, а блок: блоки строки i -
+    с row_start[i] по row_start[i + 1] - 1, в block_column - номер
+    первого столбца блока, в value - сами блоки подряд. Последний блок
+    строки короче, если число столбцов не делится на размер блока, и в
+    value дополнен нулями
+
+    Отдельные веса в CSR пришлось бы умножать на x[column[k]] по
+    одному или через gather, и это медленнее плотного умножения почти
+    при любой разреженности. Блок же - подряд идущие веса и кусок x,
+    то есть обычные загрузки целыми векторами, как в Gemv
+*/
+constexpr unsigned int SparseBlockBytes = 64;
+
+
+template <typename T>
+struct BlockSparseMatrix
+{
+    static constexpr unsigned int block = SparseBlockBytes / sizeof(T);
+
+    unsigned int rows = 0;
+    unsigned int columns = 0;
+
+    std::vector<unsigned int> row_start;
+    std::vector<unsigned int> block_column;
+    std::vector<T> value;
+
+    /*
+        Блоки плотной матрицы A[M x N] (строки с шагом lda), в которых
+        есть ненулевые элементы
+    */
+    void Build(unsigned int M, unsigned int N, const T* A, unsigned int lda)
+    {
+        rows = M;
+        columns = N;
+
+        row_start.assign(1, 0);
+        block_column.clear();
+        value.clear();
+
+        for(unsigned int i = 0; i < M; ++i)
+        {
+            const T* a = A + (std::size_t)i * lda;
+
+            for(unsigned int begin = 0; begin < N; begin += block)
+            {
+                const unsigned int end = begin + block < N ? begin + block : N;
+
+                bool nonzero = false;
+
+                for(unsigned int j = begin; j < end; ++j)
+                    nonzero |= a[j] != 0;
+
+                if (!nonzero)
+                    continue;
+
+                block_column.push_back(begin);
+
+                for(unsigned int j = begin; j < begin + block; ++j)
+                    value.push_back(j < end ? a[j] : 0);
+            }
+
+            row_start.push_back((unsigned int)block_column.size());
+        }
+    }
+
+    // Размер в памяти: блоки, номера их столбцов и начала строк
+    std::size_t Bytes() const
+    {
+        return value.size() * sizeof(T) + block_column.size() * sizeof(unsigned int) + row_start.size() * sizeof(unsigned int);
+    }
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    y[M] += A * x для блочно-разреженной A (SpMV)
+
+    Блоки строки идут парами в два независимых аккумулятора. Блок,
+    выходящий за конец x, - всегда последний в строке - считается
+    отдельно неполными векторами с маской
+*/
+template <typename T>
+void BlockSparseGemvScalar(unsigned int M, unsigned int N, const unsigned int* row_start, const unsigned int* block_column, const T* value, const T* x, T* y)
+{
+    constexpr unsigned int block = BlockSparseMatrix<T>::block;
+
+    for(unsigned int i = 0; i < M; ++i)
+    {
+        T S = 0;
+
+        for(unsigned int k = row_start[i]; k < row_start[i + 1]; ++k)
+        {
+            const unsigned int begin = block_column[k];
+            const unsigned int n = N - begin < block ? N - begin : block;
+
+            const T* a = value + (std::size_t)k * block;
+
+            for(unsigned int j = 0; j < n; ++j)
+                S += a[j] * x[begin + j];
+        }
+
+        y[i] += S;
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#if defined(CPU_X86)
+
+template <typename T>
+CPU_TARGET_AVX2 void BlockSparseGemvAvx2(unsigned int M, unsigned int N, const unsigned int* row_start, const unsigned int* block_column, const T* value, const T* x, T* y)
+{
+    typedef Avx2Vector<T> V;
+
+    constexpr unsigned int block = BlockSparseMatrix<T>::block;
+
+    for(unsigned int i = 0; i < M; ++i)
+    {
+        typename V::Vec s0 = V::Zero();
+        typename V::Vec s1 = V::Zero();
+
+        unsigned int k = row_start[i];
+        unsigned int end = row_start[i + 1];
+
+        const bool tail = k < end && block_column[end - 1] + block > N;
+
+        if (tail)
+            --end;
+
+        for(; k + 2 <= end; k += 2)
+        {
+            const T* a0 = value + (std::size_t)k * block;
+            const T* a1 = a0 + block;
+
+            const T* x0 = x + block_column[k];
+            const T* x1 = x + block_column[k + 1];
+
+            CPU_UNROLL
+            for(unsigned int j = 0; j < block; j += V::W)
+            {
+                s0 = V::Fmadd(V::Load(a0 + j), V::Load(x0 + j), s0);
+                s1 = V::Fmadd(V::Load(a1 + j), V::Load(x1 + j), s1);
+            }
+        }
+
+        if (k < end)
+        {
+            const T* a0 = value + (std::size_t)k * block;
+            const T* x0 = x + block_column[k];
+
+            CPU_UNROLL
+            for(unsigned int j = 0; j < block; j += V::W)
+                s0 = V::Fmadd(V::Load(a0 + j), V::Load(x0 + j), s0);
+        }
+
+        if (tail)
+        {
+            const T* a0 = value + (std::size_t)end * block;
+            const T* x0 = x + block_column[end];
+            const unsigned int n = N - block_column[end];
+
+            for(unsigned int j = 0; j < n; j += V::W)
+            {
+                const unsigned int m = n - j < V::W ? n - j : V::W;
+                s1 = V::Fmadd(V::LoadN(a0 + j, m), V::LoadN(x0 + j, m), s1);
+            }
+        }
+
+        y[i] += V::Sum(V::Add(s0, s1));
+    }
+}
+
+
+template <typename T>
+CPU_TARGET_AVX512 void BlockSparseGemvAvx512(unsigned int M, unsigned int N, const unsigned int* row_start, const unsigned int* block_column, const T* value, const T* x, T* y)
+{
+    typedef Avx512Vector<T> V;
+
+    constexpr unsigned int block = BlockSparseMatrix<T>::block;
+
+    for(unsigned int i = 0; i < M; ++i)
+    {
+        typename V::Vec s0 = V::Zero();
+        typename V::Vec s1 = V::Zero();
+
+        unsigned int k = row_start[i];
+        unsigned int end = row_start[i + 1];
+
+        const bool tail = k < end && block_column[end - 1] + block > N;
+
+        if (tail)
+            --end;
+
+        for(; k + 2 <= end; k += 2)
+        {
+            const T* a0 = value + (std::size_t)k * block;
+            const T* a1 = a0 + block;
+
+            const T* x0 = x + block_column[k];
+            const T* x1 = x + block_column[k + 1];
+
+            CPU_UNROLL
+            for(unsigned int j = 0; j < block; j += V::W)
+            {
+                s0 = V::Fmadd(V::Load(a0 + j), V::Load(x0 + j), s0);
+                s1 = V::Fmadd(V::Load(a1 + j), V::Load(x1 + j), s1);
+            }
+        }
+
+        if (k < end)
+        {
+            const T* a0 = value + (std::size_t)k * block;
+            const T* x0 = x + block_column[k];
+
+            CPU_UNROLL
+            for(unsigned int j = 0; j < block; j += V::W)
+                s0 = V::Fmadd(V::Load(a0 + j), V::Load(x0 + j), s0);
+        }
+
+        if (tail)
+        {
+            const T* a0 = value + (std::size_t)end * block;
+            const T* x0 = x + block_column[end];
+            const unsigned int n = N - block_column[end];
+
+            for(unsigned int j = 0; j < n; j += V::W)
+            {
+                const unsigned int m = n - j < V::W ? n - j : V::W;
+                s1 = V::Fmadd(V::LoadN(a0 + j, m), V::LoadN(x0 + j, m), s1);
+            }
+        }
+
+        y[i] += V::Sum(V::Add(s0, s1));
+    }
+}
+
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+template <typename T>
+void BlockSparseGemv(const BlockSparseMatrix<T>& A, const T* x, T* y)
+{
+    static const auto kernel = CPU_DISPATCH(&BlockSparseGemvScalar<T>, &BlockSparseGemvAvx2<T>, &BlockSparseGemvAvx512<T>);
+    kernel(A.rows, A.columns, A.row_start.data(), A.block_column.data(), A.value.data(), x, y);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
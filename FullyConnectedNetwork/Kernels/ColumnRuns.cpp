@@ -0,0 +1,236 @@
+#ifndef COLUMN_RUNS
+#define COLUMN_RUNS
+
+#include <cstddef>
+#include <vector>
+
+#include "CpuFeatures.cpp"
+#include "Gemv.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Разреженный вход полносвязного слоя
+
+    Ненулевые элементы входа обычно сосредоточены в одной части: у
+    изображения MNIST это строки с цифрой, а верх и низ рамки - нули.
+    Вход делится на куски по линии кэша (ColumnRunLine байт), и куски,
+    где есть ненулевые элементы, объединяются в отрезки столбцов
+    [begin, end). Ядра идут по отрезкам так же, как по обычной строке:
+    подряд, целыми векторами. По строкам весов идут те же отрезки,
+    остальные линии кэша не читаются и не меняются
+
+    Мельче линии кэша делить нет смысла: из памяти она читается
+    целиком, а короткие отрезки - это лишние маски и переходы
+*/
+constexpr unsigned int ColumnRunLine = 64;
+
+
+/*
+    Отрезки кусков, ненулевых хотя бы в одной из rows строк X (строка
+    r - X[r * ldx .. r * ldx + n - 1]), парами begin, end подряд в runs.
+    Возвращает число столбцов, покрытых отрезками
+*/
+template <typename T>
+unsigned int FindColumnRuns(const T* X, unsigned int rows, unsigned int ldx, unsigned int n, std::vector<unsigned int>& runs)
+{
+    constexpr unsigned int line = ColumnRunLine / sizeof(T);
+
+    runs.clear();
+
+    unsigned int covered = 0;
+
+    for(unsigned int begin = 0; begin < n; begin += line)
+    {
+        const unsigned int end = begin + line < n ? begin + line : n;
+
+        bool nonzero = false;
+
+        for(unsigned int r = 0; r < rows && !nonzero; ++r)
+        {
+            const T* x = X + (std::size_t)r * ldx;
+
+            for(unsigned int j = begin; j < end; ++j)
+                nonzero |= x[j] != 0;
+        }
+
+        if (!nonzero)
+            continue;
+
+        if (!runs.empty() && runs.back() == begin)
+            runs.back() = end;
+        else
+        {
+            runs.push_back(begin);
+            runs.push_back(end);
+        }
+
+        covered += end - begin;
+    }
+
+    return covered;
+}
+
+/*
+    Отрезки ненулевых кусков одного вектора x[0 .. n - 1]
+*/
+template <typename T>
+unsigned int FindColumnRuns(const T* x, unsigned int n, std::vector<unsigned int>& runs)
+{
+    return FindColumnRuns(x, 1, n, n, runs);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Изменение ранга 1 только по столбцам из отрезков:
+    A[i][j] += alpha * g[i] * x[j]. Блок из GemvRows строк, загруженный
+    кусок x идёт во все строки блока
+*/
+template <typename T>
+void Rank1UpdateRunsScalar(unsigned int M, T* A, unsigned int lda, T alpha, const T* g, const T* x, const unsigned int* runs, unsigned int run_count)
+{
+    for(unsigned int i = 0; i < M; ++i)
+    {
+        T* a = A + (std::size_t)i * lda;
+        const T u = alpha * g[i];
+
+        for(unsigned int r = 0; r < run_count; ++r)
+            for(unsigned int j = runs[2 * r]; j < runs[2 * r + 1]; ++j)
+                a[j] += u * x[j];
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#if defined(CPU_X86)
+
+template <unsigned int R, typename T>
+CPU_TARGET_AVX2 void Rank1UpdateRunsBlockAvx2(T* A, unsigned int lda, T alpha, const T* g, const T* x, const unsigned int* runs, unsigned int run_count)
+{
+    typedef Avx2Vector<T> V;
+
+    typename V::Vec u[R];
+
+    CPU_UNROLL
+    for(unsigned int i = 0; i < R; ++i)
+        u[i] = V::Set(alpha * g[i]);
+
+    for(unsigned int r = 0; r < run_count; ++r)
+    {
+        const unsigned int end = runs[2 * r + 1];
+
+        unsigned int j = runs[2 * r];
+
+        for(; j + V::W <= end; j += V::W)
+        {
+            const typename V::Vec xj = V::Load(x + j);
+
+            CPU_UNROLL
+            for(unsigned int i = 0; i < R; ++i)
+            {
+                T* a = A + (std::size_t)i * lda + j;
+                V::Store(a, V::Fmadd(u[i], xj, V::Load(a)));
+            }
+        }
+
+        if (j < end)
+        {
+            const unsigned int n = end - j;
+
+            const typename V::Vec xj = V::LoadN(x + j, n);
+
+            CPU_UNROLL
+            for(unsigned int i = 0; i < R; ++i)
+            {
+                T* a = A + (std::size_t)i * lda + j;
+                V::StoreN(a, V::Fmadd(u[i], xj, V::LoadN(a, n)), n);
+            }
+        }
+    }
+}
+
+template <typename T>
+CPU_TARGET_AVX2 void Rank1UpdateRunsAvx2(unsigned int M, T* A, unsigned int lda, T alpha, const T* g, const T* x, const unsigned int* runs, unsigned int run_count)
+{
+    unsigned int i = 0;
+
+    for(; i + GemvRows <= M; i += GemvRows)
+        Rank1UpdateRunsBlockAvx2<GemvRows>(A + (std::size_t)i * lda, lda, alpha, g + i, x, runs, run_count);
+
+    for(; i < M; ++i)
+        Rank1UpdateRunsBlockAvx2<1>(A + (std::size_t)i * lda, lda, alpha, g + i, x, runs, run_count);
+}
+
+
+template <unsigned int R, typename T>
+CPU_TARGET_AVX512 void Rank1UpdateRunsBlockAvx512(T* A, unsigned int lda, T alpha, const T* g, const T* x, const unsigned int* runs, unsigned int run_count)
+{
+    typedef Avx512Vector<T> V;
+
+    typename V::Vec u[R];
+
+    CPU_UNROLL
+    for(unsigned int i = 0; i < R; ++i)
+        u[i] = V::Set(alpha * g[i]);
+
+    for(unsigned int r = 0; r < run_count; ++r)
+    {
+        const unsigned int end = runs[2 * r + 1];
+
+        unsigned int j = runs[2 * r];
+
+        for(; j + V::W <= end; j += V::W)
+        {
+            const typename V::Vec xj = V::Load(x + j);
+
+            CPU_UNROLL
+            for(unsigned int i = 0; i < R; ++i)
+            {
+                T* a = A + (std::size_t)i * lda + j;
+                V::Store(a, V::Fmadd(u[i], xj, V::Load(a)));
+            }
+        }
+
+        if (j < end)
+        {
+            const unsigned int n = end - j;
+
+            const typename V::Vec xj = V::LoadN(x + j, n);
+
+            CPU_UNROLL
+            for(unsigned int i = 0; i < R; ++i)
+            {
+                T* a = A + (std::size_t)i * lda + j;
+                V::StoreN(a, V::Fmadd(u[i], xj, V::LoadN(a, n)), n);
+            }
+        }
+    }
+}
+
+template <typename T>
+CPU_TARGET_AVX512 void Rank1UpdateRunsAvx512(unsigned int M, T* A, unsigned int lda, T alpha, const T* g, const T* x, const unsigned int* runs, unsigned int run_count)
+{
+    unsigned int i = 0;
+
+    for(; i + GemvRows <= M; i += GemvRows)
+        Rank1UpdateRunsBlockAvx512<GemvRows>(A + (std::size_t)i * lda, lda, alpha, g + i, x, runs, run_count);
+
+    for(; i < M; ++i)
+        Rank1UpdateRunsBlockAvx512<1>(A + (std::size_t)i * lda, lda, alpha, g + i, x, runs, run_count);
+}
+
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+template <typename T>
+void Rank1UpdateRuns(unsigned int M, T* A, unsigned int lda, T alpha, const T* g, const T* x, const unsigned int* runs, unsigned int run_count)
+{
+    static const auto kernel = CPU_DISPATCH(&Rank1UpdateRunsScalar<T>, &Rank1UpdateRunsAvx2<T>, &Rank1UpdateRunsAvx512<T>);
+    kernel(M, A, lda, alpha, g, x, runs, run_count);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
@@ -0,0 +1,493 @@
+#ifndef CPU_FEATURES
+#define CPU_FEATURES
+
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CPU_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Выбор набора инструкций во время выполнения
+
+    Все SIMD-варианты ядер собираются в одном бинарнике: функции помечаются
+    атрибутом target, поэтому глобальные флаги компилятора (-mavx2 и т.п.)
+    не нужны. При первом обращении по cpuid определяется лучший набор
+    инструкций, который поддерживают процессор и ОС, и все ядра
+    вызываются через выбранные один раз указатели на функции
+
+    Переменная окружения ML_CPP_ISA (scalar, sse4.2, avx2, avx512)
+    принудительно ограничивает набор инструкций, например для сравнения
+    скорости вариантов на одной машине
+*/
+enum class CpuIsa { Scalar, SSE42, AVX2, AVX512 };
+
+#if defined(CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CPU_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define CPU_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#define CPU_TARGET_AVX512_VNNI __attribute__((target("avx512f,avx512bw,avx512vnni,avx2,fma")))
+#else
+#define CPU_TARGET_AVX2
+#define CPU_TARGET_AVX512
+#define CPU_TARGET_AVX512_VNNI
+#endif
+
+
+/*
+    Полная развёртка коротких циклов по регистрам микроядер: без неё
+    при -O2 массивы аккумуляторов уходят в память
+*/
+#if defined(__GNUC__) && !defined(__clang__)
+#define CPU_UNROLL _Pragma("GCC unroll 16")
+#elif defined(__clang__)
+#define CPU_UNROLL _Pragma("unroll")
+#else
+#define CPU_UNROLL
+#endif
+
+
+inline const char* CpuIsaName(CpuIsa isa)
+{
+    switch (isa)
+    {
+    case CpuIsa::AVX512:
+        return "avx512";
+    case CpuIsa::AVX2:
+        return "avx2";
+    case CpuIsa::SSE42:
+        return "sse4.2";
+    case CpuIsa::Scalar:
+    default:
+        return "scalar";
+    }
+}
+
+
+/*
+    Лучший набор инструкций, поддерживаемый процессором и ОС
+*/
+inline CpuIsa DetectCpuIsa()
+{
+#if defined(CPU_X86) && defined(_MSC_VER)
+
+    int info[4];
+
+    __cpuid(info, 0);
+    const int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    const bool sse42 = (info[2] >> 20) & 1;
+    const bool fma = (info[2] >> 12) & 1;
+    const bool osxsave = (info[2] >> 27) & 1;
+    const bool avx = (info[2] >> 28) & 1;
+
+    bool avx2 = false;
+    bool avx512 = false;
+
+    if (max_leaf >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] >> 5) & 1;
+        avx512 = (info[1] >> 16) & 1;
+    }
+
+    // ОС должна сохранять регистры ymm (и zmm для AVX-512)
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    const bool os_avx = (xcr0 & 0x6) == 0x6;
+    const bool os_avx512 = (xcr0 & 0xE6) == 0xE6;
+
+    if (avx512 && avx2 && fma && os_avx512)
+        return CpuIsa::AVX512;
+
+    if (avx && avx2 && fma && os_avx)
+        return CpuIsa::AVX2;
+
+    if (sse42)
+        return CpuIsa::SSE42;
+
+    return CpuIsa::Scalar;
+
+#elif defined(CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+
+    // __builtin_cpu_supports учитывает и поддержку регистров со стороны ОС
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return CpuIsa::AVX512;
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return CpuIsa::AVX2;
+
+    if (__builtin_cpu_supports("sse4.2"))
+        return CpuIsa::SSE42;
+
+    return CpuIsa::Scalar;
+
+#else
+
+    return CpuIsa::Scalar;
+
+#endif
+}
+
+
+/*
+    Название модели процессора из cpuid (для ключей кэша автонастройки)
+*/
+inline std::string CpuBrand()
+{
+#if defined(CPU_X86)
+
+    unsigned int regs[12] = {};
+
+#if defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 0x80000000);
+
+    if ((unsigned int)info[0] < 0x80000004)
+        return "unknown";
+
+    for(unsigned int i = 0; i < 3; ++i)
+    {
+        __cpuid(info, 0x80000002 + i);
+
+        for(unsigned int j = 0; j < 4; ++j)
+            regs[i * 4 + j] = (unsigned int)info[j];
+    }
+#else
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000004)
+        return "unknown";
+
+    for(unsigned int i = 0; i < 3; ++i)
+        __get_cpuid(0x80000002 + i, &regs[i * 4], &regs[i * 4 + 1], &regs[i * 4 + 2], &regs[i * 4 + 3]);
+#endif
+
+    std::string brand;
+
+    for(unsigned int i = 0; i < 48; ++i)
+    {
+        const char c = (char)(regs[i / 4] >> (8 * (i % 4)));
+
+        if (c == 0)
+            break;
+
+        brand += c;
+    }
+
+    // Без пробелов по краям
+    const std::size_t first = brand.find_first_not_of(' ');
+    const std::size_t last = brand.find_last_not_of(' ');
+
+    return first == std::string::npos ? "unknown" : brand.substr(first, last - first + 1);
+
+#else
+
+    return "unknown";
+
+#endif
+}
+
+
+/*
+    Набор инструкций, которым работают ядра: определяется один раз,
+    с учётом ограничения из ML_CPP_ISA
+*/
+inline CpuIsa ActiveCpuIsa()
+{
+    static const CpuIsa isa = []
+    {
+        CpuIsa detected = DetectCpuIsa();
+
+        const char* env = std::getenv("ML_CPP_ISA");
+
+        if (env == nullptr)
+            return detected;
+
+        const std::string name = env;
+
+        for(CpuIsa requested : { CpuIsa::Scalar, CpuIsa::SSE42, CpuIsa::AVX2, CpuIsa::AVX512 })
+        {
+            if (name != CpuIsaName(requested))
+                continue;
+
+            if (requested > detected)
+            {
+                std::cout << "ML_CPP_ISA=" << name << " is not supported by this CPU, using " << CpuIsaName(detected) << std::endl;
+                return detected;
+            }
+
+            return requested;
+        }
+
+        std::cout << "Unknown ML_CPP_ISA=" << name << ", using " << CpuIsaName(detected) << std::endl;
+        return detected;
+    }();
+
+    return isa;
+}
+
+
+/*
+    Целочисленное умножение-сложение байтов AVX-512 VNNI (vpdpbusd) для
+    ядер int8 (Quantize.cpp). Отдельного уровня в CpuIsa у него нет: оно
+    используется, только если активен AVX-512
+*/
+inline bool CpuHasAvx512Vnni()
+{
+    static const bool vnni = []
+    {
+        if (ActiveCpuIsa() != CpuIsa::AVX512)
+            return false;
+
+#if defined(CPU_X86) && defined(_MSC_VER)
+
+        int info[4];
+
+        __cpuidex(info, 7, 0);
+
+        const bool avx512bw = (info[1] >> 30) & 1;
+        const bool avx512vnni = (info[2] >> 11) & 1;
+
+        return avx512bw && avx512vnni;
+
+#elif defined(CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+
+        return __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni");
+
+#else
+
+        return false;
+
+#endif
+    }();
+
+    return vnni;
+}
+
+
+/*
+    Выбор варианта ядра под активный набор инструкций. Ядер под SSE4.2
+    нет: базовый x86-64 уже включает SSE2, и скалярный вариант
+    векторизуется компилятором
+*/
+template <typename Kernel>
+Kernel SelectKernel(Kernel scalar, Kernel avx2, Kernel avx512)
+{
+    switch (ActiveCpuIsa())
+    {
+    case CpuIsa::AVX512:
+        return avx512;
+    case CpuIsa::AVX2:
+        return avx2;
+    default:
+        return scalar;
+    }
+}
+
+/*
+    На других архитектурах SIMD-варианты не собираются вовсе
+*/
+#if defined(CPU_X86)
+#define CPU_DISPATCH(scalar, avx2, avx512) SelectKernel(scalar, avx2, avx512)
+#else
+#define CPU_DISPATCH(scalar, avx2, avx512) (scalar)
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Обёртки над векторными регистрами: одни и те же шаблоны ядер
+    собираются для AVX2 и AVX-512 с разной шириной вектора
+*/
+#if defined(CPU_X86)
+
+template <typename T> struct Avx2Vector;
+template <typename T> struct Avx512Vector;
+
+template <>
+struct Avx2Vector<float>
+{
+    typedef __m256 Vec;
+    static constexpr unsigned int W = 8;
+
+    CPU_TARGET_AVX2 static Vec Zero() { return _mm256_setzero_ps(); }
+    CPU_TARGET_AVX2 static Vec Set(float x) { return _mm256_set1_ps(x); }
+    CPU_TARGET_AVX2 static Vec Load(const float* p) { return _mm256_loadu_ps(p); }
+    CPU_TARGET_AVX2 static void Store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+
+    // Первые n < W элементов, остальные не читаются и не пишутся
+    CPU_TARGET_AVX2 static __m256i Mask(unsigned int n) { return _mm256_cmpgt_epi32(_mm256_set1_epi32((int)n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)); }
+    CPU_TARGET_AVX2 static Vec LoadN(const float* p, unsigned int n) { return _mm256_maskload_ps(p, Mask(n)); }
+    CPU_TARGET_AVX2 static void StoreN(float* p, Vec v, unsigned int n) { _mm256_maskstore_ps(p, Mask(n), v); }
+
+    /*
+        Элементы с чётными номерами p[0], p[2], ..., p[2W - 2] (свёртка
+        с шагом 2): две загрузки и перестановка, дальше p[2W - 2] не читается.
+        Вторая загрузка начинается с p[W - 1], нужные из неё - нечётные
+    */
+    CPU_TARGET_AVX2 static Vec Even(Vec lo, Vec hi)
+    {
+        __m256 s = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 2, 0));
+        return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(s), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+
+    CPU_TARGET_AVX2 static Vec LoadEven(const float* p) { return Even(Load(p), Load(p + W - 1)); }
+    CPU_TARGET_AVX2 static Vec LoadEvenN(const float* p, unsigned int n) { return Even(LoadN(p, std::min(2 * n - 1, W)), LoadN(p + W - 1, 2 * n > W ? 2 * n - W : 0)); }
+
+    CPU_TARGET_AVX2 static Vec Add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+    CPU_TARGET_AVX2 static Vec Mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+    CPU_TARGET_AVX2 static Vec Fmadd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+
+    // x >= 0 ? a : b
+    CPU_TARGET_AVX2 static Vec SelectNonNegative(Vec x, Vec a, Vec b)
+    {
+        return _mm256_blendv_ps(a, b, _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+    }
+
+    CPU_TARGET_AVX2 static float Sum(Vec v)
+    {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_movehdup_ps(s));
+        return _mm_cvtss_f32(s);
+    }
+};
+
+template <>
+struct Avx2Vector<double>
+{
+    typedef __m256d Vec;
+    static constexpr unsigned int W = 4;
+
+    CPU_TARGET_AVX2 static Vec Zero() { return _mm256_setzero_pd(); }
+    CPU_TARGET_AVX2 static Vec Set(double x) { return _mm256_set1_pd(x); }
+    CPU_TARGET_AVX2 static Vec Load(const double* p) { return _mm256_loadu_pd(p); }
+    CPU_TARGET_AVX2 static void Store(double* p, Vec v) { _mm256_storeu_pd(p, v); }
+
+    CPU_TARGET_AVX2 static __m256i Mask(unsigned int n) { return _mm256_cmpgt_epi64(_mm256_set1_epi64x(n), _mm256_setr_epi64x(0, 1, 2, 3)); }
+    CPU_TARGET_AVX2 static Vec LoadN(const double* p, unsigned int n) { return _mm256_maskload_pd(p, Mask(n)); }
+    CPU_TARGET_AVX2 static void StoreN(double* p, Vec v, unsigned int n) { _mm256_maskstore_pd(p, Mask(n), v); }
+
+    CPU_TARGET_AVX2 static Vec Even(Vec lo, Vec hi)
+    {
+        return _mm256_permute4x64_pd(_mm256_shuffle_pd(lo, hi, 0b1010), _MM_SHUFFLE(3, 1, 2, 0));
+    }
+
+    CPU_TARGET_AVX2 static Vec LoadEven(const double* p) { return Even(Load(p), Load(p + W - 1)); }
+    CPU_TARGET_AVX2 static Vec LoadEvenN(const double* p, unsigned int n) { return Even(LoadN(p, std::min(2 * n - 1, W)), LoadN(p + W - 1, 2 * n > W ? 2 * n - W : 0)); }
+
+    CPU_TARGET_AVX2 static Vec Add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+    CPU_TARGET_AVX2 static Vec Mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+    CPU_TARGET_AVX2 static Vec Fmadd(Vec a, Vec b, Vec c) { return _mm256_fmadd_pd(a, b, c); }
+
+    CPU_TARGET_AVX2 static Vec SelectNonNegative(Vec x, Vec a, Vec b)
+    {
+        return _mm256_blendv_pd(a, b, _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_LT_OQ));
+    }
+
+    CPU_TARGET_AVX2 static double Sum(Vec v)
+    {
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+        s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+        return _mm_cvtsd_f64(s);
+    }
+};
+
+template <>
+struct Avx512Vector<float>
+{
+    typedef __m512 Vec;
+    static constexpr unsigned int W = 16;
+
+    CPU_TARGET_AVX512 static Vec Zero() { return _mm512_setzero_ps(); }
+    CPU_TARGET_AVX512 static Vec Set(float x) { return _mm512_set1_ps(x); }
+    CPU_TARGET_AVX512 static Vec Load(const float* p) { return _mm512_loadu_ps(p); }
+    CPU_TARGET_AVX512 static void Store(float* p, Vec v) { _mm512_storeu_ps(p, v); }
+    CPU_TARGET_AVX512 static Vec LoadN(const float* p, unsigned int n) { return _mm512_maskz_loadu_ps((__mmask16)((1u << n) - 1), p); }
+    CPU_TARGET_AVX512 static void StoreN(float* p, Vec v, unsigned int n) { _mm512_mask_storeu_ps(p, (__mmask16)((1u << n) - 1), v); }
+
+    CPU_TARGET_AVX512 static Vec Even(Vec lo, Vec hi)
+    {
+        return _mm512_permutex2var_ps(lo, _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 17, 19, 21, 23, 25, 27, 29, 31), hi);
+    }
+
+    CPU_TARGET_AVX512 static Vec LoadEven(const float* p) { return Even(Load(p), Load(p + W - 1)); }
+    CPU_TARGET_AVX512 static Vec LoadEvenN(const float* p, unsigned int n) { return Even(LoadN(p, std::min(2 * n - 1, W)), LoadN(p + W - 1, 2 * n > W ? 2 * n - W : 0)); }
+
+    CPU_TARGET_AVX512 static Vec Add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+    CPU_TARGET_AVX512 static Vec Mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+    CPU_TARGET_AVX512 static Vec Fmadd(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+
+    CPU_TARGET_AVX512 static Vec SelectNonNegative(Vec x, Vec a, Vec b)
+    {
+        return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_LT_OQ), a, b);
+    }
+
+    CPU_TARGET_AVX512 static float Sum(Vec v)
+    {
+        __m256 hi = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, _mm512_castps_pd(v), 1));
+        __m256 lo = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xFF, _mm512_castps_pd(v), 0));
+        __m256 h = _mm256_add_ps(lo, hi);
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_movehdup_ps(s));
+        return _mm_cvtss_f32(s);
+    }
+};
+
+template <>
+struct Avx512Vector<double>
+{
+    typedef __m512d Vec;
+    static constexpr unsigned int W = 8;
+
+    CPU_TARGET_AVX512 static Vec Zero() { return _mm512_setzero_pd(); }
+    CPU_TARGET_AVX512 static Vec Set(double x) { return _mm512_set1_pd(x); }
+    CPU_TARGET_AVX512 static Vec Load(const double* p) { return _mm512_loadu_pd(p); }
+    CPU_TARGET_AVX512 static void Store(double* p, Vec v) { _mm512_storeu_pd(p, v); }
+    CPU_TARGET_AVX512 static Vec LoadN(const double* p, unsigned int n) { return _mm512_maskz_loadu_pd((__mmask8)((1u << n) - 1), p); }
+    CPU_TARGET_AVX512 static void StoreN(double* p, Vec v, unsigned int n) { _mm512_mask_storeu_pd(p, (__mmask8)((1u << n) - 1), v); }
+
+    CPU_TARGET_AVX512 static Vec Even(Vec lo, Vec hi)
+    {
+        return _mm512_permutex2var_pd(lo, _mm512_setr_epi64(0, 2, 4, 6, 9, 11, 13, 15), hi);
+    }
+
+    CPU_TARGET_AVX512 static Vec LoadEven(const double* p) { return Even(Load(p), Load(p + W - 1)); }
+    CPU_TARGET_AVX512 static Vec LoadEvenN(const double* p, unsigned int n) { return Even(LoadN(p, std::min(2 * n - 1, W)), LoadN(p + W - 1, 2 * n > W ? 2 * n - W : 0)); }
+
+    CPU_TARGET_AVX512 static Vec Add(Vec a, Vec b) { return _mm512_add_pd(a, b); }
+    CPU_TARGET_AVX512 static Vec Mul(Vec a, Vec b) { return _mm512_mul_pd(a, b); }
+    CPU_TARGET_AVX512 static Vec Fmadd(Vec a, Vec b, Vec c) { return _mm512_fmadd_pd(a, b, c); }
+
+    CPU_TARGET_AVX512 static Vec SelectNonNegative(Vec x, Vec a, Vec b)
+    {
+        return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_LT_OQ), a, b);
+    }
+
+    CPU_TARGET_AVX512 static double Sum(Vec v)
+    {
+        __m256d h = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xFF, v, 0), _mm512_maskz_extractf64x4_pd(0xFF, v, 1));
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(h), _mm256_extractf128_pd(h, 1));
+        s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+        return _mm_cvtsd_f64(s);
+    }
+};
+
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
@@ -0,0 +1,468 @@
+#ifndef GEMM
+#define GEMM
+
+#include <vector>
+#include <algorithm>
+
+#include "CpuFeatures.cpp"
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Перемножение матриц C = alpha * op(A) * op(B) + beta * C
+    Все матрицы хранятся построчно, op(X) - это X или X^T
+
+    Устроено как в BLIS/GotoBLAS:
+    - B режется на панели KC x NC, A на блоки MC x KC, чтобы они лежали в кэше
+    - блоки переупаковываются в непрерывные полосы шириной MR (для A) и NR (для B)
+    - микроядро держит плитку MR x NR результата в регистрах и идёт по KC
+
+    Микроядро выбирается под процессор во время выполнения (AVX-512, AVX2
+    или обычный цикл), упаковка от набора инструкций не зависит
+*/
+
+struct GemmBlocking
+{
+    unsigned int MC = 96;
+    unsigned int KC = 256;
+    unsigned int NC = 2048;
+};
+
+template <typename T>
+struct GemmTile
+{
+    // Плитка 6 x 16 float или 6 x 8 double - это 12 векторных регистров AVX2
+    // или 6 регистров AVX-512, ещё остаются регистры под строку B
+    static constexpr unsigned int MR = 6;
+    static constexpr unsigned int NR = sizeof(T) == 4 ? 16 : 8;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Упаковка блока op(A) размера mc x kc в полосы по MR строк:
+    внутри полосы элементы идут в порядке k, затем строка
+*/
+template <typename T>
+void GemmPackA(bool trans_a, const T* A, unsigned int lda, unsigned int i0, unsigned int k0, unsigned int mc, unsigned int kc, T* packed)
+{
+    constexpr unsigned int MR = GemmTile<T>::MR;
+
+    for(unsigned int ip = 0; ip < mc; ip += MR)
+    {
+        unsigned int rows = std::min(MR, mc - ip);
+
+        for(unsigned int k = 0; k < kc; ++k)
+        {
+            for(unsigned int i = 0; i < MR; ++i)
+            {
+                if (i < rows)
+                {
+                    unsigned int row = i0 + ip + i;
+                    unsigned int col = k0 + k;
+
+                    *packed++ = trans_a ? A[(std::size_t)col * lda + row] : A[(std::size_t)row * lda + col];
+                }
+                else
+                {
+                    *packed++ = 0;
+                }
+            }
+        }
+    }
+}
+
+/*
+    Упаковка блока op(B) размера kc x nc в полосы по NR столбцов
+*/
+template <typename T>
+void GemmPackB(bool trans_b, const T* B, unsigned int ldb, unsigned int k0, unsigned int j0, unsigned int kc, unsigned int nc, T* packed)
+{
+    constexpr unsigned int NR = GemmTile<T>::NR;
+
+    for(unsigned int jp = 0; jp < nc; jp += NR)
+    {
+        unsigned int cols = std::min(NR, nc - jp);
+
+        for(unsigned int k = 0; k < kc; ++k)
+        {
+            unsigned int row = k0 + k;
+
+            if (!trans_b && cols == NR)
+            {
+                const T* src = B + (std::size_t)row * ldb + j0 + jp;
+
+                for(unsigned int j = 0; j < NR; ++j)
+                    *packed++ = src[j];
+
+                continue;
+            }
+
+            for(unsigned int j = 0; j < NR; ++j)
+            {
+                if (j < cols)
+                {
+                    unsigned int col = j0 + jp + j;
+
+                    *packed++ = trans_b ? B[(std::size_t)col * ldb + row] : B[(std::size_t)row * ldb + col];
+                }
+                else
+                {
+                    *packed++ = 0;
+                }
+            }
+        }
+    }
+}
+
+/*
+    Микроядро: плитка MR x NR копится в локальном массиве, который
+    компилятор разворачивает в регистры, затем добавляется в C
+*/
+template <typename T>
+inline void GemmMicroKernel(unsigned int kc, const T* a, const T* b, T alpha, T* C, unsigned int ldc, unsigned int rows, unsigned int cols)
+{
+    constexpr unsigned int MR = GemmTile<T>::MR;
+    constexpr unsigned int NR = GemmTile<T>::NR;
+
+    T acc[MR][NR] = {};
+
+    for(unsigned int k = 0; k < kc; ++k)
+    {
+        const T* a_k = a + k * MR;
+        const T* b_k = b + k * NR;
+
+        for(unsigned int i = 0; i < MR; ++i)
+        {
+            const T a_ik = a_k[i];
+
+            for(unsigned int j = 0; j < NR; ++j)
+                acc[i][j] += a_ik * b_k[j];
+        }
+    }
+
+    for(unsigned int i = 0; i < rows; ++i)
+    {
+        T* c_row = C + (std::size_t)i * ldc;
+
+        for(unsigned int j = 0; j < cols; ++j)
+            c_row[j] += alpha * acc[i][j];
+    }
+}
+
+
+#if defined(CPU_X86)
+
+template <typename T>
+CPU_TARGET_AVX2 void GemmMicroKernelAvx2(unsigned int kc, const T* a, const T* b, T alpha, T* C, unsigned int ldc, unsigned int rows, unsigned int cols)
+{
+    typedef Avx2Vector<T> V;
+
+    constexpr unsigned int MR = GemmTile<T>::MR;
+    constexpr unsigned int NR = GemmTile<T>::NR;
+    constexpr unsigned int VN = NR / V::W;
+
+    typename V::Vec acc[MR][VN];
+
+    CPU_UNROLL
+
+    for(unsigned int i = 0; i < MR; ++i)
+        CPU_UNROLL
+        for(unsigned int j = 0; j < VN; ++j)
+            acc[i][j] = V::Zero();
+
+    for(unsigned int k = 0; k < kc; ++k)
+    {
+        const T* a_k = a + k * MR;
+        const T* b_k = b + k * NR;
+
+        typename V::Vec b_j[VN];
+
+        CPU_UNROLL
+
+        for(unsigned int j = 0; j < VN; ++j)
+            b_j[j] = V::Load(b_k + j * V::W);
+
+        CPU_UNROLL
+
+        for(unsigned int i = 0; i < MR; ++i)
+        {
+            const typename V::Vec a_ik = V::Set(a_k[i]);
+
+            CPU_UNROLL
+
+            for(unsigned int j = 0; j < VN; ++j)
+                acc[i][j] = V::Fmadd(a_ik, b_j[j], acc[i][j]);
+        }
+    }
+
+    const typename V::Vec alpha_v = V::Set(alpha);
+
+    if (rows == MR && cols == NR)
+    {
+        CPU_UNROLL
+        for(unsigned int i = 0; i < MR; ++i)
+        {
+            T* c_row = C + (std::size_t)i * ldc;
+
+            CPU_UNROLL
+
+            for(unsigned int j = 0; j < VN; ++j)
+                V::Store(c_row + j * V::W, V::Fmadd(alpha_v, acc[i][j], V::Load(c_row + j * V::W)));
+        }
+
+        return;
+    }
+
+    T tile[MR][NR];
+
+    CPU_UNROLL
+
+    for(unsigned int i = 0; i < MR; ++i)
+        CPU_UNROLL
+        for(unsigned int j = 0; j < VN; ++j)
+            V::Store(tile[i] + j * V::W, V::Mul(alpha_v, acc[i][j]));
+
+    for(unsigned int i = 0; i < rows; ++i)
+    {
+        T* c_row = C + (std::size_t)i * ldc;
+
+        for(unsigned int j = 0; j < cols; ++j)
+            c_row[j] += tile[i][j];
+    }
+}
+
+template <typename T>
+CPU_TARGET_AVX512 void GemmMicroKernelAvx512(unsigned int kc, const T* a, const T* b, T alpha, T* C, unsigned int ldc, unsigned int rows, unsigned int cols)
+{
+    typedef Avx512Vector<T> V;
+
+    constexpr unsigned int MR = GemmTile<T>::MR;
+    constexpr unsigned int NR = GemmTile<T>::NR;
+
+    static_assert(NR == V::W, "AVX-512 micro-kernel expects one register per tile row");
+
+    typename V::Vec acc[MR];
+
+    CPU_UNROLL
+
+    for(unsigned int i = 0; i < MR; ++i)
+        acc[i] = V::Zero();
+
+    for(unsigned int k = 0; k < kc; ++k)
+    {
+        const T* a_k = a + k * MR;
+        const typename V::Vec b_k = V::Load(b + k * NR);
+
+        CPU_UNROLL
+
+        for(unsigned int i = 0; i < MR; ++i)
+            acc[i] = V::Fmadd(V::Set(a_k[i]), b_k, acc[i]);
+    }
+
+    const typename V::Vec alpha_v = V::Set(alpha);
+
+    if (rows == MR && cols == NR)
+    {
+        CPU_UNROLL
+        for(unsigned int i = 0; i < MR; ++i)
+        {
+            T* c_row = C + (std::size_t)i * ldc;
+            V::Store(c_row, V::Fmadd(alpha_v, acc[i], V::Load(c_row)));
+        }
+
+        return;
+    }
+
+    T tile[MR][NR];
+
+    CPU_UNROLL
+
+    for(unsigned int i = 0; i < MR; ++i)
+        V::Store(tile[i], V::Mul(alpha_v, acc[i]));
+
+    for(unsigned int i = 0; i < rows; ++i)
+    {
+        T* c_row = C + (std::size_t)i * ldc;
+
+        for(unsigned int j = 0; j < cols; ++j)
+            c_row[j] += tile[i][j];
+    }
+}
+
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Матрица op(A) M x K, заранее упакованная целиком: для каждого блока
+    KC все строки лежат полосами по MR, как их упаковывает GemmPackA.
+    Нужна для матрицы, которая участвует во многих умножениях (веса слоя):
+    упаковка делается один раз, а не при каждом вызове Gemm
+*/
+template <typename T>
+struct GemmPackedA
+{
+    unsigned int M = 0;
+    unsigned int K = 0;
+    unsigned int KC = 0;
+
+    std::vector<T> data;
+
+    void Pack(bool trans_a, const T* A, unsigned int lda, unsigned int M, unsigned int K, const GemmBlocking& blocking = GemmBlocking())
+    {
+        constexpr unsigned int MR = GemmTile<T>::MR;
+
+        this->M = M;
+        this->K = K;
+        this->KC = std::max(1u, blocking.KC);
+
+        const std::size_t padded_rows = (M + MR - 1) / MR * MR;
+
+        data.resize(padded_rows * K);
+
+        for(unsigned int k0 = 0; k0 < K; k0 += KC)
+            GemmPackA(trans_a, A, lda, 0, k0, M, std::min(KC, K - k0), data.data() + k0 * padded_rows);
+    }
+
+    /*
+        Полоса, начинающаяся со строки i (кратной MR), в блоке k0 длиной kc
+    */
+    const T* Panel(unsigned int i, unsigned int k0, unsigned int kc) const
+    {
+        constexpr unsigned int MR = GemmTile<T>::MR;
+
+        const std::size_t padded_rows = (M + MR - 1) / MR * MR;
+
+        return data.data() + k0 * padded_rows + (std::size_t)(i / MR) * MR * kc;
+    }
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+/*
+    Общая часть Gemm: если prepacked задана, op(A) берётся из неё
+    и не упаковывается
+*/
+template <typename T>
+void GemmRun
+(
+    bool trans_a, bool trans_b,
+    unsigned int M, unsigned int N, unsigned int K,
+    T alpha,
+    const T* A, unsigned int lda,
+    const GemmPackedA<T>* prepacked,
+    const T* B, unsigned int ldb,
+    T beta,
+    T* C, unsigned int ldc,
+    const GemmBlocking& blocking
+)
+{
+    constexpr unsigned int MR = GemmTile<T>::MR;
+    constexpr unsigned int NR = GemmTile<T>::NR;
+
+    if (beta != 1)
+    {
+        for(unsigned int i = 0; i < M; ++i)
+        {
+            T* c_row = C + (std::size_t)i * ldc;
+
+            for(unsigned int j = 0; j < N; ++j)
+                c_row[j] = beta == 0 ? 0 : c_row[j] * beta;
+        }
+    }
+
+    if (M == 0 || N == 0 || K == 0 || alpha == 0)
+        return;
+
+    static const auto micro_kernel = CPU_DISPATCH(&GemmMicroKernel<T>, &GemmMicroKernelAvx2<T>, &GemmMicroKernelAvx512<T>);
+
+    const unsigned int MC = std::max(MR, blocking.MC / MR * MR);
+    const unsigned int KC = prepacked != nullptr ? prepacked->KC : std::max(1u, blocking.KC);
+    const unsigned int NC = std::max(NR, blocking.NC / NR * NR);
+
+    // Буферы упаковки переиспользуются между вызовами
+    thread_local std::vector<T> packed_a;
+    thread_local std::vector<T> packed_b;
+
+    packed_a.resize((std::size_t)(MC + MR) * KC);
+    packed_b.resize((std::size_t)(NC + NR) * KC);
+
+    for(unsigned int j0 = 0; j0 < N; j0 += NC)
+    {
+        unsigned int nc = std::min(NC, N - j0);
+
+        for(unsigned int k0 = 0; k0 < K; k0 += KC)
+        {
+            unsigned int kc = std::min(KC, K - k0);
+
+            GemmPackB(trans_b, B, ldb, k0, j0, kc, nc, packed_b.data());
+
+            for(unsigned int i0 = 0; i0 < M; i0 += MC)
+            {
+                unsigned int mc = std::min(MC, M - i0);
+
+                if (prepacked == nullptr)
+                    GemmPackA(trans_a, A, lda, i0, k0, mc, kc, packed_a.data());
+
+                for(unsigned int jr = 0; jr < nc; jr += NR)
+                {
+                    const T* b_panel = packed_b.data() + (std::size_t)(jr / NR) * NR * kc;
+
+                    for(unsigned int ir = 0; ir < mc; ir += MR)
+                    {
+                        const T* a_panel = prepacked != nullptr
+                            ? prepacked->Panel(i0 + ir, k0, kc)
+                            : packed_a.data() + (std::size_t)(ir / MR) * MR * kc;
+
+                        micro_kernel(
+                            kc, a_panel, b_panel, alpha,
+                            C + (std::size_t)(i0 + ir) * ldc + j0 + jr, ldc,
+                            std::min(MR, mc - ir), std::min(NR, nc - jr)
+                        );
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+template <typename T>
+void Gemm
+(
+    bool trans_a, bool trans_b,
+    unsigned int M, unsigned int N, unsigned int K,
+    T alpha,
+    const T* A, unsigned int lda,
+    const T* B, unsigned int ldb,
+    T beta,
+    T* C, unsigned int ldc,
+    const GemmBlocking& blocking = GemmBlocking()
+)
+{
+    GemmRun<T>(trans_a, trans_b, M, N, K, alpha, A, lda, nullptr, B, ldb, beta, C, ldc, blocking);
+}
+
+/*
+    C = alpha * op(A) * op(B) + beta * C с заранее упакованной op(A)
+*/
+template <typename T>
+void Gemm
+(
+    const GemmPackedA<T>& A,
+    bool trans_b,
+    unsigned int N,
+    T alpha,
+    const T* B, unsigned int ldb,
+    T beta,
+    T* C, unsigned int ldc,
+    const GemmBlocking& blocking = GemmBlocking()
+)
+{
+    GemmRun<T>(false, trans_b, A.M, N, A.K, alpha, nullptr, 0, &A, B, ldb, beta, C, ldc, blocking);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#endif
@@ -1,10 +1,18 @@
 #ifndef FULLY_CONNECTED_LAYER
 #define FULLY_CONNECTED_LAYER
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <random>
+#include <vector>
 
 #include "../Tensor.cpp"
+#include "../Kernels/Gemv.cpp"
+#include "../Kernels/Gemm.cpp"
+#include "../Kernels/ColumnRuns.cpp"
+#include "../Kernels/BlockSparse.cpp"
+#include "../Kernels/Quantize.cpp"
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
@@ -16,6 +24,7 @@
     https://education.yandex.ru/handbook/ml/article/metod-obratnogo-rasprostraneniya-oshibki
 */
 
+template <typename T>
 class FullyConnectedLayer
 {
 
@@ -24,29 +33,66 @@ private:
     unsigned int inputs;
     unsigned int outputs;
 
+    // Отрезки ненулевых столбцов входа одного примера (ColumnRuns.cpp)
+    std::vector<unsigned int> input_runs;
+
+    /*
+        Версия весов увеличивается при каждом их изменении, как у
+        ConvolutionalLayer: копии весов ниже используются, только пока
+        их версия совпадает с текущей
+    */
+    unsigned long weights_version = 1;
+
+    // Оставшиеся после Prune блоки весов (BlockSparse.cpp)
+    BlockSparseMatrix<T> sparse_W;
+    unsigned long sparse_version = 0;
+
+    // Веса в int8 и квантование входа (Quantize.cpp)
+    Int8Matrix<T> int8_W;
+    Int8Activation<T> int8_input;
+    unsigned long int8_version = 0;
+
+    std::vector<std::uint8_t> int8_x;
+    std::vector<std::int32_t> int8_y;
+
+    /*
+        Обучение с учётом квантования: W на сетке int8, настоящие веса -
+        W + int8_residual (SimulateInt8Rows), вход слоя проходит через
+        квантование в simulated_input
+    */
+    bool quantization_aware = false;
+    std::vector<T> int8_residual;
+    Tensor<T> simulated_input;
+
 public:
 
-    double learning_rate;
+    T learning_rate;
+
+    /*
+        Нужен ли градиент по входу. Первому слою сети он не нужен: тогда
+        Backward только меняет веса и возвращает нулевой градиент
+    */
+    bool input_gradient = true;
 
-    Tensor W;
-    Tensor B;
+    Tensor<T> W;
+    Tensor<T> B;
 
     FullyConnectedLayer(){}
 
     void Initialize(
         unsigned int inputs, 
         unsigned int outputs, 
-        double learning_rate = 1e-4,
-        double mean = 0,
-        double sigma = 0
+        T learning_rate = 1e-4,
+        T mean = 0,
+        T sigma = 0
     )
     {
         this -> inputs = inputs;
         this -> outputs = outputs;
         this -> learning_rate = learning_rate;
 
-        W = Tensor(1, outputs, inputs);
-        B = Tensor(1, outputs, 1);
+        W = Tensor<T>(1, outputs, inputs);
+        B = Tensor<T>(1, outputs, 1);
 
         DefineWeights(mean, sigma);
     }
@@ -54,7 +100,7 @@ public:
     /*
         Инициализация весов с помощью нормального распределения
     */
-    void DefineWeights(double mean, double sigma = 0)
+    void DefineWeights(T mean, T sigma = 0)
     {
 
         if (sigma == 0)
@@ -85,14 +131,22 @@ public:
                 }
             }
         }
+
+        InvalidateWeightCache();
     }
 
 
     /*
         Банальное перемножение весов каждого нейрона со входным сигналом
-        и суммирование
+        и суммирование. Для одного примера это умножение матрицы весов
+        на вектор входа (Gemv): несколько нейронов считаются сразу, и
+        загруженный кусок входа используется для всех них
+
+        Батч - это матрица X [N x inputs] (пример - строка), и весь
+        проход - одно умножение матриц Y [N x outputs] = X * W^T + b:
+        веса читаются из памяти один раз на блок примеров, а не на каждый
     */
-    Tensor Forward(const Tensor& X)
+    Tensor<T> Forward(const Tensor<T>& X)
     {
         if (X.get_height() != inputs || X.get_width() != 1)
         {
@@ -100,18 +154,64 @@ public:
             throw;
         }
         
-        Tensor Y = Tensor(1, outputs, 1);
+        const unsigned int batch = X.get_batch();
 
-        for(unsigned int neuron_index = 0; neuron_index < outputs; ++neuron_index)
+        Tensor<T> Y = Tensor<T>(batch, 1, outputs, 1, 0);
+
+        const T* b = B.data();
+
+        if (Quantized())
         {
-            Y[0][neuron_index][0] = B[0][neuron_index][0];
+            for(unsigned int n = 0; n < batch; ++n)
+            {
+                int8_input.Quantize(X.sample(n), inputs, int8_x.data());
+                Int8Gemv(outputs, int8_W.stride, int8_W.value.data(), int8_W.stride, int8_x.data(), int8_y.data());
+
+                T* y = Y.sample(n);
+
+                for(unsigned int i = 0; i < outputs; ++i)
+                    y[i] = int8_W.alpha[i] * int8_y[i] + int8_W.beta[i];
+            }
+
+            return Y;
+        }
 
-            for(unsigned int input_index = 0; input_index < inputs; ++input_index)
+        const Tensor<T>& input = SimulatedInput(X);
+
+        if (Pruned())
+        {
+            for(unsigned int n = 0; n < batch; ++n)
             {
-                Y[0][neuron_index][0] += X(0, input_index, 0) * W(0, neuron_index, input_index);
+                T* y = Y.sample(n);
+
+                for(unsigned int neuron_index = 0; neuron_index < outputs; ++neuron_index)
+                    y[neuron_index] = b[neuron_index];
+
+                BlockSparseGemv(sparse_W, input.sample(n), y);
             }
+
+            return Y;
+        }
+
+        for(unsigned int n = 0; n < batch; ++n)
+        {
+            T* y = Y.sample(n);
+
+            for(unsigned int neuron_index = 0; neuron_index < outputs; ++neuron_index)
+                y[neuron_index] = b[neuron_index];
+
+            if (batch == 1)
+                Gemv(outputs, inputs, W.data(), inputs, input.sample(n), y);
         }
 
+        if (batch > 1)
+            Gemm<T>(
+                false, true, batch, outputs, inputs,
+                1, input.data(), inputs,
+                W.data(), inputs,
+                1, Y.data(), outputs
+            );
+
         return Y;
     }
 
@@ -119,9 +219,9 @@ public:
         Обратное распространение ошибки, подробности расчёта смотри в 
         самой функции
     */
-    Tensor Backward(const Tensor& X, const Tensor& GFNL)
+    Tensor<T> Backward(const Tensor<T>& X, const Tensor<T>& GFNL)
     {
-        if(GFNL.get_height() != outputs || GFNL.get_width() != 1 || GFNL.get_depth() != 1)
+        if(GFNL.get_height() != outputs || GFNL.get_width() != 1 || GFNL.get_depth() != 1 || GFNL.get_batch() != X.get_batch())
         {
             std::cout << "Gradient from next layer is wrong dimension!" << std::endl;
             throw;
@@ -133,58 +233,443 @@ public:
             throw;
         }
 
-        // Чтобы распространение ошибки продолжало работать, необходимо
-        // передавать градиент дальше предыдущим слоям
-        Tensor GFCL = Tensor(1, inputs, 1);
+        // Обучение снова меняет все веса, разреженная и int8 копии устаревают
+        ++weights_version;
 
-        for(unsigned int neuron_index = 0; neuron_index < outputs; ++neuron_index)
+        // Градиенты считаются по входу, который видел Forward
+        const Tensor<T>& input = ObserveTraining(X);
+
+        Tensor<T> GFCL;
+
+        if (X.get_batch() > 1)
+            GFCL = BackwardBatch(input, GFNL);
+        else if (!input_gradient)
+            GFCL = BackwardUpdateOnly(input.data(), GFNL.data());
+        else
+            GFCL = BackwardSample(input.data(), GFNL.data());
+
+        // Изменённые веса снова кладутся на сетку int8
+        if (quantization_aware)
+            SimulateInt8Rows(outputs, inputs, W.data(), inputs, int8_residual.data());
+
+        return GFCL;
+    }
+
+
+    /*
+        Прореживание по модулю блоками: строка весов делится на блоки по
+        линии кэша (BlockSparse.cpp), и доля sparsity блоков с самой
+        маленьким средним модулем весов обнуляется (последний блок строки
+        может быть короче, по сумме он выглядел бы меньше). Оставшиеся
+        блоки хранятся отдельно, и Forward дальше умножает только их
+        (BlockSparseGemv) - для каждого примера батча отдельно, если
+        блоков осталось меньше половины
+
+        Вызывается после обучения. Любое изменение весов (Backward или
+        запись в W с InvalidateWeightCache) делает слой снова плотным,
+        после дообучения Prune нужно вызвать ещё раз. При обучении с
+        учётом квантования блоки сравниваются по настоящим весам, и их
+        остаток обнуляется вместе с ними
+    */
+    void Prune(T sparsity)
+    {
+        if (sparsity < 0 || sparsity > 1)
         {
-            for(unsigned int input_index = 0; input_index < inputs; ++input_index)
+            std::cout << "Sparsity must be in [0, 1]!" << std::endl;
+            throw;
+        }
+
+        constexpr unsigned int block = BlockSparseMatrix<T>::block;
+
+        const unsigned int row_blocks = (inputs + block - 1) / block;
+        const std::size_t blocks = (std::size_t)outputs * row_blocks;
+        const std::size_t zeros = (std::size_t)(sparsity * blocks);
+
+        T* w = W.data();
+
+        std::vector<T> magnitude(blocks, 0);
+
+        for(unsigned int i = 0; i < outputs; ++i)
+            for(unsigned int j = 0; j < inputs; ++j)
+                magnitude[(std::size_t)i * row_blocks + j / block] += std::abs(Weight((std::size_t)i * inputs + j));
+
+        const unsigned int last_block = inputs - (row_blocks - 1) * block;
+
+        for(std::size_t k = 0; k < blocks; ++k)
+            magnitude[k] /= k % row_blocks == row_blocks - 1 ? last_block : block;
+
+        if (zeros > 0)
+        {
+            std::vector<T> sorted = magnitude;
+
+            std::nth_element(sorted.begin(), sorted.begin() + (zeros - 1), sorted.end());
+            const T threshold = sorted[zeros - 1];
+
+            // Блоки, равные порогу, обнуляются, только пока их не больше нужного
+            std::size_t below = 0;
+
+            for(std::size_t k = 0; k < blocks; ++k)
+                below += magnitude[k] < threshold;
+
+            std::size_t equal = zeros - below;
+
+            for(std::size_t k = 0; k < blocks; ++k)
             {
-                // Формула
-                /*
-                    Δw_i = δE/δS * δS/δw_i, где
-                    E - ошибка слоя, то есть кто-то там впереди посчитал за нас, каким-то образом ошибку
-                    S - фактический выход нейрона: S = b + w_1*x_1 + ... + w_i*x_i
-
-                    Нам на слое предоставляется δE/δS - градиент со следующего слоя
-                    Нам остается определить δS/δw, но это просто:
-
-                    Если взять и продифференцировать S = b + w_1*x_1 + ... + w_i*x_i по какому-то w_j, 
-                    то останется только x_j
-
-                    Поэтому формула превращается в 
-                    Δw_i = grad * x_i
-                    Обрати внимание, что под grad понимается градиент, пришедший на нейрон,
-                    Которому принадлежит w_i
-                */
-
-                /*
-                    Считаем градиент для предыдущего слоя
-                    Градиент для предыдущего слоя будет считаться так же просто
-                    
-                    Проговорим словами, что надо сделать
-                    Для каждого входа слоя необходимо сосчитать сумму градиентов весов, 
-                    Которые были применены к данному входу
-                */
-                GFCL[0][input_index][0] += GFNL(0, neuron_index, 0) * W(0, neuron_index, input_index);
-
-                // Меняем веса на текущем слое
-                W[0][neuron_index][input_index] -= GFNL(0, neuron_index, 0) * X(0, input_index, 0) * learning_rate;
+                bool zero = magnitude[k] < threshold;
+
+                if (magnitude[k] == threshold && equal > 0)
+                {
+                    zero = true;
+                    --equal;
+                }
+
+                if (!zero)
+                    continue;
+
+                const unsigned int i = k / row_blocks;
+                const unsigned int begin = (k % row_blocks) * block;
+                const unsigned int end = begin + block < inputs ? begin + block : inputs;
+
+                for(unsigned int j = begin; j < end; ++j)
+                    w[(std::size_t)i * inputs + j] = 0;
+
+                // Иначе остаток вернул бы блоку ненулевые веса
+                if (quantization_aware)
+                    std::fill(
+                        int8_residual.begin() + (std::size_t)i * inputs + begin,
+                        int8_residual.begin() + (std::size_t)i * inputs + end,
+                        0
+                    );
             }
+        }
+
+        // Без отброшенных блоков масштаб строки может стать меньше
+        if (quantization_aware)
+            SimulateInt8Rows(outputs, inputs, w, inputs, int8_residual.data());
+
+        ++weights_version;
+
+        /*
+            Если осталось не меньше половины блоков, обход по блокам медленнее
+            плотного Gemv по тем же (уже обнулённым) весам
+        */
+        if ((blocks - zeros) * 2 < blocks)
+        {
+            sparse_W.Build(outputs, inputs, w, inputs);
+            sparse_version = weights_version;
+        }
+        else
+        {
+            sparse_W = BlockSparseMatrix<T>();
+            sparse_version = 0;
+        }
+    }
+
+    bool Pruned() const
+    {
+        return sparse_version == weights_version;
+    }
+
+    /*
+        Нужно вызывать после записи в W напрямую (например, при чтении
+        модели из файла), чтобы сбросить разреженную и int8 копии весов.
+        При обучении с учётом квантования записанные веса - настоящие:
+        остаток прежних весов отбрасывается, новые кладутся на сетку
+    */
+    void InvalidateWeightCache()
+    {
+        if (quantization_aware)
+        {
+            int8_residual.assign((std::size_t)outputs * inputs, 0);
+            SimulateInt8Rows(outputs, inputs, W.data(), inputs, int8_residual.data());
+        }
+
+        ++weights_version;
+    }
+
+    /*
+        Настоящий вес k (в порядке W): при обучении с учётом квантования -
+        точка сетки плюс остаток
+    */
+    T Weight(std::size_t k) const
+    {
+        return quantization_aware ? W.data()[k] + int8_residual[k] : W.data()[k];
+    }
+
+    /*
+        Квантование в int8 после обучения (Quantize.cpp). Observe
+        вызывается для входов слоя на калибровочных примерах при обычном
+        Forward и собирает их диапазон. Quantize переводит веса в int8 с
+        масштабом на каждый нейрон, и Forward дальше считает произведения
+        в целых числах (Int8Gemv). Dequantize или любое изменение весов
+        (Backward, Prune, InvalidateWeightCache) возвращает слой к весам W
+    */
+    void Observe(const Tensor<T>& X)
+    {
+        int8_input.Observe(X.data(), X.size());
+    }
+
+    void Quantize()
+    {
+        int8_input.Calibrate();
+        int8_W.Quantize(outputs, inputs, W.data(), inputs, B.data(), int8_input);
+
+        int8_x.assign(int8_W.stride, 0);
+        int8_y.resize(outputs);
+
+        int8_version = weights_version;
+    }
+
+    void Dequantize()
+    {
+        int8_version = 0;
+    }
+
+    bool Quantized() const
+    {
+        return int8_version == weights_version;
+    }
+
+    /*
+        Обучение с учётом квантования: Forward и Backward идут по весам и
+        входу, округлённым так же, как в int8 (веса - по своей сетке
+        строки, вход - по диапазону, собранному за обучение), поэтому
+        сеть учится под ошибку квантования. Градиент через округление
+        проходит без изменений (straight-through), и обученный слой
+        переводится в int8 (Quantize) без потерь на весах: они уже на
+        сетке. При выключении W снова становятся настоящими весами
+    */
+    void SetQuantizationAware(bool enable)
+    {
+        if (enable == quantization_aware)
+            return;
+
+        quantization_aware = enable;
+
+        if (enable)
+        {
+            int8_residual.assign((std::size_t)outputs * inputs, 0);
+            SimulateInt8Rows(outputs, inputs, W.data(), inputs, int8_residual.data());
+        }
+        else
+        {
+            VectorAxpy((T)1, int8_residual.data(), W.data(), int8_residual.size());
+            int8_residual = std::vector<T>();
+        }
+
+        ++weights_version;
+    }
+
+    bool QuantizationAware() const
+    {
+        return quantization_aware;
+    }
+
+    /*
+        Доля нулевых весов и размер весов в памяти: после Quantize - в
+        int8, после Prune - только оставшихся блоков, иначе плотной матрицы.
+        Нули считаются по Weight: при квантовании во время обучения малый
+        вес округляется в W до нуля, но сам вес (с остатком) не нулевой
+    */
+    T Sparsity() const
+    {
+        const std::size_t size = (std::size_t)outputs * inputs;
+
+        std::size_t zeros = 0;
+
+        for(std::size_t k = 0; k < size; ++k)
+            zeros += Weight(k) == 0;
+
+        return (T)zeros / size;
+    }
+
+    std::size_t WeightBytes() const
+    {
+        if (Quantized())
+            return int8_W.Bytes();
+
+        if (Pruned())
+            return sparse_W.Bytes();
+
+        return (std::size_t)outputs * inputs * sizeof(T);
+    }
+
+private:
+
+    // Вход, каким его видит int8, при обучении с учётом квантования, иначе сам X
+    const Tensor<T>& SimulatedInput(const Tensor<T>& X)
+    {
+        if (!quantization_aware)
+            return X;
+
+        simulated_input = X;
+        int8_input.Simulate(X.data(), X.size(), simulated_input.data());
+
+        return simulated_input;
+    }
+
+    /*
+        Обратный проход при обучении с учётом квантования пополняет
+        диапазон входа, как у ConvolutionalLayer. Параметры квантования
+        от этого не меняются: Forward уже считал их по диапазону вместе с X
+    */
+    const Tensor<T>& ObserveTraining(const Tensor<T>& X)
+    {
+        if (quantization_aware)
+            Observe(X);
+
+        return SimulatedInput(X);
+    }
+
+    /*
+        Обратный проход одного примера: градиент по входу и изменение весов
+    */
+    Tensor<T> BackwardSample(const T* x, const T* g)
+    {
+        /*
+            Считаем градиент для предыдущего слоя
+            Градиент для предыдущего слоя будет считаться так же просто
+            
+            Проговорим словами, что надо сделать
+            Для каждого входа слоя необходимо сосчитать сумму градиентов весов, 
+            Которые были применены к данному входу
+
+            Это умножение транспонированной матрицы весов на градиент:
+            GFCL = W^T * grad, и считается оно по весам до изменения
+
+            Чтобы распространение ошибки продолжало работать, необходимо
+            передавать градиент дальше предыдущим слоям
+        */
+        Tensor<T> GFCL = Tensor<T>(1, 1, inputs, 1, 0);
+
+        // Формула
+        /*
+            Δw_i = δE/δS * δS/δw_i, где
+            E - ошибка слоя, то есть кто-то там впереди посчитал за нас, каким-то образом ошибку
+            S - фактический выход нейрона: S = b + w_1*x_1 + ... + w_i*x_i
+
+            Нам на слое предоставляется δE/δS - градиент со следующего слоя
+            Нам остается определить δS/δw, но это просто:
+
+            Если взять и продифференцировать S = b + w_1*x_1 + ... + w_i*x_i по какому-то w_j, 
+            то останется только x_j
+
+            Поэтому формула превращается в 
+            Δw_i = grad * x_i
+            Обрати внимание, что под grad понимается градиент, пришедший на нейрон,
+            Которому принадлежит w_i
+        */
+
+        /*
+            Оба расчёта - GFCL = W^T * grad и W -= learning_rate * grad * x^T -
+            делает одно ядро GemvTransposedUpdate: веса идут подряд блоками
+            строк, каждый загруженный вектор весов сначала добавляется в
+            GFCL, затем меняется и записывается обратно. Так матрица весов
+            читается из памяти один раз, а не дважды
+        */
+        GemvTransposedUpdate(outputs, inputs, W.data(), inputs, g, -learning_rate, x, GFCL.data());
+
+        /*
+            Как менять вес свободного члена?
+            Продифференцируем S = b + w_1*x_1 + ... + w_i*x_i по b
+            δS/δb = 1
+            Поэтому Δb = grad
+            Обрати внимание, что под grad понимается градиент, пришедший на нейрон,
+            Которому принадлежит b
+        */
+        T* b = B.data();
+
+        for(unsigned int neuron_index = 0; neuron_index < outputs; ++neuron_index)
+            b[neuron_index] -= g[neuron_index] * learning_rate;
+
+        return GFCL;
+    }
+
+
+    /*
+        Обратный проход одного примера без градиента по входу: только
+        W -= learning_rate * grad * x^T. Столбцы, где вход равен нулю,
+        не меняются, поэтому строки весов проходятся только по отрезкам
+        ненулевых столбцов (ColumnRuns.cpp), если они покрывают не больше
+        трёх четвертей входа - иначе по всей строке
+    */
+    Tensor<T> BackwardUpdateOnly(const T* x, const T* g)
+    {
+        if (FindColumnRuns(x, inputs, input_runs) * 4 > inputs * 3)
+            input_runs.assign({0, inputs});
+
+        Rank1UpdateRuns(outputs, W.data(), inputs, -learning_rate, g, x, input_runs.data(), input_runs.size() / 2);
+
+        T* b = B.data();
+
+        for(unsigned int neuron_index = 0; neuron_index < outputs; ++neuron_index)
+            b[neuron_index] -= g[neuron_index] * learning_rate;
+
+        return Tensor<T>(1, 1, inputs, 1, 0);
+    }
+
+    /*
+        Те же формулы для батча, записанные матрицами (G [N x outputs] -
+        градиенты примеров по строкам):
+
+        dX [N x inputs]       = G * W         (по весам до обновления)
+        dW [outputs x inputs] = G^T * X,      W -= learning_rate * dW
+        db [outputs]          = сумма строк G
+
+        dX не считается, если градиент по входу не нужен (input_gradient)
+
+        Каждое - одно умножение матриц, поэтому веса и входы батча
+        проходят через кэш блоками, а не по строке на пример. Изменение
+        весов Gemm добавляет прямо в W (alpha = -learning_rate, beta = 1),
+        без отдельной матрицы dW и ещё одного прохода по весам
+
+        Без градиента по входу (первый слой) столбцы W, где вход нулевой
+        во всех примерах батча, не меняются: dW считается отдельным Gemm
+        на каждый отрезок ненулевых столбцов (ColumnRuns.cpp), если
+        отрезки покрывают не больше трёх четвертей входа
+    */
+    Tensor<T> BackwardBatch(const Tensor<T>& X, const Tensor<T>& GFNL)
+    {
+        const unsigned int batch = X.get_batch();
+
+        Tensor<T> GFCL = Tensor<T>(batch, 1, inputs, 1, 0);
+
+        if (input_gradient)
+            Gemm<T>(
+                false, false, batch, inputs, outputs,
+                1, GFNL.data(), outputs,
+                W.data(), inputs,
+                0, GFCL.data(), inputs
+            );
+
+        if (input_gradient || FindColumnRuns(X.data(), batch, inputs, inputs, input_runs) * 4 > inputs * 3)
+            input_runs.assign({0, inputs});
+
+        for(std::size_t r = 0; r < input_runs.size(); r += 2)
+        {
+            const unsigned int begin = input_runs[r];
+
+            Gemm<T>(
+                true, false, outputs, input_runs[r + 1] - begin, batch,
+                -learning_rate, GFNL.data(), outputs,
+                X.data() + begin, inputs,
+                1, W.data() + begin, inputs
+            );
+        }
+
+        T* b = B.data();
+
+        for(unsigned int neuron_index = 0; neuron_index < outputs; ++neuron_index)
+        {
+            T db = 0;
+
+            for(unsigned int n = 0; n < batch; ++n)
+                db += GFNL.sample(n)[neuron_index];
 
-            /*
-                Как менять вес свободного члена?
-                Продифференцируем S = b + w_1*x_1 + ... + w_i*x_i по b
-                δS/δb = 1
-                Поэтому Δb = grad
-                Обрати внимание, что под grad понимается градиент, пришедший на нейрон,
-                Которому принадлежит b
-            */
-            B[0][neuron_index][0] -= GFNL(0, neuron_index, 0) * learning_rate;
+            b[neuron_index] -= db * learning_rate;
         }
 
-        return GFCL;        
+        return GFCL;
     }
     
 };
@@ -26,6 +26,7 @@
     https://habr.com/ru/companies/ods/articles/344116/
 
 */
+template <typename T>
 class SoftmaxLayer
 {
 
@@ -33,7 +34,7 @@ public:
 
     SoftmaxLayer(){}
 
-    Tensor Forward(const Tensor& X)
+    Tensor<T> Forward(const Tensor<T>& X)
     {
         if(X.get_depth() != 1 || X.get_width() != 1)
         {
@@ -41,51 +42,71 @@ public:
             throw;
         }
 
-        Tensor Y = Tensor(1, X.get_height(), 1);
+        const unsigned int C = X.get_height();
 
-        double S = 0;
+        Tensor<T> Y = Tensor<T>(X.get_batch(), 1, C, 1, 0);
 
-        for(unsigned int i = 0; i < X.get_height(); ++i)
-            S += std::exp(X(0, i, 0));
-        
-        for(unsigned int i = 0; i < X.get_height(); ++i)
-            Y[0][i][0] = std::exp(X(0, i, 0)) / S;
+        // Каждый пример батча нормируется отдельно
+        for(unsigned int n = 0; n < X.get_batch(); ++n)
+        {
+            const T* x = X.sample(n);
+            T* y = Y.sample(n);
+
+            T S = 0;
+
+            for(unsigned int i = 0; i < C; ++i)
+                S += std::exp(x[i]);
+            
+            for(unsigned int i = 0; i < C; ++i)
+                y[i] = std::exp(x[i]) / S;
+        }
         
         return Y;
     }
 
 
-    Tensor Backward(const Tensor& X, const Tensor& GFNL)
+    Tensor<T> Backward(const Tensor<T>& X, const Tensor<T>& GFNL)
     {
-        Tensor Y = Tensor(1, X.get_height(), 1);
-        {
-            double S = 0;
+        const unsigned int C = X.get_height();
 
-            for(unsigned int i = 0; i < X.get_height(); ++i)
-                S += std::exp(X(0, i, 0));
-            
-            for(unsigned int i = 0; i < X.get_height(); ++i)
-                Y[0][i][0] = std::exp(X(0, i, 0)) / S;
-        }        
+        Tensor<T> GFCL = Tensor<T>(X.get_batch(), 1, C, 1, 0);
 
-        Tensor J = Tensor(1, X.get_height(), X.get_height());
-        for(unsigned int i = 0; i < X.get_height(); ++i)
+        Tensor<T> Y = Tensor<T>(1, C, 1);
+        Tensor<T> J = Tensor<T>(1, C, C);
+
+        for(unsigned int n = 0; n < X.get_batch(); ++n)
         {
-            for(unsigned int j = 0; j < X.get_height(); ++j)
+            const T* x = X.sample(n);
+            const T* g = GFNL.sample(n);
+            T* gfcl = GFCL.sample(n);
+
             {
-                if (i == j)
-                    J[0][i][j] = Y(0, i, 0) * (1 - Y(0, i, 0));
-                else
-                    J[0][i][j] = -Y(0, i, 0) * Y(0, i, 0);
+                T S = 0;
+
+                for(unsigned int i = 0; i < C; ++i)
+                    S += std::exp(x[i]);
+                
+                for(unsigned int i = 0; i < C; ++i)
+                    Y[0][i][0] = std::exp(x[i]) / S;
+            }        
+
+            for(unsigned int i = 0; i < C; ++i)
+            {
+                for(unsigned int j = 0; j < C; ++j)
+                {
+                    if (i == j)
+                        J[0][i][j] = Y(0, i, 0) * (1 - Y(0, i, 0));
+                    else
+                        J[0][i][j] = -Y(0, i, 0) * Y(0, i, 0);
+                }
             }
-        }
 
-        Tensor GFCL = Tensor(1, X.get_height(), 1);
-        for(unsigned int i = 0; i < X.get_height(); ++i)
-        {
-            for(unsigned int j = 0; j < X.get_height(); ++j)
+            for(unsigned int i = 0; i < C; ++i)
             {
-                GFCL[0][i][0] += GFNL(0, j, 0) * J(0, j, i);
+                for(unsigned int j = 0; j < C; ++j)
+                {
+                    gfcl[i] += g[j] * J(0, j, i);
+                }
             }
         }
 
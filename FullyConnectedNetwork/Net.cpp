@@ -21,39 +21,40 @@
 
     Если бы функция потерь Кросс-Энтропия хорошо работала с какой-либо
     функцией активации, кроме Softmax, то можно было бы и не писать
-    слой активации SoftmaxLayer. Поэтому последним слоем обязательно 
+    слой активации SoftmaxLayer<T>. Поэтому последним слоем обязательно 
     должен быть Softmax. 
     
     Однако, было бы естественно, если бы мы использовали функцию 
     активации Sigmoid, но почему-то градиент с этой функцией быстро 
     затухает, и сеть почти не обучается
 */
+template <typename T>
 class Net
 {
 
-    Tensor FC1_X;
-    Tensor AC1_X;
+    Tensor<T> FC1_X;
+    Tensor<T> AC1_X;
 
-    Tensor FC2_X;
-    Tensor AC2_X;
+    Tensor<T> FC2_X;
+    Tensor<T> AC2_X;
 
-    Tensor FC3_X;
-    Tensor AC3_X;
+    Tensor<T> FC3_X;
+    Tensor<T> AC3_X;
 
-    FullyConnectedLayer fc1;
-    ActivationLayer ac1;
+    FullyConnectedLayer<T> fc1;
+    ActivationLayer<T> ac1;
 
-    FullyConnectedLayer fc2;
-    ActivationLayer ac2;
+    FullyConnectedLayer<T> fc2;
+    ActivationLayer<T> ac2;
 
-    FullyConnectedLayer fc3;
-    SoftmaxLayer ac3;
+    FullyConnectedLayer<T> fc3;
+    SoftmaxLayer<T> ac3;
 
     bool initialized = false;
 
 public:
 
-    Net(double learning_rate = 1e-4, double mean = 0, double sigma = 0.01)
+    Net(T learning_rate = 1e-4, T mean = 0, T sigma = 0.01)
     {
         fc1.Initialize(
             784,
@@ -62,7 +63,9 @@ public:
             mean,
             sigma
         );
-        ac1.SetActivationType(ActivationLayer::ActivationType::LeakyReLU);
+        // Градиент по входу сети никому не нужен
+        fc1.input_gradient = false;
+        ac1.SetActivationType(ActivationLayer<T>::ActivationType::LeakyReLU);
 
         fc2.Initialize(
             128,
@@ -71,7 +74,7 @@ public:
             mean,
             sigma
         );
-        ac2.SetActivationType(ActivationLayer::ActivationType::Sigmoid);
+        ac2.SetActivationType(ActivationLayer<T>::ActivationType::Sigmoid);
 
         fc3.Initialize(
             64,
@@ -80,12 +83,12 @@ public:
             mean,
             sigma
         );
-        ac3 = SoftmaxLayer(); // Строка добавлена для общей красоты
+        ac3 = SoftmaxLayer<T>(); // Строка добавлена для общей красоты
 
         initialized = true;
     }
     
-    Tensor Forward(Tensor& X)
+    Tensor<T> Forward(const Tensor<T>& X)
     {
         FC1_X = X;
         
@@ -96,15 +99,15 @@ public:
         FC3_X = ac2.Forward( AC2_X );
 
         AC3_X = fc3.Forward( FC3_X );
-        Tensor Prediction = ac3.Forward( AC3_X );
+        Tensor<T> Prediction = ac3.Forward( AC3_X );
 
         return Prediction;
     }
 
 
-    unsigned int Predict(Tensor& X)
+    unsigned int Predict(const Tensor<T>& X)
     {
-        Tensor prediction = Forward(X);
+        Tensor<T> prediction = Forward(X);
 
         int predicted_number = 0;
 
@@ -118,16 +121,16 @@ public:
     }
 
 
-    void Backward(Tensor& loss_gradient)
+    void Backward(Tensor<T>& loss_gradient)
     {
-        Tensor ac3_grad = ac3.Backward( AC3_X, loss_gradient);
-        Tensor fc3_grad = fc3.Backward( FC3_X, ac3_grad);
+        Tensor<T> ac3_grad = ac3.Backward( AC3_X, loss_gradient);
+        Tensor<T> fc3_grad = fc3.Backward( FC3_X, ac3_grad);
 
-        Tensor ac2_grad = ac2.Backward( AC2_X, fc3_grad);
-        Tensor fc2_grad = fc2.Backward( FC2_X, ac2_grad);
+        Tensor<T> ac2_grad = ac2.Backward( AC2_X, fc3_grad);
+        Tensor<T> fc2_grad = fc2.Backward( FC2_X, ac2_grad);
 
-        Tensor ac1_grad = ac1.Backward( AC1_X, fc2_grad);
-        Tensor fc1_grad = fc1.Backward( FC1_X, ac1_grad);
+        Tensor<T> ac1_grad = ac1.Backward( AC1_X, fc2_grad);
+        Tensor<T> fc1_grad = fc1.Backward( FC1_X, ac1_grad);
     }
 
     /*
@@ -136,7 +139,7 @@ public:
 
         Точность возвращается в процентах
     */
-    double Accuracy(vector<Tensor> X, vector<unsigned int> Y, unsigned int check_sample_size = 0)
+    double Accuracy(const vector<Tensor<T>>& X, const vector<unsigned int>& Y, unsigned int check_sample_size = 0)
     {
         if (X.size() != Y.size())
         {
@@ -171,7 +174,7 @@ public:
     }
 
 
-    Tensor LossGradient(unsigned int Y, Tensor prediction)
+    Tensor<T> LossGradient(unsigned int Y, const Tensor<T>& prediction)
     {
         if (prediction.get_width() != 1 || prediction.get_depth() != 1)
         {
@@ -179,7 +182,7 @@ public:
             throw;
         }
 
-        Tensor grad = Tensor(1, prediction.get_height(), 1);
+        Tensor<T> grad = Tensor<T>(1, prediction.get_height(), 1);
 
         for(unsigned int i = 0; i < prediction.get_height(); ++i)
         {
@@ -197,7 +200,27 @@ public:
     }
 
 
-    double Loss(vector<Tensor> X, vector<unsigned int> Y, unsigned int check_sample_size = 0)
+    /*
+        Градиент для батча: отдельная метка на каждый пример
+    */
+    Tensor<T> LossGradient(const vector<unsigned int>& Y, const Tensor<T>& prediction)
+    {
+        if (prediction.get_width() != 1 || prediction.get_depth() != 1 || prediction.get_batch() != Y.size())
+        {
+            cout << "Input data must be vertical vectors!"  << endl;
+            throw;
+        }
+
+        Tensor<T> grad = prediction;
+
+        for(unsigned int n = 0; n < Y.size(); ++n)
+            grad(n, 0, Y[n], 0) -= 1;
+
+        return grad;
+    }
+
+
+    double Loss(const vector<Tensor<T>>& X, const vector<unsigned int>& Y, unsigned int check_sample_size = 0)
     {
         if (X.size() != Y.size())
         {
@@ -235,7 +258,7 @@ public:
     /*
         Бинарная кросс энтропия
     */
-    double Loss(unsigned int Y, Tensor prediction)
+    double Loss(unsigned int Y, const Tensor<T>& prediction)
     {
         if (prediction.get_width() != 1 || prediction.get_depth() != 1)
         {
@@ -255,7 +278,7 @@ public:
     }
 
 
-    void SetLearningRate(double lr)
+    void SetLearningRate(T lr)
     {
         fc1.learning_rate = lr;
         fc2.learning_rate = lr;
@@ -263,6 +286,59 @@ public:
     }
 
 
+    /*
+        Прореживание полносвязных слоёв после обучения: доля sparsity
+        весов каждого слоя обнуляется блоками, Forward дальше идёт только
+        по оставшимся (FullyConnectedLayer::Prune). После
+        ReadModel или дообучения вызывается заново
+    */
+    void Prune(T sparsity)
+    {
+        fc1.Prune(sparsity);
+        fc2.Prune(sparsity);
+        fc3.Prune(sparsity);
+    }
+
+    // Размер весов полносвязных слоёв в памяти, байт
+    std::size_t WeightBytes() const
+    {
+        return fc1.WeightBytes() + fc2.WeightBytes() + fc3.WeightBytes();
+    }
+
+
+    /*
+        Квантование в int8 после обучения: калибровочные примеры проходят
+        через сеть в вещественных числах, и слои собирают диапазоны своих
+        входов. Затем веса полносвязных слоёв переводятся в
+        int8 (Quantize слоёв), и Forward дальше считает их в целых числах.
+        Dequantize возвращает сеть к вещественным весам
+    */
+    void Quantize(const vector<Tensor<T>>& calibration)
+    {
+        Dequantize();
+
+        for(const Tensor<T>& X : calibration)
+        {
+            Forward(X);
+
+            fc1.Observe(FC1_X);
+            fc2.Observe(FC2_X);
+            fc3.Observe(FC3_X);
+        }
+
+        fc1.Quantize();
+        fc2.Quantize();
+        fc3.Quantize();
+    }
+
+    void Dequantize()
+    {
+        fc1.Dequantize();
+        fc2.Dequantize();
+        fc3.Dequantize();
+    }
+
+
     bool SaveModel(std::string name)
     {
         if (!initialized)
@@ -282,10 +358,8 @@ public:
         
 
         // Saving zero fully conn layer
-        for(unsigned int d = 0; d < fc3.W.get_depth(); ++d)
-            for(unsigned int h = 0; h < fc3.W.get_height(); ++h)
-                for(unsigned int w = 0; w < fc3.W.get_width(); ++w)
-                    file << fc3.W[d][h][w] << ' ';
+        for(std::size_t i = 0; i < fc3.W.size(); ++i)
+            file << fc3.Weight(i) << ' ';
         
         for(unsigned int d = 0; d < fc3.B.get_depth(); ++d)
             for(unsigned int h = 0; h < fc3.B.get_height(); ++h)
@@ -293,10 +367,8 @@ public:
                     file << fc3.B[d][h][w] << ' ';
         
         // Saving one fully conn layer
-        for(unsigned int d = 0; d < fc2.W.get_depth(); ++d)
-            for(unsigned int h = 0; h < fc2.W.get_height(); ++h)
-                for(unsigned int w = 0; w < fc2.W.get_width(); ++w)
-                    file << fc2.W[d][h][w] << ' ';
+        for(std::size_t i = 0; i < fc2.W.size(); ++i)
+            file << fc2.Weight(i) << ' ';
         
         for(unsigned int d = 0; d < fc2.B.get_depth(); ++d)
             for(unsigned int h = 0; h < fc2.B.get_height(); ++h)
@@ -304,10 +376,8 @@ public:
                     file << fc2.B[d][h][w] << ' ';
         
         // Saving two fully conn layer
-        for(unsigned int d = 0; d < fc1.W.get_depth(); ++d)
-            for(unsigned int h = 0; h < fc1.W.get_height(); ++h)
-                for(unsigned int w = 0; w < fc1.W.get_width(); ++w)
-                    file << fc1.W[d][h][w] << ' ';
+        for(std::size_t i = 0; i < fc1.W.size(); ++i)
+            file << fc1.Weight(i) << ' ';
         
         for(unsigned int d = 0; d < fc1.B.get_depth(); ++d)
             for(unsigned int h = 0; h < fc1.B.get_height(); ++h)
@@ -368,6 +438,10 @@ public:
             for(unsigned int h = 0; h < fc1.B.get_height(); ++h)
                 for(unsigned int w = 0; w < fc1.B.get_width(); ++w)
                     file >> fc1.B[d][h][w];
+
+        fc3.InvalidateWeightCache();
+        fc2.InvalidateWeightCache();
+        fc1.InvalidateWeightCache();
         
         return true;
     }
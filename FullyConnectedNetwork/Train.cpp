@@ -3,19 +3,99 @@
 #include <string>
 #include <random>
 #include <vector>
+#include <algorithm>
+#include <chrono>
 using namespace std;
 
 #include "Net.cpp"
 #include "Tensor.cpp"
 
+/*
+    Прореживание обученной сети: для каждой доли нулевых весов
+    полносвязных слоёв - точность на тестовых изображениях, время
+    предсказания одного изображения и размер весов сети. Прореживается
+    копия, сама сеть остаётся плотной
+*/
+template <typename T, typename Model>
+void PruningReport(const Model& net, const vector<Tensor<T>>& test_images, const vector<unsigned int>& test_labels)
+{
+    typedef chrono::steady_clock Clock;
+
+    const T levels[] = {0, 0.5, 0.7, 0.8, 0.9, 0.95};
+
+    cout << endl << "Sparsity\tAccuracy\tLatency(us)\tWeights(KB)" << endl;
+
+    for(T sparsity : levels)
+    {
+        Model pruned = net;
+
+        if (sparsity > 0)
+            pruned.Prune(sparsity);
+
+        double accur = pruned.Accuracy(test_images, test_labels);
+
+        auto start = Clock::now();
+
+        for(const Tensor<T>& image : test_images)
+            pruned.Predict(image);
+
+        double latency = chrono::duration<double, micro>(Clock::now() - start).count() / test_images.size();
+
+        cout << sparsity * 100 << "%\t\t" << accur << "%\t\t" << latency << "\t\t" << pruned.WeightBytes() / 1024.0 << endl;
+    }
+}
+
+
+/*
+    Квантование обученной сети в int8: калибровка на calibration_size
+    случайных тестовых изображениях, затем для вещественной и
+    квантованной сети - точность на всех тестовых изображениях, время
+    предсказания одного изображения и размер весов. Квантуется копия,
+    сама сеть остаётся вещественной
+*/
+template <typename T, typename Model>
+void QuantizationReport(Model& net, const vector<Tensor<T>>& test_images, const vector<unsigned int>& test_labels, unsigned int calibration_size = 256)
+{
+    typedef chrono::steady_clock Clock;
+
+    vector<Tensor<T>> calibration;
+
+    for(unsigned int i = 0; i < calibration_size; ++i)
+        calibration.push_back(test_images[rand() % test_images.size()]);
+
+    Model quantized = net;
+    quantized.Quantize(calibration);
+
+    cout << endl << "Weights\tAccuracy\tLatency(us)\tWeights(KB)" << endl;
+
+    double accuracy[2];
+
+    for(unsigned int k = 0; k < 2; ++k)
+    {
+        Model& model = k == 0 ? net : quantized;
+
+        auto start = Clock::now();
+
+        accuracy[k] = model.Accuracy(test_images, test_labels);
+
+        double latency = chrono::duration<double, micro>(Clock::now() - start).count() / test_images.size();
+
+        cout << (k == 0 ? (sizeof(T) == 8 ? "double" : "float") : "int8") << "\t" << accuracy[k] << "%\t\t" << latency << "\t\t" << model.WeightBytes() / 1024.0 << endl;
+    }
+
+    cout << "Accuracy delta (int8 - " << (sizeof(T) == 8 ? "double" : "float") << "): " << accuracy[1] - accuracy[0] << '%' << endl;
+}
+
+
+template <typename T>
 void TrainMNIST()
 {
     cout << "Train MNIST" << endl;;
 
-    vector<Tensor> train_images;
+    vector<Tensor<T>> train_images;
     vector<unsigned int> train_labels;
 
-    vector<Tensor> test_images;
+    vector<Tensor<T>> test_images;
     vector<unsigned int> test_labels;
 
     cout << "Data loading...";
@@ -62,18 +142,18 @@ void TrainMNIST()
             train_images.reserve(train_image_amount);
             for(int image_index = 0; image_index < train_image_amount; ++image_index)
             {
-                Tensor img = Tensor(1, 784, 1);
+                Tensor<T> img = Tensor<T>(1, 784, 1);
 
                 for(int row = 0; row < 28; ++row)
                 {
                     for(int col = 0; col < 28; ++col)
                     {
                         inputFileStream.read((char*)&cursor, sizeof(cursor));
-                        img[0][row * 28 + col][0] = (double)cursor/255.0;
+                        img[0][row * 28 + col][0] = (T)cursor/255.0;
                     }
                 }
 
-                train_images.push_back(img);
+                train_images.push_back(std::move(img));
             }
 
             inputFileStream.close();
@@ -114,18 +194,18 @@ void TrainMNIST()
             test_images.reserve(test_image_amount);
             for(int image_index = 0; image_index < test_image_amount; ++image_index)
             {
-                Tensor img = Tensor(1, 784, 1);
+                Tensor<T> img = Tensor<T>(1, 784, 1);
 
                 for(int row = 0; row < 28; ++row)
                 {
                     for(int col = 0; col < 28; ++col)
                     {
                         inputFileStream.read((char*)&cursor, sizeof(cursor));
-                        img[0][row * 28 + col][0] = (double)cursor/255.0;
+                        img[0][row * 28 + col][0] = (T)cursor/255.0;
                     }
                 }
 
-                test_images.push_back(img);
+                test_images.push_back(std::move(img));
             }
 
             inputFileStream.close();
@@ -134,9 +214,18 @@ void TrainMNIST()
     
     cout << "done!" << endl;
 
-    double learning_rate = 0.02;
+    T learning_rate = 0.02;
+
+    /*
+        Примеры подаются в сеть батчами по samples_per_step: слои считают
+        батч умножением матриц, и веса читаются из памяти один раз на батч.
+        Градиенты примеров в слоях суммируются, поэтому шаг на батч
+        примерно равен samples_per_step шагам по одному примеру, и
+        скорость обучения остаётся прежней
+    */
+    unsigned int samples_per_step = 32;
 
-    Net net = Net(learning_rate, 0, 0.5);
+    Net<T> net = Net<T>(learning_rate, 0, 0.5);
 
     cout << endl << "Accuracy on test images: " << net.Accuracy(test_images, test_labels, 1000) << '%' << endl;
 
@@ -159,17 +248,28 @@ void TrainMNIST()
     {
         cout << epoch + 1 << "/" << eras << "\t";
 
-        for(unsigned int i = 0; i < sample_size; ++i)
+        for(unsigned int i = 0; i < sample_size; i += samples_per_step)
         {
-            unsigned int idx = rand() % train_images.size();
+            unsigned int count = min(samples_per_step, sample_size - i);
+
+            Tensor<T> X = Tensor<T>(count, 1, 784, 1, 0);
+            vector<unsigned int> Y(count);
 
-            Tensor prediction = net.Forward(train_images[idx]);
+            for(unsigned int k = 0; k < count; ++k)
+            {
+                unsigned int idx = rand() % train_images.size();
+
+                X.set_sample(k, train_images[idx]);
+                Y[k] = train_labels[idx];
+            }
+
+            Tensor<T> prediction = net.Forward(X);
             
-            Tensor gradient = net.LossGradient(train_labels[idx], prediction);
+            Tensor<T> gradient = net.LossGradient(Y, prediction);
 
             net.Backward(gradient);
 
-            if (i % (sample_size / 10) == 0)
+            if ((i + count) * 10 / sample_size > i * 10 / sample_size)
                 cout << '.';
         }
 
@@ -187,14 +287,25 @@ void TrainMNIST()
         }
     }
 
-    cout << endl << "Total accuracy on test images: " <<  net.Accuracy(test_images, test_labels) << '%';
-    
+    cout << endl << "Total accuracy on test images: " <<  net.Accuracy(test_images, test_labels) << '%' << endl;
+
+    PruningReport(net, test_images, test_labels);
+    QuantizationReport(net, test_images, test_labels);
 }
 
 
 int main()
 {
-    TrainMNIST();
+    // float - быстрое обучение, double - эталон для сравнения точности
+    unsigned int precision = 32;
+
+    cout << "Precision (32 - float, 64 - double): ";
+    cin >> precision;
+
+    if (precision == 64)
+        TrainMNIST<double>();
+    else
+        TrainMNIST<float>();
 
     return 0;
 }
\ No newline at end of file
@@ -3,42 +3,45 @@
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+template <typename T>
 class LinearRegression
 {
 
 private:
 
-    double* W;
-    double bias;
+    T* W;
+    T bias;
     int inputs;
-    double learning_rate;
+    T learning_rate;
 
 public:
-    LinearRegression(int inputs, double learning_rate);
+    LinearRegression(int inputs, T learning_rate = 0.0001);
 
-    double Predict(double* x);
-    void Learn(double* x, double y);
-    void Learn(double** X, double* Y, int dataset_size, int data_amount);
+    T Predict(T* x);
+    void Learn(T* x, T y);
+    void Learn(T** X, T* Y, int dataset_size, int data_amount = 0);
 
-    double Loss(int amount, double** X, double* Y);
+    T Loss(int amount, T** X, T* Y);
 };
 
 
-LinearRegression::LinearRegression(int inputs, double learning_rate = 0.0001)
+template <typename T>
+LinearRegression<T>::LinearRegression(int inputs, T learning_rate)
 {
     this->learning_rate = learning_rate;
     this->inputs = inputs;
 
-    W = new double[inputs];
+    W = new T[inputs];
     for(int i = 0; i < inputs; ++i)
         W[i] = 0;
     
     bias = 0;
 }
 
-double LinearRegression::Predict(double* x)
+template <typename T>
+T LinearRegression<T>::Predict(T* x)
 {
-    double ans = bias;
+    T ans = bias;
 
     for(int i = 0; i < inputs; ++i)
         ans += W[i] * x[i];
@@ -46,24 +49,26 @@ double LinearRegression::Predict(double* x)
     return ans;
 }
 
-void LinearRegression::Learn(double* x, double y)
+template <typename T>
+void LinearRegression<T>::Learn(T* x, T y)
 {
-    double prediction = Predict(x);
+    T prediction = Predict(x);
 
-    // double e = (y - prediction) > 0 ? 1 : -1; // Вот это производная MAE, но с линейной производной получается лучше
-    double e = (y - prediction);
-    double e_with_lr = e * learning_rate; // Только для ускорения вычисления
+    // T e = (y - prediction) > 0 ? 1 : -1; // Вот это производная MAE, но с линейной производной получается лучше
+    T e = (y - prediction);
+    T e_with_lr = e * learning_rate; // Только для ускорения вычисления
 
     for(int i = 0; i < inputs; ++i)
     {
-        double dw = e_with_lr * x[i];
+        T dw = e_with_lr * x[i];
         W[i] = W[i] + dw;
     }
     bias += e_with_lr;
 }
 
 #include <random>
-void LinearRegression::Learn(double** X, double* Y, int dataset_size, int data_amount = 0)
+template <typename T>
+void LinearRegression<T>::Learn(T** X, T* Y, int dataset_size, int data_amount)
 {
 
     if (data_amount <= 0)
@@ -84,13 +89,14 @@ void LinearRegression::Learn(double** X, double* Y, int dataset_size, int data_a
 }
 
 // MAE Loss 
-double LinearRegression::Loss(int amount, double** X, double* Y) 
+template <typename T>
+T LinearRegression<T>::Loss(int amount, T** X, T* Y) 
 {
-    double SE = 0;
+    T SE = 0;
 
     for(int i = 0; i < amount; ++i)
     {
-        double predicion = Predict(X[i]);
+        T predicion = Predict(X[i]);
         SE += abs(Y[i] - predicion);
     }
 
@@ -7,6 +7,9 @@ using namespace std;
 
 #include "LinearRegression.cpp"
 
+// Тип скаляра: float для скорости, double как эталон точности
+typedef double Real;
+
 void LinearFunctionPrediction()
 {
     cout << endl << "> Prediction of linear function y = 2x" << endl << endl;
@@ -16,26 +19,26 @@ void LinearFunctionPrediction()
 
     int n = 100;
 
-    double** X = new double*[n];
-    double* Y_learn = new double[n];
-    double* Y_test = new double[n];
+    Real** X = new Real*[n];
+    Real* Y_learn = new Real[n];
+    Real* Y_test = new Real[n];
 
     // Создание генератора шума, распределенного нормально (генератор остатков)
     std::random_device rd{};
     std::mt19937 gen{rd()};
-    std::normal_distribution d = std::normal_distribution(0.0, 10.0);
+    std::normal_distribution<Real> d = std::normal_distribution<Real>(0.0, 10.0);
     auto random_double = [&d, &gen]{ return d(gen); };
 
     for(int i = 0; i < n; ++i)
     {
-        X[i] = new double[1]{(double)(rand() % 100 - 50)};
+        X[i] = new Real[1]{(Real)(rand() % 100 - 50)};
         Y_test[i] = X[i][0] * 2;
         Y_learn[i] = X[i][0] * 2 + random_double();
     }
 
     //- - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-    LinearRegression r(1, 0.0001);
+    LinearRegression<Real> r(1, 0.0001);
 
     int epoch_amount = 5;
 
@@ -56,12 +59,12 @@ void FoodDeliveryTimePrediction()
     int X_row_length = 7;
 
     int learn_dataset_size = 600;
-    double** X_learn = new double*[learn_dataset_size];
-    double* Y_learn = new double[learn_dataset_size];
+    Real** X_learn = new Real*[learn_dataset_size];
+    Real* Y_learn = new Real[learn_dataset_size];
 
     int test_dataset_size = 283;
-    double** X_test = new double*[test_dataset_size];
-    double* Y_test = new double[test_dataset_size];
+    Real** X_test = new Real*[test_dataset_size];
+    Real* Y_test = new Real[test_dataset_size];
 
     // Парсим и загружаем датасет
 
@@ -75,19 +78,19 @@ void FoodDeliveryTimePrediction()
         getline (file, line);
 
         // Первая колонка - индексы заказов, которые не несут смысла
-        double Order_id, Distance_km, Weather, Traffic_Level, Time_of_Day, Vehicle_Type, Preparation_Time_min, Courier_Experience_yrs, Delivery_Time_min;
+        Real Order_id, Distance_km, Weather, Traffic_Level, Time_of_Day, Vehicle_Type, Preparation_Time_min, Courier_Experience_yrs, Delivery_Time_min;
         int row_count = 0;
 
         while(file >> Order_id >> Distance_km >> Weather >> Traffic_Level >> Time_of_Day >> Vehicle_Type >> Preparation_Time_min >> Courier_Experience_yrs >> Delivery_Time_min)
         {
             if (row_count < learn_dataset_size)
             {
-                X_learn[row_count] = new double[X_row_length]{Distance_km, Weather, Traffic_Level, Time_of_Day, Vehicle_Type, Preparation_Time_min, Courier_Experience_yrs};
+                X_learn[row_count] = new Real[X_row_length]{Distance_km, Weather, Traffic_Level, Time_of_Day, Vehicle_Type, Preparation_Time_min, Courier_Experience_yrs};
                 Y_learn[row_count] = Delivery_Time_min;
             }
             else
             {
-                X_test[row_count - learn_dataset_size] = new double[X_row_length]{Distance_km, Weather, Traffic_Level, Time_of_Day, Vehicle_Type, Preparation_Time_min, Courier_Experience_yrs};
+                X_test[row_count - learn_dataset_size] = new Real[X_row_length]{Distance_km, Weather, Traffic_Level, Time_of_Day, Vehicle_Type, Preparation_Time_min, Courier_Experience_yrs};
                 Y_test[row_count - learn_dataset_size] = Delivery_Time_min;
             }
 
@@ -97,7 +100,7 @@ void FoodDeliveryTimePrediction()
 
     // Обучение
 
-    LinearRegression r(X_row_length, 1.0E-5);
+    LinearRegression<Real> r(X_row_length, 1.0E-5);
 
     int epoch_amount = 200;
 